@@ -0,0 +1,5 @@
+#pragma once
+
+void RunRangeCoderBenchmark();
+void RunFecBenchmark();
+void RunSerializationBenchmark();
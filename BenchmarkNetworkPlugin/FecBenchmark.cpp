@@ -0,0 +1,126 @@
+#include "Benchmarks.h"
+#include "Network/Channels/Channel.h"
+
+/**
+ * One message per tick on an unreliable channel goes through a lossy link, with and without parity groups.
+ * Reports how many lost packets the receiver rebuilt, how late they were delivered and the bandwidth spent on parity.
+ */
+
+static const unsigned int       FEC_TICK_COUNT      = 100000;
+static const unsigned int       PACKET_OVERHEAD     = Packet::CONNECTION_DATA_PACKET_SIZE + Packet::MESSAGE_HEADER_SIZE + Hash::HMAC::SIZE;
+static const unsigned int       MIN_MESSAGE_SIZE    = 64;
+static const unsigned int       MAX_MESSAGE_SIZE    = 300;
+
+/**
+ * Two state loss model: losses come in bursts while the link is bad
+ */
+struct LossModel
+{
+    float   lossRate        = 0.0f;
+    float   enterBurstRate  = 0.0f; // Chance per packet to go from good to bad
+    float   leaveBurstRate  = 1.0f; // Chance per packet to go from bad to good
+    bool    inBurst         = false;
+
+    bool IsLost(std::mt19937& p_random)
+    {
+        std::uniform_real_distribution<float> chance{0.0f, 1.0f};
+        inBurst = inBurst ? chance(p_random) >= leaveBurstRate : chance(p_random) < enterBurstRate;
+        return inBurst || chance(p_random) < lossRate;
+    }
+};
+
+static void RunLossSimulation(const char* p_name, LossModel p_loss, unsigned int p_groupSize)
+{
+    Channel sender;
+    Channel receiver;
+    sender.SetMode(ChannelMode::UNRELIABLE);
+    receiver.SetMode(ChannelMode::UNRELIABLE);
+    sender.SetParityGroupSize(p_groupSize);
+    receiver.SetParityGroupSize(p_groupSize);
+
+    std::mt19937 random{1234};
+    std::uniform_int_distribution<unsigned int> messageSize{MIN_MESSAGE_SIZE, MAX_MESSAGE_SIZE};
+    uint64_t dataBytes = 0;
+    uint64_t sentBytes = 0;
+    unsigned int lostPackets = 0;
+    unsigned int delivered = 0;
+    unsigned int recovered = 0;
+    uint64_t recoveryDelay = 0;
+    unsigned int maxRecoveryDelay = 0;
+    uint16_t packetSequence = 0;
+    std::vector<bool> lostMessages(FEC_TICK_COUNT, false);
+
+    for (unsigned int tick = 0; tick < FEC_TICK_COUNT; ++tick)
+    {
+        // The tick the message was sent in leads the payload, the rest is filler
+        auto data = std::make_shared<std::vector<uint8_t>>(messageSize(random));
+        std::memcpy(data->data(), &tick, sizeof(tick));
+        dataBytes += data->size() + PACKET_OVERHEAD;
+        sender.Send(std::move(data));
+
+        // Each message of a protected channel goes in its own packet
+        Message message;
+        while (sender.GetNextMessage(Channel::clock::now(), std::chrono::milliseconds{100}, Packet::MAX_MESSAGE_SIZE, message))
+        {
+            sentBytes += message.data->size() + PACKET_OVERHEAD;
+            ++packetSequence;
+            if (p_loss.IsLost(random))
+            {
+                if (!message.parity)
+                {
+                    ++lostPackets;
+                    lostMessages[tick] = true;
+                }
+                continue;
+            }
+            if (message.parity)
+                receiver.ProcessParity(message.data);
+            else
+                receiver.ProcessMessage(packetSequence, message.id, message.data);
+        }
+
+        MessageData received;
+        while (receiver.Receive(received))
+        {
+            unsigned int sentTick;
+            std::memcpy(&sentTick, received->data(), sizeof(sentTick));
+            ++delivered;
+            if (lostMessages[sentTick])
+            {
+                ++recovered;
+                recoveryDelay += tick - sentTick;
+                maxRecoveryDelay = std::max(maxRecoveryDelay, tick - sentTick);
+            }
+        }
+    }
+
+    const double lost = 100.0 * lostPackets / FEC_TICK_COUNT;
+    const double residualLoss = 100.0 * (FEC_TICK_COUNT - delivered) / FEC_TICK_COUNT;
+    std::cout << std::fixed << std::setprecision(2)
+              << "  " << std::left << std::setw(28) << p_name << std::right
+              << " group " << std::setw(2) << p_groupSize
+              << "  lost " << std::setw(6) << lost << "%"
+              << "  recovered " << std::setw(6) << (lostPackets > 0 ? 100.0 * recovered / lostPackets : 0.0) << "%"
+              << "  residual loss " << std::setw(6) << residualLoss << "%"
+              << "  overhead " << std::setw(6) << 100.0 * (static_cast<double>(sentBytes) / dataBytes - 1.0) << "%"
+              << "  recovery delay avg " << (recovered > 0 ? static_cast<double>(recoveryDelay) / recovered : 0.0)
+              << " max " << maxRecoveryDelay << " ticks\n";
+}
+
+void RunFecBenchmark()
+{
+    std::cout << "Forward error correction: " << FEC_TICK_COUNT << " ticks, one " << MIN_MESSAGE_SIZE << "-" << MAX_MESSAGE_SIZE
+              << " bytes message per tick\n";
+
+    const std::pair<const char*, LossModel> links[] {
+        { "1% random loss", { 0.01f } },
+        { "5% random loss", { 0.05f } },
+        { "10% random loss", { 0.10f } },
+        { "2% loss, 2 packet bursts", { 0.02f, 0.01f, 0.5f } },
+    };
+    for (const auto& link : links)
+    {
+        for (const unsigned int groupSize : { 0u, 2u, 4u, 8u })
+            RunLossSimulation(link.first, link.second, groupSize);
+    }
+}
@@ -0,0 +1,170 @@
+#include "Benchmarks.h"
+#include "Network/Compression/RangeCoder.h"
+
+/**
+ * Every tick, each client receives the quantized deltas of the entities it sees, range coded with per-field models.
+ * Measures encode and decode time of a whole tick against the 60 Hz budget, and the size against raw serialization.
+ */
+
+static const unsigned int       CLIENT_COUNT        = 128;
+static const unsigned int       ENTITY_COUNT        = 64; // Entities sent to each client every tick
+static const unsigned int       TRAINING_TICKS      = 60;
+static const unsigned int       TICK_COUNT          = 600;
+static const unsigned int       RAW_ENTITY_SIZE     = 5 * sizeof(int32_t) + sizeof(uint8_t);
+static const unsigned int       PACKET_CAPACITY     = ENTITY_COUNT * 32;
+static constexpr double         TICK_BUDGET_MS      = 1000.0 / 60.0;
+
+struct EntityDelta
+{
+    int32_t     x       = 0;
+    int32_t     y       = 0;
+    int32_t     z       = 0;
+    int32_t     yaw     = 0;
+    int32_t     health  = 0;
+    uint32_t    state   = 0;
+};
+
+struct EntityModels
+{
+    IntegerModel        x       {};
+    IntegerModel        y       {};
+    IntegerModel        z       {};
+    IntegerModel        yaw     {};
+    IntegerModel        health  {};
+    BitTreeModel<4>     state   {};
+};
+
+static void EncodeEntity(RangeEncoder& p_encoder, EntityModels& p_models, const EntityDelta& p_delta)
+{
+    p_models.x.Encode(p_encoder, p_delta.x);
+    p_models.y.Encode(p_encoder, p_delta.y);
+    p_models.z.Encode(p_encoder, p_delta.z);
+    p_models.yaw.Encode(p_encoder, p_delta.yaw);
+    p_models.health.Encode(p_encoder, p_delta.health);
+    p_models.state.Encode(p_encoder, p_delta.state);
+}
+
+static EntityDelta DecodeEntity(RangeDecoder& p_decoder, EntityModels& p_models)
+{
+    EntityDelta delta;
+    delta.x = p_models.x.Decode(p_decoder);
+    delta.y = p_models.y.Decode(p_decoder);
+    delta.z = p_models.z.Decode(p_decoder);
+    delta.yaw = p_models.yaw.Decode(p_decoder);
+    delta.health = p_models.health.Decode(p_decoder);
+    delta.state = p_models.state.Decode(p_decoder);
+    return delta;
+}
+
+/**
+ * Most entities stand still, moving ones have small position deltas, a few change state or take damage
+ */
+static void GenerateTick(std::mt19937& p_random, std::vector<EntityDelta>& o_deltas)
+{
+    std::uniform_real_distribution<float>   chance  {0.0f, 1.0f};
+    std::uniform_int_distribution<int32_t>  step    {-64, 64};
+    std::uniform_int_distribution<int32_t>  turn    {-16, 16};
+    std::uniform_int_distribution<int32_t>  damage  {-100, -1};
+    std::uniform_int_distribution<uint32_t> state   {0, 15};
+
+    for (EntityDelta& delta : o_deltas)
+    {
+        const bool moving = chance(p_random) < 0.3f;
+        delta.x = moving ? step(p_random) : 0;
+        delta.y = moving ? step(p_random) : 0;
+        delta.z = moving && chance(p_random) < 0.1f ? step(p_random) : 0;
+        delta.yaw = chance(p_random) < 0.2f ? turn(p_random) : 0;
+        delta.health = chance(p_random) < 0.02f ? damage(p_random) : 0;
+        delta.state = chance(p_random) < 0.05f ? state(p_random) : (moving ? 1 : 0);
+    }
+}
+
+static void RunTicks(const char* p_name, const EntityModels& p_initialModels)
+{
+    using clock = std::chrono::high_resolution_clock;
+
+    std::mt19937 random{42};
+    std::vector<EntityDelta> deltas(CLIENT_COUNT * ENTITY_COUNT);
+    std::vector<std::unique_ptr<Buffer>> packets;
+    for (unsigned int i = 0; i < CLIENT_COUNT; ++i)
+        packets.push_back(std::make_unique<Buffer>(PACKET_CAPACITY));
+
+    clock::duration encodeTime{0};
+    clock::duration decodeTime{0};
+    uint64_t encodedBytes = 0;
+    unsigned int mismatches = 0;
+
+    for (unsigned int tick = 0; tick < TICK_COUNT; ++tick)
+    {
+        GenerateTick(random, deltas);
+
+        const clock::time_point encodeStart = clock::now();
+        for (unsigned int client = 0; client < CLIENT_COUNT; ++client)
+        {
+            Buffer& packet = *packets[client];
+            packet.index = 0;
+            EntityModels models = p_initialModels;
+            RangeEncoder encoder{packet};
+            for (unsigned int entity = 0; entity < ENTITY_COUNT; ++entity)
+                EncodeEntity(encoder, models, deltas[client * ENTITY_COUNT + entity]);
+            encoder.Flush();
+            encodedBytes += packet.index;
+        }
+        const clock::time_point decodeStart = clock::now();
+        for (unsigned int client = 0; client < CLIENT_COUNT; ++client)
+        {
+            Buffer& packet = *packets[client];
+            packet.index = 0;
+            EntityModels models = p_initialModels;
+            RangeDecoder decoder{packet};
+            for (unsigned int entity = 0; entity < ENTITY_COUNT; ++entity)
+            {
+                const EntityDelta delta = DecodeEntity(decoder, models);
+                const EntityDelta& expected = deltas[client * ENTITY_COUNT + entity];
+                if (delta.x != expected.x || delta.y != expected.y || delta.z != expected.z || delta.yaw != expected.yaw ||
+                    delta.health != expected.health || delta.state != expected.state)
+                    ++mismatches;
+            }
+        }
+        const clock::time_point decodeEnd = clock::now();
+        encodeTime += decodeStart - encodeStart;
+        decodeTime += decodeEnd - decodeStart;
+    }
+
+    const double encodeMs = std::chrono::duration<double, std::milli>(encodeTime).count() / TICK_COUNT;
+    const double decodeMs = std::chrono::duration<double, std::milli>(decodeTime).count() / TICK_COUNT;
+    const double fields = static_cast<double>(CLIENT_COUNT) * ENTITY_COUNT * 6;
+    const double bytesPerPacket = static_cast<double>(encodedBytes) / (static_cast<double>(TICK_COUNT) * CLIENT_COUNT);
+
+    std::cout << std::fixed << std::setprecision(3)
+              << p_name << "\n"
+              << "  packet size      " << bytesPerPacket << " bytes (raw " << ENTITY_COUNT * RAW_ENTITY_SIZE << " bytes, "
+              << 100.0 * bytesPerPacket / (ENTITY_COUNT * RAW_ENTITY_SIZE) << "%)\n"
+              << "  encode per tick  " << encodeMs << " ms (" << 100.0 * encodeMs / TICK_BUDGET_MS << "% of 60 Hz budget, "
+              << fields / encodeMs / 1000.0 << " M fields/s)\n"
+              << "  decode per tick  " << decodeMs << " ms (" << fields / decodeMs / 1000.0 << " M fields/s)\n"
+              << "  mismatches       " << mismatches << "\n";
+}
+
+void RunRangeCoderBenchmark()
+{
+    std::cout << "Range coder: " << CLIENT_COUNT << " clients, " << ENTITY_COUNT << " entities each, " << TICK_COUNT << " ticks\n";
+
+    RunTicks("Fresh models", EntityModels{});
+
+    // Models trained by coding recorded ticks, then used as the initial state of every packet
+    EntityModels trained;
+    std::mt19937 random{7};
+    std::vector<EntityDelta> deltas(CLIENT_COUNT * ENTITY_COUNT);
+    Buffer scratch{PACKET_CAPACITY * CLIENT_COUNT};
+    for (unsigned int tick = 0; tick < TRAINING_TICKS; ++tick)
+    {
+        GenerateTick(random, deltas);
+        scratch.index = 0;
+        RangeEncoder encoder{scratch};
+        for (const EntityDelta& delta : deltas)
+            EncodeEntity(encoder, trained, delta);
+        encoder.Flush();
+    }
+    RunTicks("Trained models", trained);
+}
@@ -0,0 +1,216 @@
+#include "Benchmarks.h"
+#include "Network/Packets/Packet.h"
+#include "Network/Packets/Buffer.h"
+#include <new>
+
+/**
+ * Cost of every Buffer accessor and of Write/Read of every packet type at the payload sizes they are sent with.
+ * Each row reports the best of REPEAT_COUNT runs in ns per call, the bytes serialized per second and the heap allocations per call,
+ * counted by the operator new replacement below. Meant to be compared before and after allocator and serializer changes.
+ */
+
+static const unsigned int       REPEAT_COUNT        = 5;
+static const unsigned int       CALL_COUNT          = 100000; // Per run of a row
+static const unsigned int       BATCH_SIZE          = 256; // Buffer accessor calls between two index resets
+static const unsigned int       MAX_GAME_DATA_SIZE  = Packet::MAX_PACKET_SIZE - Packet::CONNECTION_DATA_PACKET_SIZE - Hash::HMAC::SIZE;
+static const unsigned int       PAYLOAD_SIZES[]     = { 16, 64, 256, 1024, MAX_GAME_DATA_SIZE };
+
+static std::atomic<uint64_t>    s_allocationCount   {0};
+static volatile uint64_t        s_sink              = 0; // Keeps read results alive
+
+void* operator new(std::size_t p_size)
+{
+    s_allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* memory = std::malloc(p_size == 0 ? 1 : p_size))
+        return memory;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p_memory) noexcept
+{
+    std::free(p_memory);
+}
+
+void operator delete(void* p_memory, std::size_t) noexcept
+{
+    std::free(p_memory);
+}
+
+/**
+ * Run p_run CALL_COUNT / p_callsPerRun times, each run makes p_callsPerRun calls serializing p_bytes bytes each
+ */
+template<typename Run>
+static void Measure(const std::string& p_name, const unsigned int p_bytes, const unsigned int p_callsPerRun, Run p_run)
+{
+    const unsigned int runCount = CALL_COUNT / p_callsPerRun;
+    using clock = std::chrono::high_resolution_clock;
+
+    double bestNanoseconds = std::numeric_limits<double>::max();
+    uint64_t allocations = 0;
+    for (unsigned int repeat = 0; repeat < REPEAT_COUNT; ++repeat)
+    {
+        const uint64_t allocationsBefore = s_allocationCount.load(std::memory_order_relaxed);
+        const clock::time_point start = clock::now();
+        for (unsigned int i = 0; i < runCount; ++i)
+            p_run();
+        const clock::time_point end = clock::now();
+        allocations = s_allocationCount.load(std::memory_order_relaxed) - allocationsBefore;
+        bestNanoseconds = std::min(bestNanoseconds, std::chrono::duration<double, std::nano>(end - start).count() / (runCount * p_callsPerRun));
+    }
+
+    std::cout << std::fixed << std::setprecision(2)
+              << "  " << std::left << std::setw(52) << p_name << std::right
+              << std::setw(10) << bestNanoseconds << " ns"
+              << std::setw(10) << p_bytes / bestNanoseconds * 1000.0 << " MB/s"
+              << std::setw(8) << static_cast<double>(allocations) / (runCount * p_callsPerRun) << " allocs\n";
+}
+
+/**
+ * Accessor calls are timed in batches so the index reset is spread over BATCH_SIZE calls
+ */
+template<typename Call>
+static void MeasureAccessor(const char* p_name, const unsigned int p_valueSize, Call p_call)
+{
+    Buffer buffer(BATCH_SIZE * sizeof(uint64_t));
+    Measure(p_name, p_valueSize, BATCH_SIZE, [&]()
+    {
+        buffer.index = 0;
+        for (unsigned int i = 0; i < BATCH_SIZE; ++i)
+            p_call(buffer, i);
+    });
+}
+
+static void RunBufferBenchmark()
+{
+    std::cout << "Buffer accessors\n";
+    MeasureAccessor("WriteByte", sizeof(uint8_t), [](Buffer& p_buffer, unsigned int p_i) { p_buffer.WriteByte(static_cast<uint8_t>(p_i)); });
+    MeasureAccessor("WriteShort", sizeof(uint16_t), [](Buffer& p_buffer, unsigned int p_i) { p_buffer.WriteShort(static_cast<uint16_t>(p_i)); });
+    MeasureAccessor("WriteInteger", sizeof(uint32_t), [](Buffer& p_buffer, unsigned int p_i) { p_buffer.WriteInteger(p_i); });
+    MeasureAccessor("WriteLongLong", sizeof(uint64_t), [](Buffer& p_buffer, unsigned int p_i) { p_buffer.WriteLongLong(p_i); });
+    MeasureAccessor("WriteFloat", sizeof(float), [](Buffer& p_buffer, unsigned int p_i) { p_buffer.WriteFloat(static_cast<float>(p_i)); });
+    MeasureAccessor("ReadByte", sizeof(uint8_t), [](Buffer& p_buffer, unsigned int) { s_sink += p_buffer.ReadByte(); });
+    MeasureAccessor("ReadShort", sizeof(uint16_t), [](Buffer& p_buffer, unsigned int) { s_sink += p_buffer.ReadShort(); });
+    MeasureAccessor("ReadInteger", sizeof(uint32_t), [](Buffer& p_buffer, unsigned int) { s_sink += p_buffer.ReadInteger(); });
+    MeasureAccessor("ReadLongLong", sizeof(uint64_t), [](Buffer& p_buffer, unsigned int) { s_sink += p_buffer.ReadLongLong(); });
+    MeasureAccessor("ReadFloat", sizeof(float), [](Buffer& p_buffer, unsigned int) { s_sink += static_cast<uint64_t>(p_buffer.ReadFloat()); });
+
+    for (const unsigned int size : PAYLOAD_SIZES)
+    {
+        std::vector<unsigned char> data(size, 0x5A);
+        Buffer buffer(size);
+        Measure("WriteBuffer " + std::to_string(size) + " bytes", size, 1, [&]()
+        {
+            buffer.index = 0;
+            buffer.WriteBuffer(data.data(), size);
+        });
+        Measure("ReadBuffer " + std::to_string(size) + " bytes", size, 1, [&]()
+        {
+            buffer.index = 0;
+            buffer.ReadBuffer(data.data(), size);
+        });
+    }
+}
+
+/**
+ * Write into a fresh Buffer each call, as the send path does, and Read back from the header offset the verification leaves.
+ * Read throughput counts the bytes up to where Read leaves the buffer, header only reads leave the payload to the caller
+ */
+template<typename Write, typename Read>
+static void MeasurePacket(const std::string& p_name, Write p_write, Read p_read)
+{
+    Buffer written;
+    p_write(written);
+    written.index = Packet::MINIMUM_HEADER_SIZE;
+    p_read(written);
+    const unsigned int readSize = static_cast<unsigned int>(written.index);
+
+    Measure(p_name + " Write", static_cast<unsigned int>(written.size), 1, [&]()
+    {
+        Buffer buffer;
+        p_write(buffer);
+    });
+    Measure(p_name + " Read", readSize, 1, [&]()
+    {
+        written.index = Packet::MINIMUM_HEADER_SIZE;
+        p_read(written);
+    });
+}
+
+static void RunPacketBenchmark()
+{
+    const ShortSharedKey key {};
+    std::vector<unsigned char> payload(Packet::MAX_PACKET_SIZE, 0xA5);
+
+    std::cout << "Packets, one Write into a new Buffer or one Read per call, HMAC included\n";
+    Buffer sequenceBuffer(Packet::SEQUENCE_HEADER_SIZE);
+    const SequenceHeader sequenceHeader { 1, 2, 0xFFFFFFFF };
+    Measure("SequenceHeader Write", Packet::SEQUENCE_HEADER_SIZE, 1, [&]()
+    {
+        sequenceBuffer.index = 0;
+        sequenceHeader.Write(sequenceBuffer);
+    });
+    Measure("SequenceHeader Read", Packet::SEQUENCE_HEADER_SIZE, 1, [&]()
+    {
+        SequenceHeader header;
+        sequenceBuffer.index = 0;
+        header.Read(sequenceBuffer);
+        s_sink += header.ackBits;
+    });
+    MeasurePacket("ConnectionRequestPacket",
+        [&](Buffer& p_buffer) { ConnectionRequestPacket{}.Write(p_buffer); },
+        [&](Buffer& p_buffer) { ConnectionRequestPacket{}.Read(p_buffer); });
+    MeasurePacket("ChallengePacket",
+        [&](Buffer& p_buffer) { ChallengePacket{}.Write(p_buffer); },
+        [&](Buffer& p_buffer) { ChallengePacket{}.Read(p_buffer); });
+    MeasurePacket("ChallengeResponsePacket",
+        [&](Buffer& p_buffer) { ChallengeResponsePacket{}.Write(p_buffer, key); },
+        [&](Buffer& p_buffer) { ChallengeResponsePacket{}.Read(p_buffer); });
+    MeasurePacket("ConnectionAcceptedPacket",
+        [&](Buffer& p_buffer) { ConnectionAcceptedPacket{ 1 }.Write(p_buffer, key); },
+        [&](Buffer& p_buffer) { ConnectionAcceptedPacket accepted; accepted.Read(p_buffer); s_sink += accepted.clientID; });
+    MeasurePacket("DisconnectPacket",
+        [&](Buffer& p_buffer) { DisconnectPacket{}.Write(p_buffer, key); },
+        [&](Buffer& p_buffer) { DisconnectPacket{}.Read(p_buffer); });
+    MeasurePacket("MtuProbeAckPacket",
+        [&](Buffer& p_buffer) { MtuProbeAckPacket{ 1, Packet::MAX_PACKET_SIZE }.Write(p_buffer, key); },
+        [&](Buffer& p_buffer) { MtuProbeAckPacket ack; ack.Read(p_buffer); s_sink += ack.size; });
+
+    for (const unsigned int size : { Packet::MIN_PACKET_SIZE, Packet::DEFAULT_PACKET_SIZE, Packet::MAX_PACKET_SIZE })
+    {
+        MeasurePacket("MtuProbePacket " + std::to_string(size) + " bytes",
+            [&](Buffer& p_buffer) { MtuProbePacket{ 1, static_cast<uint16_t>(size) }.Write(p_buffer, key); },
+            [&](Buffer& p_buffer) { MtuProbePacket probe; probe.Read(p_buffer); s_sink += probe.id; });
+    }
+
+    for (const unsigned int size : PAYLOAD_SIZES)
+    {
+        // The packet frees its game data, Write borrows the payload and hands it back
+        MeasurePacket("ConnectionDataPacket " + std::to_string(size) + " bytes",
+            [&](Buffer& p_buffer)
+            {
+                ConnectionDataPacket packet;
+                packet.gameDataSize = size;
+                packet.gameData = payload.data();
+                packet.Write(p_buffer, key);
+                packet.gameData = nullptr;
+            },
+            [&](Buffer& p_buffer) { ConnectionDataPacket packet; packet.Read(p_buffer); s_sink += packet.gameDataSize; });
+        MeasurePacket("ConnectionDataPacket::WriteShared " + std::to_string(size) + " bytes",
+            [&](Buffer& p_buffer) { ConnectionDataPacket::WriteShared(p_buffer, 0, 0, payload.data(), static_cast<uint16_t>(size - Packet::MESSAGE_HEADER_SIZE)); },
+            [&](Buffer& p_buffer) { ConnectionDataPacket packet; packet.Read(p_buffer); s_sink += packet.gameDataSize; });
+    }
+
+    for (const unsigned int size : { 16u, 256u, Packet::MIN_FRAGMENT_SIZE, Packet::MAX_FRAGMENT_SIZE })
+    {
+        MeasurePacket("ConnectionDataFragmentPacket " + std::to_string(size) + " bytes",
+            [&](Buffer& p_buffer) { ConnectionDataFragmentPacket{}.Write(p_buffer, key, payload.data(), static_cast<uint16_t>(size)); },
+            [&](Buffer& p_buffer) { ConnectionDataFragmentPacket fragment; fragment.Read(p_buffer); s_sink += fragment.messageId; });
+    }
+}
+
+void RunSerializationBenchmark()
+{
+    std::cout << "Serialization: best of " << REPEAT_COUNT << " runs of " << CALL_COUNT << " calls per row\n";
+    RunBufferBenchmark();
+    RunPacketBenchmark();
+}
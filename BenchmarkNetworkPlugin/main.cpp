@@ -0,0 +1,8 @@
+#include "Benchmarks.h"
+
+int main()
+{
+    RunRangeCoderBenchmark();
+    RunFecBenchmark();
+    RunSerializationBenchmark();
+}
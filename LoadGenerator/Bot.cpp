@@ -0,0 +1,241 @@
+#include "Bot.h"
+#include "Network/Packets/Buffer.h"
+#include "Network/Packets/Packet.h"
+
+using namespace Cryptography;
+
+bool Bot::Open(const Address& p_serverAddress, const uint8_t p_inputChannel, const unsigned int p_inputSize,
+               const clock::duration p_inputInterval, const clock::duration p_inputOffset)
+{
+    m_serverAddress = p_serverAddress;
+    m_inputChannel = p_inputChannel;
+    m_inputSize = p_inputSize < MIN_INPUT_SIZE ? MIN_INPUT_SIZE : p_inputSize;
+    m_inputInterval = p_inputInterval;
+    m_inputOffset = p_inputOffset;
+    return m_socket.Open(0);
+}
+
+void Bot::Connect(SwarmStats& p_stats)
+{
+    if (m_state != BotState::IDLE)
+        return;
+
+    KeyExchange::DiffieHellman::GenerateKeyPair(m_privateKey, m_publicKey);
+    m_state = BotState::SENDING_REQUEST;
+    m_handshakeStart = clock::now();
+    SendConnectionRequest(p_stats);
+}
+
+BotState Bot::GetState() const
+{
+    return m_state;
+}
+
+bool Bot::Send(const Buffer& p_packet, SwarmStats& p_stats)
+{
+    if (!m_socket.Send(m_serverAddress, p_packet.data, p_packet.size))
+        return false;
+    p_stats.packetsSent.fetch_add(1, std::memory_order_relaxed);
+    p_stats.bytesSent.fetch_add(static_cast<uint64_t>(p_packet.size), std::memory_order_relaxed);
+    return true;
+}
+
+void Bot::SendConnectionRequest(SwarmStats& p_stats)
+{
+    Buffer packet;
+    ConnectionRequestPacket packetInfo {m_publicKey};
+    packetInfo.Write(packet);
+    m_lastHandshakeSend = clock::now();
+    Send(packet, p_stats);
+}
+
+void Bot::RespondChallenge(SwarmStats& p_stats)
+{
+    Buffer packet;
+    ChallengeResponsePacket packetInfo;
+    packetInfo.Write(packet, m_sharedKey);
+    m_lastHandshakeSend = clock::now();
+    Send(packet, p_stats);
+}
+
+void Bot::UpdateHandshake(const clock::time_point p_now, SwarmStats& p_stats)
+{
+    if (p_now - m_handshakeStart > HANDSHAKE_TIMEOUT)
+    {
+        m_state = BotState::FAILED;
+        p_stats.handshakesFailed.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    if (p_now - m_lastHandshakeSend < HANDSHAKE_RESEND_INTERVAL)
+        return;
+
+    if (m_state == BotState::SENDING_REQUEST)
+        SendConnectionRequest(p_stats);
+    else
+        RespondChallenge(p_stats);
+}
+
+void Bot::HandlePacket(const ChallengePacket& p_packet, SwarmStats& p_stats)
+{
+    auto sharedKey = KeyExchange::DiffieHellman::GenerateSharedKey(p_packet.serverPublicKey, m_privateKey);
+    m_sharedKey = Hash::SHA256().Hash(reinterpret_cast<unsigned char*>(sharedKey.Get64BitArray()), PUBLIC_KEY_SIZE / 8);
+    m_state = BotState::SENDING_CHALLENGE_RESPONSE;
+    RespondChallenge(p_stats);
+}
+
+void Bot::HandlePacket(const ConnectionAcceptedPacket& p_packet, SwarmStats& p_stats)
+{
+    m_connection.Reset();
+    m_connection.SetId(static_cast<int>(p_packet.clientID));
+    m_inputs.Reset();
+    m_nextInput = {};
+    m_state = BotState::CONNECTED;
+    p_stats.handshakeLatency.Record(clock::now() - m_handshakeStart);
+    p_stats.handshakesCompleted.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool Bot::ReceivePacket(Buffer& p_buffer, SwarmStats& p_stats)
+{
+    Address sender;
+    p_buffer.index = 0;
+    p_buffer.size = m_socket.Receive(sender, p_buffer.data, Packet::MAX_PACKET_SIZE);
+    if (p_buffer.size <= 0)
+        return false;
+    if (!(sender == m_serverAddress))
+        return true;
+
+    p_stats.packetsReceived.fetch_add(1, std::memory_order_relaxed);
+    p_stats.bytesReceived.fetch_add(static_cast<uint64_t>(p_buffer.size), std::memory_order_relaxed);
+    m_connection.OnDatagramReceived(static_cast<uint32_t>(p_buffer.size));
+
+    const PacketType packetType = m_state == BotState::SENDING_REQUEST ? Packet::VerifyPacketCRC(p_buffer)
+                                                                        : Packet::VerifyPacketHMAC(m_sharedKey, p_buffer);
+    switch (packetType)
+    {
+        case PacketType::CHALLENGE:
+        {
+            if (m_state == BotState::SENDING_REQUEST)
+            {
+                ChallengePacket packetInfo{};
+                packetInfo.Read(p_buffer);
+                HandlePacket(packetInfo, p_stats);
+            }
+            break;
+        }
+        case PacketType::CONNECTION_ACCEPTED:
+        {
+            if (m_state == BotState::SENDING_CHALLENGE_RESPONSE)
+            {
+                ConnectionAcceptedPacket packetInfo{};
+                packetInfo.Read(p_buffer);
+                HandlePacket(packetInfo, p_stats);
+            }
+            break;
+        }
+        case PacketType::CONNECTION_DATA:
+        {
+            if (m_state == BotState::CONNECTED)
+                m_connection.ReadPacket(p_buffer);
+            break;
+        }
+        case PacketType::CONNECTION_DATA_FRAGMENT:
+        {
+            if (m_state == BotState::CONNECTED)
+                m_connection.ReadFragment(p_buffer);
+            break;
+        }
+        case PacketType::MTU_PROBE:
+        {
+            if (m_state == BotState::CONNECTED)
+            {
+                MtuProbePacket probeInfo{};
+                probeInfo.Read(p_buffer);
+                Buffer packet;
+                MtuProbeAckPacket { probeInfo.id, probeInfo.size }.Write(packet, m_sharedKey);
+                Send(packet, p_stats);
+            }
+            break;
+        }
+        case PacketType::DISCONNECT:
+        {
+            if (m_state == BotState::CONNECTED)
+                m_state = BotState::FAILED;
+            break;
+        }
+        default:
+            break;
+    }
+    return true;
+}
+
+void Bot::SendInput(const clock::time_point p_now, SwarmStats& p_stats)
+{
+    auto input = std::make_shared<std::vector<uint8_t>>(m_inputSize, static_cast<uint8_t>(m_tick));
+    const uint64_t sampleTime = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(p_now.time_since_epoch()).count());
+    std::memcpy(input->data(), &sampleTime, sizeof(sampleTime));
+
+    uint16_t ackedMessage;
+    const bool hasAck = m_connection.GetLastAckedMessage(m_inputChannel, ackedMessage);
+    const MessageData message = m_inputs.Encode(++m_tick, std::move(input), hasAck, ackedMessage);
+    uint16_t messageId;
+    if (message == nullptr || !m_connection.QueueMessage(m_inputChannel, message, &messageId))
+        return;
+
+    m_inputs.Store(messageId);
+    p_stats.inputsSent.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool Bot::SendPendingPackets(SwarmStats& p_stats)
+{
+    bool sent = false;
+    while (true)
+    {
+        Buffer packet;
+        if (!m_connection.WriteNextPacket(packet, m_sharedKey))
+            return sent;
+        sent |= Send(packet, p_stats);
+    }
+}
+
+bool Bot::Update(const clock::time_point p_now, const bool p_sendInputs, Buffer& p_receiveBuffer, SwarmStats& p_stats)
+{
+    bool active = false;
+    while (ReceivePacket(p_receiveBuffer, p_stats))
+        active = true;
+
+    switch (m_state)
+    {
+        case BotState::SENDING_REQUEST:
+        case BotState::SENDING_CHALLENGE_RESPONSE:
+            UpdateHandshake(p_now, p_stats);
+            break;
+        case BotState::CONNECTED:
+        {
+            if (p_sendInputs)
+            {
+                if (m_nextInput == clock::time_point{})
+                    m_nextInput = p_now + m_inputOffset;
+                if (p_now >= m_nextInput)
+                {
+                    SendInput(p_now, p_stats);
+                    // A worker that fell behind skips the inputs it missed rather than bursting them
+                    m_nextInput = std::max(m_nextInput + m_inputInterval, p_now);
+                    active = true;
+                }
+            }
+            active |= SendPendingPackets(p_stats);
+            break;
+        }
+        default:
+            break;
+    }
+    return active;
+}
+
+uint64_t Bot::ReadInputTime(const unsigned char* p_input, const unsigned int p_size)
+{
+    uint64_t sampleTime = 0;
+    if (p_size >= sizeof(sampleTime))
+        std::memcpy(&sampleTime, p_input, sizeof(sampleTime));
+    return sampleTime;
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include "stdafx.h"
+#include "Network/Socket.h"
+#include "Network/Connection.h"
+#include "Network/NetworkPlugin.h"
+#include "Network/Input/InputHistory.h"
+#include "Network/Statistics/LatencyHistogram.h"
+
+struct ChallengePacket;
+struct ConnectionAcceptedPacket;
+
+enum class BotState : uint8_t
+{
+    IDLE,
+    SENDING_REQUEST,
+    SENDING_CHALLENGE_RESPONSE,
+    CONNECTED,
+    FAILED
+};
+
+/**
+ * Counters shared by every bot of the swarm, updated by the worker threads
+ */
+struct SwarmStats
+{
+    std::atomic<uint64_t>   handshakesCompleted {0};
+    std::atomic<uint64_t>   handshakesFailed    {0};
+    std::atomic<uint64_t>   inputsSent          {0};
+    std::atomic<uint64_t>   packetsSent         {0};
+    std::atomic<uint64_t>   packetsReceived     {0};
+    std::atomic<uint64_t>   bytesSent           {0};
+    std::atomic<uint64_t>   bytesReceived       {0};
+    LatencyHistogram        handshakeLatency    {}; // First connection request to connection accepted
+};
+
+/**
+ * Headless client driven by a worker thread of the swarm, a state machine over its own socket instead of a Client and its
+ * network thread. It goes through the real handshake and then sends inputs on the input channel, each input starts with the
+ * time it was sampled so the server side measures how long it took to reach Listen.
+ */
+class Bot
+{
+public:
+    using clock = std::chrono::high_resolution_clock;
+
+    static constexpr std::chrono::milliseconds  HANDSHAKE_RESEND_INTERVAL   {100};
+    static constexpr std::chrono::seconds       HANDSHAKE_TIMEOUT           {10};
+    static const unsigned int                   MIN_INPUT_SIZE              {sizeof(uint64_t)}; // Room for the sample time
+
+private:
+    Socket                      m_socket            {};
+    Address                     m_serverAddress     {};
+    BotState                    m_state             {BotState::IDLE};
+    NGMP<PRIVATE_KEY_SIZE>      m_privateKey        {};
+    NGMP<PUBLIC_KEY_SIZE>       m_publicKey         {};
+    ShortSharedKey              m_sharedKey         {};
+    Connection                  m_connection        {};
+    InputSender                 m_inputs            {};
+    uint8_t                     m_inputChannel      {0};
+    unsigned int                m_inputSize         {MIN_INPUT_SIZE};
+    clock::duration             m_inputInterval     {};
+    clock::duration             m_inputOffset       {}; // Spreads the inputs of the swarm over the interval
+    uint32_t                    m_tick              {0};
+    clock::time_point           m_nextInput         {};
+    clock::time_point           m_handshakeStart    {};
+    clock::time_point           m_lastHandshakeSend {};
+
+    bool    Send(const Buffer& p_packet, SwarmStats& p_stats);
+    void    SendConnectionRequest(SwarmStats& p_stats);
+    void    RespondChallenge(SwarmStats& p_stats);
+    void    HandlePacket(const ChallengePacket& p_packet, SwarmStats& p_stats);
+    void    HandlePacket(const ConnectionAcceptedPacket& p_packet, SwarmStats& p_stats);
+    /**
+     * Read one datagram into p_buffer and handle it, false when the socket had nothing
+     */
+    bool    ReceivePacket(Buffer& p_buffer, SwarmStats& p_stats);
+    void    UpdateHandshake(clock::time_point p_now, SwarmStats& p_stats);
+    void    SendInput(clock::time_point p_now, SwarmStats& p_stats);
+    bool    SendPendingPackets(SwarmStats& p_stats);
+
+public:
+    /**
+     * Open the socket on an ephemeral port, the server tells clients apart by address and port
+     */
+    bool    Open(const Address& p_serverAddress, uint8_t p_inputChannel, unsigned int p_inputSize, clock::duration p_inputInterval,
+                 clock::duration p_inputOffset);
+    void    Connect(SwarmStats& p_stats);
+    /**
+     * Handle every waiting datagram, resend the handshake when it is due and send the inputs due when p_sendInputs is set.
+     * p_receiveBuffer is scratch space of Packet::MAX_PACKET_SIZE shared by the bots of a worker.
+     * Returns false when the bot had nothing to do
+     */
+    bool    Update(clock::time_point p_now, bool p_sendInputs, Buffer& p_receiveBuffer, SwarmStats& p_stats);
+    BotState GetState() const;
+
+    /**
+     * Sample time carried by an input, nanoseconds of clock since its epoch
+     */
+    static uint64_t ReadInputTime(const unsigned char* p_input, unsigned int p_size);
+};
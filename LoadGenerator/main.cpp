@@ -0,0 +1,260 @@
+#include "Bot.h"
+#include "Network/Server.h"
+#include "Network/Packets/Buffer.h"
+#include "Network/Packets/Packet.h"
+#include "Network/Logging/Logger.h"
+#include <iostream>
+#include <iomanip>
+#include <string>
+
+/**
+ * Hosts a Server and drives a swarm of bots against it from a few worker threads.
+ * The lobby phase measures how fast the server completes handshakes, the game phase how many inputs it takes in and how late
+ * they reach Listen. Usage: LoadGenerator [--bots N] [--threads N] [--rate HZ] [--input-size BYTES] [--duration SECONDS]
+ */
+
+using clock_type = Bot::clock;
+
+static const unsigned short     SERVER_PORT         = 8755;
+static const uint8_t            INPUT_CHANNEL       = 0;
+static const unsigned int       MAX_BOTS            = NETWORK_MAX_CLIENTS - 1; // Slot 0 is the local client
+static const unsigned int       GAME_DATA_SIZE      = 0x10000;
+static const unsigned int       PERCENTILE_COUNT    = 4;
+static const double             PERCENTILES[PERCENTILE_COUNT] = { 50.0, 90.0, 99.0, 99.9 };
+
+struct LoadSettings
+{
+    unsigned int    bots        = 256;
+    unsigned int    threads     = 4;
+    double          inputRate   = 30.0; // Inputs per second and bot
+    unsigned int    inputSize   = 16;
+    double          duration    = 10.0; // Seconds of game phase
+};
+
+/**
+ * The server and everything its thread measures, read by the main thread once the server thread is joined
+ */
+struct ServerHost
+{
+    Server                          server          {};
+    std::atomic<bool>               running         {true};
+    std::atomic<bool>               switchToGame    {false};
+    std::atomic<bool>               inGame          {false};
+    std::atomic<uint64_t>           inputsReceived  {0};
+    LatencyHistogram                inputLatency    {}; // Input sampled by a bot to input returned by Listen
+    ServerStats                     lobbyStats      {};
+    std::array<double, PERCENTILE_COUNT> handshakePercentiles {}; // Server side, latencies are reset for the game phase
+    ServerStats                     gameStats       {};
+    clock_type::time_point          gameStart       {};
+    clock_type::time_point          gameEnd         {};
+};
+
+struct Swarm
+{
+    std::vector<std::unique_ptr<Bot>>   bots        {};
+    std::atomic<bool>                   running     {true};
+    std::atomic<bool>                   sendInputs  {false};
+    SwarmStats                          stats       {};
+};
+
+static void RunServer(ServerHost& p_host)
+{
+    std::vector<unsigned char> gameData(GAME_DATA_SIZE);
+    while (p_host.running.load(std::memory_order_relaxed))
+    {
+        // The server is single threaded, the phase switch happens between two Listen
+        if (p_host.switchToGame.load(std::memory_order_relaxed) && !p_host.inGame.load(std::memory_order_relaxed))
+        {
+            p_host.server.GetStats(p_host.lobbyStats);
+            for (unsigned int i = 0; i < PERCENTILE_COUNT; ++i)
+                p_host.handshakePercentiles[i] = p_host.server.GetLatencyPercentile(LatencyMetric::HANDSHAKE, PERCENTILES[i]);
+            p_host.server.ResetLatencies();
+            p_host.server.SwitchToGame();
+            p_host.gameStart = clock_type::now();
+            p_host.inGame.store(true);
+        }
+
+        uint8_t channel;
+        const int size = p_host.server.Listen(gameData.data(), GAME_DATA_SIZE, &channel);
+        if (size <= 0 || channel != INPUT_CHANNEL)
+            continue;
+
+        // Client index + tick + input, the size leaves the client index out
+        const unsigned int inputSize = static_cast<unsigned int>(size) - sizeof(uint32_t);
+        const uint64_t sampleTime = Bot::ReadInputTime(gameData.data() + sizeof(int) + sizeof(uint32_t), inputSize);
+        p_host.inputLatency.Record(clock_type::now() - clock_type::time_point{std::chrono::duration_cast<clock_type::duration>(std::chrono::nanoseconds{sampleTime})});
+        p_host.inputsReceived.fetch_add(1, std::memory_order_relaxed);
+    }
+    p_host.gameEnd = clock_type::now();
+    p_host.server.GetStats(p_host.gameStats);
+}
+
+static void RunWorker(Swarm& p_swarm, const size_t p_first, const size_t p_last)
+{
+    Buffer receiveBuffer(Packet::MAX_PACKET_SIZE);
+    for (size_t i = p_first; i < p_last; ++i)
+        p_swarm.bots[i]->Connect(p_swarm.stats);
+
+    while (p_swarm.running.load(std::memory_order_relaxed))
+    {
+        const bool sendInputs = p_swarm.sendInputs.load(std::memory_order_relaxed);
+        const clock_type::time_point now = clock_type::now();
+        bool active = false;
+        for (size_t i = p_first; i < p_last; ++i)
+            active |= p_swarm.bots[i]->Update(now, sendInputs, receiveBuffer, p_swarm.stats);
+        if (!active)
+            std::this_thread::yield();
+    }
+}
+
+static bool ParseArguments(const int p_argc, char** p_argv, LoadSettings& o_settings)
+{
+    for (int i = 1; i + 1 < p_argc; i += 2)
+    {
+        const std::string option = p_argv[i];
+        const char* value = p_argv[i + 1];
+        if (option == "--bots")
+            o_settings.bots = static_cast<unsigned int>(std::stoul(value));
+        else if (option == "--threads")
+            o_settings.threads = static_cast<unsigned int>(std::stoul(value));
+        else if (option == "--rate")
+            o_settings.inputRate = std::stod(value);
+        else if (option == "--input-size")
+            o_settings.inputSize = static_cast<unsigned int>(std::stoul(value));
+        else if (option == "--duration")
+            o_settings.duration = std::stod(value);
+        else
+            return false;
+    }
+    if (p_argc % 2 == 0 || o_settings.bots == 0 || o_settings.threads == 0 || o_settings.inputRate <= 0.0 || o_settings.duration <= 0.0)
+        return false;
+
+    if (o_settings.bots > MAX_BOTS)
+    {
+        std::cout << "The server has room for " << MAX_BOTS << " bots, build with a larger NETWORK_MAX_CLIENTS for more\n";
+        o_settings.bots = MAX_BOTS;
+    }
+    o_settings.threads = std::min(o_settings.threads, o_settings.bots);
+    return true;
+}
+
+/**
+ * Percentiles are in microseconds, -1 when nothing was recorded
+ */
+static void PrintLatency(const char* p_name, const std::array<double, PERCENTILE_COUNT>& p_percentiles)
+{
+    std::cout << "  " << std::left << std::setw(20) << p_name << std::right;
+    for (unsigned int i = 0; i < PERCENTILE_COUNT; ++i)
+        std::cout << "  p" << std::defaultfloat << PERCENTILES[i] << " " << std::fixed << std::setw(9) << p_percentiles[i] / 1000.0 << " ms";
+    std::cout << '\n';
+}
+
+static void PrintLatency(const char* p_name, const LatencyHistogram& p_histogram)
+{
+    std::array<double, PERCENTILE_COUNT> percentiles;
+    for (unsigned int i = 0; i < PERCENTILE_COUNT; ++i)
+        percentiles[i] = p_histogram.GetPercentile(PERCENTILES[i]);
+    PrintLatency(p_name, percentiles);
+}
+
+static void PrintLatency(const char* p_name, const Server& p_server, const LatencyMetric p_metric)
+{
+    std::array<double, PERCENTILE_COUNT> percentiles;
+    for (unsigned int i = 0; i < PERCENTILE_COUNT; ++i)
+        percentiles[i] = p_server.GetLatencyPercentile(p_metric, PERCENTILES[i]);
+    PrintLatency(p_name, percentiles);
+}
+
+int main(const int p_argc, char** p_argv)
+{
+    LoadSettings settings;
+    try
+    {
+        if (!ParseArguments(p_argc, p_argv, settings))
+        {
+            std::cout << "Usage: LoadGenerator [--bots N] [--threads N] [--rate HZ] [--input-size BYTES] [--duration SECONDS]\n";
+            return 1;
+        }
+    }
+    catch (std::exception&)
+    {
+        std::cout << "Invalid argument value\n";
+        return 1;
+    }
+    Logger::SetLevel(LogLevel::WARNING);
+    std::cout << std::fixed << std::setprecision(3);
+
+    auto host = std::make_unique<ServerHost>();
+    host->server.SetInputChannel(INPUT_CHANNEL);
+
+    Swarm swarm;
+    const auto inputInterval = std::chrono::duration_cast<clock_type::duration>(std::chrono::duration<double>{1.0 / settings.inputRate});
+    for (unsigned int i = 0; i < settings.bots; ++i)
+    {
+        swarm.bots.push_back(std::make_unique<Bot>());
+        if (!swarm.bots.back()->Open({127, 0, 0, 1, SERVER_PORT}, INPUT_CHANNEL, settings.inputSize, inputInterval, inputInterval * i / settings.bots))
+        {
+            std::cout << "Unable to open the socket of bot " << i << '\n';
+            return 1;
+        }
+    }
+
+    std::thread serverThread(RunServer, std::ref(*host));
+    std::vector<std::thread> workers;
+    const clock_type::time_point lobbyStart = clock_type::now();
+    for (unsigned int t = 0; t < settings.threads; ++t)
+        workers.emplace_back(RunWorker, std::ref(swarm), swarm.bots.size() * t / settings.threads, swarm.bots.size() * (t + 1) / settings.threads);
+
+    // Failed bots gave up after Bot::HANDSHAKE_TIMEOUT, the lobby phase ends when every bot is settled
+    while (swarm.stats.handshakesCompleted.load() + swarm.stats.handshakesFailed.load() < settings.bots)
+        std::this_thread::sleep_for(std::chrono::milliseconds{10});
+    const double lobbySeconds = std::chrono::duration<double>(clock_type::now() - lobbyStart).count();
+
+    host->switchToGame.store(true);
+    while (!host->inGame.load())
+        std::this_thread::yield();
+    const uint64_t handshakePacketsSent = swarm.stats.packetsSent.load();
+    const uint64_t handshakeBytesSent = swarm.stats.bytesSent.load();
+    swarm.sendInputs.store(true);
+    std::this_thread::sleep_for(std::chrono::duration<double>{settings.duration});
+    swarm.sendInputs.store(false);
+    // Let the inputs in flight land before the server stops counting
+    std::this_thread::sleep_for(std::chrono::milliseconds{200});
+
+    swarm.running.store(false);
+    for (auto& worker : workers)
+        worker.join();
+    host->running.store(false);
+    serverThread.join();
+
+    const uint64_t completed = swarm.stats.handshakesCompleted.load();
+    std::cout << "Lobby: " << settings.bots << " bots on " << settings.threads << " threads\n";
+    std::cout << "  connected " << completed << " failed " << swarm.stats.handshakesFailed.load() << " in " << lobbySeconds << " s, "
+              << completed / lobbySeconds << " handshakes/s\n";
+    PrintLatency("bot handshake", swarm.stats.handshakeLatency);
+    PrintLatency("server handshake", host->handshakePercentiles);
+
+    const ServerStats& lobby = host->lobbyStats;
+    const ServerStats& game = host->gameStats;
+    const double gameSeconds = std::chrono::duration<double>(host->gameEnd - host->gameStart).count();
+    const uint64_t inputsSent = swarm.stats.inputsSent.load();
+    const uint64_t inputsReceived = host->inputsReceived.load();
+    std::cout << "Game: " << settings.inputRate << " inputs/s of " << settings.inputSize << " bytes per bot for " << settings.duration << " s\n";
+    std::cout << "  inputs sent " << inputsSent << " received " << inputsReceived << " ("
+              << (inputsSent > 0 ? 100.0 * inputsReceived / inputsSent : 0.0) << " %), " << inputsReceived / gameSeconds << " inputs/s\n";
+    std::cout << "  server received " << (game.packetsReceived - lobby.packetsReceived) / gameSeconds << " packets/s "
+              << (game.bytesReceived - lobby.bytesReceived) / gameSeconds / 1024.0 << " KiB/s, sent "
+              << (game.packetsSent - lobby.packetsSent) / gameSeconds << " packets/s "
+              << (game.bytesSent - lobby.bytesSent) / gameSeconds / 1024.0 << " KiB/s\n";
+    std::cout << "  bots sent " << (swarm.stats.packetsSent.load() - handshakePacketsSent) / gameSeconds << " packets/s "
+              << (swarm.stats.bytesSent.load() - handshakeBytesSent) / gameSeconds / 1024.0 << " KiB/s, server lost "
+              << game.lostPackets - lobby.lostPackets << " packets, "
+              << (game.checksumFailures - lobby.checksumFailures) + (game.authenticationFailures - lobby.authenticationFailures) << " rejected\n";
+    PrintLatency("input to Listen", host->inputLatency);
+    PrintLatency("server HMAC verify", host->server, LatencyMetric::HMAC_VERIFY);
+    PrintLatency("server delivery", host->server, LatencyMetric::DELIVERY);
+
+    swarm.bots.clear();
+    host.reset();
+    NetworkAPI::ShutdownSockets();
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include "stdafx.h"
+#include "Network/Capture/PacketCapture.h"
+#include "Network/NetworkPlugin.h"
+
+class Address;
+
+/**
+ * Plays the received datagrams of a capture file back in place of the socket.
+ * At original speed a datagram is handed out once as much time went by since the replay started as between it and the first
+ * received datagram of the capture, at maximum speed every call hands out the next one.
+ * Used from the thread that listens on the socket.
+ */
+class CaptureReplay
+{
+public:
+    using clock = std::chrono::high_resolution_clock;
+
+private:
+    HANDLE                      m_file              {INVALID_HANDLE_VALUE};
+    HANDLE                      m_mapping           {nullptr};
+    const unsigned char*        m_view              {nullptr};
+    uint64_t                    m_end               {0};
+    uint64_t                    m_offset            {0};
+    uint64_t                    m_lastOffset        {0}; // Record handed out last, the keys of its sessions follow it
+    uint16_t                    m_recordSize        {0};
+    bool                        m_realTime          {false};
+    bool                        m_started           {false};
+    clock::time_point           m_startTime         {};
+    uint64_t                    m_firstTimestamp    {0};
+    std::atomic<bool>           m_active            {false};
+    std::atomic<uint64_t>       m_replayedCount     {0};
+
+    /**
+     * Moves m_offset to the next received record or to the end of the capture
+     */
+    void    SkipToReceived();
+    bool    IsDue(const CaptureRecordHeader& p_record);
+    CaptureRecordHeader ReadRecordHeader(uint64_t p_offset) const;
+
+public:
+    CaptureReplay() = default;
+    CaptureReplay(const CaptureReplay&) = delete;
+    CaptureReplay& operator=(const CaptureReplay&) = delete;
+    ~CaptureReplay();
+
+    bool    Open(const char* p_path, bool p_realTime);
+    void    Close();
+    bool    IsActive() const;
+    /**
+     * True once every received datagram of the capture was handed out
+     */
+    bool    IsFinished() const;
+
+    /**
+     * Same contract as Socket::Receive, -1 when no datagram is due yet
+     */
+    int     Receive(Address& o_sender, unsigned char* o_data, int p_size);
+    /**
+     * Waits until a datagram is due or p_timeout elapsed, returns true when one is due
+     */
+    bool    WaitForData(std::chrono::microseconds p_timeout);
+
+    /**
+     * Replaces o_key by the key the capture recorded for the next session with p_address, false when there is none
+     */
+    bool    FindSessionKey(const Address& p_address, ShortSharedKey& o_key) const;
+
+    uint64_t GetReplayedCount() const;
+};
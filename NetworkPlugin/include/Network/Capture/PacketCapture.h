@@ -0,0 +1,86 @@
+#pragma once
+#include "stdafx.h"
+
+class Address;
+
+enum class CaptureRecordType : uint8_t
+{
+    SENT,
+    RECEIVED,
+    SESSION_KEY // Shared key of a session established with the endpoint, replays need it to verify the session's packets
+};
+
+#pragma pack(push, 1)
+/**
+ * Starts a capture file, dataSize is the number of record bytes that follow and is written when the capture stops
+ */
+struct CaptureFileHeader
+{
+    uint32_t    magic       {0};
+    uint16_t    version     {0};
+    uint16_t    recordSize  {0}; // Size of CaptureRecordHeader, so readers can skip fields they don't know
+    uint64_t    dataSize    {0};
+};
+
+/**
+ * Precedes the datagram or key bytes of every record
+ */
+struct CaptureRecordHeader
+{
+    uint64_t            timestamp   {0}; // Nanoseconds since the capture started
+    uint32_t            address     {0}; // Remote endpoint in host byte order
+    uint16_t            port        {0};
+    uint16_t            size        {0};
+    CaptureRecordType   type        {CaptureRecordType::SENT};
+};
+#pragma pack(pop)
+
+/**
+ * Records every datagram going through a socket into a memory mapped file.
+ * Space is reserved with an atomic bump of the write offset, so recording is a copy into the mapping and never a system call.
+ * When the mapping is full records are dropped and counted, the file is cut down to what was written when the capture stops.
+ * The file holds the session keys next to the traffic, it must be kept as private as the keys themselves.
+ */
+class PacketCapture
+{
+public:
+    using clock = std::chrono::high_resolution_clock;
+
+    static const uint32_t       MAGIC               {0x5043504E}; // "NPCP"
+    static const uint16_t       VERSION             {1};
+    static const uint64_t       DEFAULT_CAPACITY    {64ull * 1024 * 1024};
+
+private:
+    HANDLE                      m_file              {INVALID_HANDLE_VALUE};
+    HANDLE                      m_mapping           {nullptr};
+    unsigned char*              m_view              {nullptr};
+    uint64_t                    m_capacity          {0};
+    clock::time_point           m_startTime         {};
+    std::atomic<bool>           m_recording         {false};
+    std::atomic<uint32_t>       m_writers           {0}; // Records being copied, the mapping stays until they are done
+    std::atomic<uint64_t>       m_writeOffset       {0};
+    std::atomic<uint64_t>       m_recordCount       {0};
+    std::atomic<uint64_t>       m_droppedCount      {0};
+
+    bool    Reserve(uint64_t p_size, uint64_t& o_offset);
+    void    WriteHeader(uint64_t p_offset, CaptureRecordType p_type, const Address& p_address, uint16_t p_size) const;
+
+public:
+    PacketCapture() = default;
+    PacketCapture(const PacketCapture&) = delete;
+    PacketCapture& operator=(const PacketCapture&) = delete;
+    ~PacketCapture();
+
+    bool    Start(const char* p_path, uint64_t p_capacity = DEFAULT_CAPACITY);
+    void    Stop();
+    bool    IsRecording() const;
+
+    void    Record(CaptureRecordType p_type, const Address& p_address, const unsigned char* p_data, int p_size);
+    /**
+     * Records the buffers as a single datagram, the way they were gathered on the wire
+     */
+    void    Record(CaptureRecordType p_type, const Address& p_address, const WSABUF* p_buffers, unsigned int p_bufferCount);
+
+    uint64_t GetRecordCount() const;
+    uint64_t GetDroppedCount() const;
+};
@@ -0,0 +1,135 @@
+#pragma once
+#include "stdafx.h"
+#include <deque>
+#include <memory>
+#include "Network/Reliability/SequenceBuffer.h"
+#include "Network/Channels/ParityGroup.h"
+
+enum class ChannelMode : uint8_t
+{
+    UNRELIABLE,             // Delivered as received, may be lost or out of order
+    UNRELIABLE_SEQUENCED,   // May be lost, messages older than the last delivered one are dropped
+    RELIABLE_ORDERED        // Resent until acked and delivered in order
+};
+
+using MessageData = std::shared_ptr<const std::vector<uint8_t>>;
+
+struct Message
+{
+    uint8_t         channel     {0};
+    uint16_t        id          {0};
+    MessageData     data        {};
+    bool            parity      {false}; // Parity of a group of messages, its id is the one of the group's first message
+};
+
+/**
+ * Message queues of one channel of a connection.
+ * Each channel has its own message sequence so a lost reliable message never holds back the others.
+ */
+class Channel
+{
+public:
+    using clock = std::chrono::high_resolution_clock;
+
+    static const unsigned int                           MESSAGE_WINDOW_SIZE         {256};
+    static const unsigned int                           MAX_SEND_QUEUE_SIZE         {256};
+    static const unsigned int                           ACKED_MESSAGE_BUFFER_SIZE   {1024};
+
+private:
+    struct SentMessage
+    {
+        MessageData         data        {};
+        clock::time_point   lastSent    {};
+        bool                sent        {false};
+    };
+
+    struct ReceivedMessage
+    {
+        MessageData         data        {};
+        clock::time_point   arrival     {}; // When the datagram carrying it, or the parity rebuilding it, was read
+    };
+
+    ChannelMode                                         m_mode                  {ChannelMode::UNRELIABLE};
+    uint8_t                                             m_index                 {0};
+
+    uint16_t                                            m_sendSequence          {0};
+    uint16_t                                            m_oldestUnackedMessage  {0};
+    std::deque<Message>                                 m_sendQueue             {};
+    SequenceBuffer<SentMessage, MESSAGE_WINDOW_SIZE>    m_sentMessages          {};
+    SequenceBuffer<bool, ACKED_MESSAGE_BUFFER_SIZE>     m_ackedMessages         {}; // Whether the acked message was delivered, for sequenced channels
+    uint16_t                                            m_lastAckedMessage      {0};
+    bool                                                m_hasAckedMessage       {false};
+    uint16_t                                            m_newestAckedPacket     {0};
+    bool                                                m_hasAckedPacket        {false};
+
+    uint16_t                                            m_receiveSequence       {0};
+    uint16_t                                            m_lastReceivedPacket    {0};
+    uint16_t                                            m_lastReceivedMessage   {0};
+    bool                                                m_hasReceived           {false};
+    SequenceBuffer<ReceivedMessage, MESSAGE_WINDOW_SIZE> m_receivedMessages     {};
+    std::deque<ReceivedMessage>                         m_receiveQueue          {};
+
+    ParityEncoder                                       m_parityEncoder         {};
+    Message                                             m_pendingParity         {};
+    ParityDecoder                                       m_parityDecoder         {};
+
+    void        Deliver(uint16_t p_packetSequence, uint16_t p_id, MessageData p_data, bool p_recovered, clock::time_point p_arrival);
+    void        RecoverMessages(clock::time_point p_arrival);
+
+public:
+    void        Reset();
+    void        SetIndex(uint8_t p_index);
+    void        SetMode(ChannelMode p_mode);
+    ChannelMode GetMode() const;
+    /**
+     * Send a parity message after every p_groupSize messages, 0 disables it.
+     * Messages are then sent one per packet so a lost packet can be rebuilt by the receiver
+     */
+    void        SetParityGroupSize(unsigned int p_groupSize);
+    unsigned int GetParityGroupSize() const;
+
+    /**
+     * Queue a message, returns false when the queue or the reliable window is full.
+     * o_id receives the id the message is sent with
+     */
+    bool        Send(MessageData p_data, uint16_t* o_id = nullptr);
+    /**
+     * Number an unreliable message serialized outside of the send queue
+     */
+    uint16_t    TakeMessageId();
+
+    /**
+     * Next message of at most p_maxSize bytes to put on the wire: queued unreliable messages, then new or timed out reliable ones
+     */
+    bool        GetNextMessage(clock::time_point p_now, clock::duration p_resendTime, uint32_t p_maxSize, Message& o_message);
+    bool        HasMessagesToSend() const;
+    /**
+     * Shed queued messages when the connection is out of send budget:
+     * unreliable ones are dropped, sequenced ones merged into the most recent, reliable ones are kept
+     */
+    void        TrimSendQueue();
+    /**
+     * Acks of a packet must be processed from the newest packet to the oldest so sequenced deliveries are known
+     */
+    void        OnMessageAcked(uint16_t p_id, uint16_t p_packetSequence);
+    /**
+     * Most recent message id known to have been received by the other side
+     */
+    bool        GetLastAckedMessage(uint16_t& o_id) const;
+    /**
+     * Whether a recently sent message is known to have been received, old messages are reported as not acked
+     */
+    bool        IsMessageAcked(uint16_t p_id) const;
+    /**
+     * Whether a recently sent message is known to have reached the game on the other side: reliable messages once every older one is acked,
+     * sequenced ones unless a newer packet of the channel may have arrived first and made the receiver drop them
+     */
+    bool        IsMessageDelivered(uint16_t p_id) const;
+
+    void        ProcessMessage(uint16_t p_packetSequence, uint16_t p_id, MessageData p_data, clock::time_point p_arrival = {});
+    void        ProcessParity(MessageData p_parity, clock::time_point p_arrival = {});
+    /**
+     * Next message ready for the game, o_arrival receives when it arrived so delivery latency can be measured
+     */
+    bool        Receive(MessageData& o_data, clock::time_point* o_arrival = nullptr);
+};
@@ -0,0 +1,70 @@
+#pragma once
+#include "stdafx.h"
+#include <memory>
+#include "Network/Reliability/SequenceBuffer.h"
+
+/**
+ * XOR parity over groups of messages of a channel.
+ * A parity message is the group's message ids followed by the XOR of every message as 16 bits size + data, padded to the longest one.
+ * Messages of a protected channel are sent one per packet, so the receiver rebuilds any single lost packet of a group
+ * from the others and the parity without waiting for a resend.
+ */
+class ParityEncoder
+{
+public:
+    static const unsigned int   MAX_GROUP_SIZE      {16};
+    static const unsigned int   MAX_PROTECTED_SIZE  {1000}; // Larger messages can be fragmented and aren't protected
+
+private:
+    unsigned int            m_groupSize     {0};
+    std::vector<uint16_t>   m_ids           {};
+    std::vector<uint8_t>    m_parity        {};
+
+public:
+    void            Reset();
+    /**
+     * 0 disables parity, sizes are clamped to MAX_GROUP_SIZE
+     */
+    void            SetGroupSize(unsigned int p_groupSize);
+    unsigned int    GetGroupSize() const;
+
+    /**
+     * Add a message sent for the first time, returns true with the parity message when it completes a group
+     */
+    bool            Add(uint16_t p_id, const std::vector<uint8_t>& p_data, std::shared_ptr<const std::vector<uint8_t>>& o_parity);
+};
+
+/**
+ * Receiving side of ParityEncoder: remembers recent messages and rebuilds the only missing message of a group.
+ * Recovered messages are remembered too, so a late copy of the original is recognized as a duplicate.
+ */
+class ParityDecoder
+{
+public:
+    static const unsigned int   RECEIVED_BUFFER_SIZE    {256};
+    static const unsigned int   MAX_PENDING_PARITY      {8};
+
+private:
+    using MessageData = std::shared_ptr<const std::vector<uint8_t>>;
+
+    SequenceBuffer<MessageData, RECEIVED_BUFFER_SIZE>   m_received      {};
+    std::array<MessageData, MAX_PENDING_PARITY>         m_pending       {}; // Parities still missing more than one message
+    unsigned int                                        m_nextPending   {0};
+
+    /**
+     * Returns true when the parity is resolved, either used for o_data or useless
+     */
+    bool    Resolve(const std::vector<uint8_t>& p_parity, bool& o_recovered, uint16_t& o_id, MessageData& o_data);
+
+public:
+    void    Reset();
+    /**
+     * Remember a received message, returns false when it was already received or recovered
+     */
+    bool    AddMessage(uint16_t p_id, const MessageData& p_data);
+    void    AddParity(MessageData p_parity);
+    /**
+     * Rebuild the next message made recoverable by the messages and parities received so far
+     */
+    bool    Recover(uint16_t& o_id, MessageData& o_data);
+};
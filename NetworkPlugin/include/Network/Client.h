@@ -3,8 +3,19 @@
 #include "Socket.h"
 #include "Address.h"
 #include "NetworkPlugin.h"
+#include "Connection.h"
+#include "Network/Snapshots/SnapshotHistory.h"
+#include "Network/Snapshots/JitterBuffer.h"
+#include "Network/Replication/ReplicationClient.h"
+#include "Network/Threading/SpscRing.h"
+#include "Network/Threading/TripleBuffer.h"
+#include "Network/Statistics/LatencyHistogram.h"
+#include "Network/Input/InputHistory.h"
+#include "Network/Input/PredictionBuffer.h"
 
 
+typedef void(__stdcall * InterpolationCallback) (const unsigned char* from, unsigned int fromSize, const unsigned char* to, unsigned int toSize, float alpha);
+
 struct ConnectionAcceptedPacket;
 struct ChallengePacket;
 struct DisconnectPacket;
@@ -24,6 +35,34 @@ private:
 
     static const uint16_t                   CLIENT_PORT         {0};
     static const uint16_t                   SERVER_PORT         {8755};
+    static const unsigned int               RING_SIZE           {1024};
+    static constexpr std::chrono::milliseconds  HANDSHAKE_RESEND_INTERVAL   {250};
+    static constexpr std::chrono::seconds       HANDSHAKE_TIMEOUT           {5};
+    static constexpr std::chrono::milliseconds  NETWORK_THREAD_WAIT         {1};
+
+    /**
+     * Message handed between the game thread and the network thread, a null message announces a new connection
+     */
+    struct QueuedMessage
+    {
+        MessageData     data        {};
+        uint8_t         channel     {0};
+        double          receivedAt  {0.0};
+        bool            isInput     {false};
+        uint32_t        tick        {0};
+        clock::time_point arrival   {};
+    };
+
+    /**
+     * Connection state published by the network thread for the game thread's getters
+     */
+    struct PublishedState
+    {
+        ConnectionStats     stats               {};
+        uint16_t            lastSentSequence    {0};
+        double              serverTime          {-1.0}; // Seconds, -1 until the clocks are synchronized
+        clock::time_point   publishedAt         {};
+    };
 
     std::random_device                      m_random            {};
     std::uniform_int_distribution<uint64_t> m_saltDistribution  {};
@@ -36,27 +75,186 @@ private:
     //uint64_t                                m_serverSalt        {0};
     Address                                 m_serverAddress     {};
     Socket                                  m_socket            {};
-    int                                     m_index             {-1};
+    std::atomic<int>                        m_index             {-1};
     std::atomic<ClientState>                m_state             {ClientState::DISCONNECTED};
     clock::time_point                       m_lastReceivedPacket;
-    uint16_t                                m_sequence          {0};
-    uint16_t                                m_ack               {0};
-    bool                                    m_activeTimeout     {false};
+    Connection                              m_connection        {};
+    SnapshotReceiver                        m_snapshots         {};
+    uint8_t                                 m_snapshotChannel   {Connection::MAX_CHANNELS};
+    JitterBuffer                            m_jitterBuffer      {};
+    bool                                    m_useJitterBuffer   {false};
+    InterpolationCallback                   m_interpolationCallback {nullptr};
+    ReplicationClient                       m_replication       {};
+    uint8_t                                 m_replicationChannels[2] {Connection::MAX_CHANNELS, Connection::MAX_CHANNELS};
+    InputSender                             m_inputs            {};
+    uint8_t                                 m_inputChannel      {Connection::MAX_CHANNELS};
+    PredictionBuffer                        m_prediction        {};
+    std::atomic<bool>                       m_activeTimeout     {false};
+    clock::time_point                       m_handshakeStart    {}; // Of the current handshake step, for its timeout
+    clock::time_point                       m_connectRequestTime {}; // First connection request, for the handshake duration
+    clock::time_point                       m_lastHandshakeSend {};
+
+    std::thread                             m_networkThread     {};
+    std::atomic<std::thread::id>            m_networkThreadId   {}; // Set by the thread itself, m_networkThread is still being assigned when it starts
+    std::atomic<bool>                       m_runNetworkThread  {false};
+    std::atomic<bool>                       m_connectRequested  {false};
+    std::atomic<bool>                       m_disconnectRequested {false};
+    SpscRing<QueuedMessage, RING_SIZE>      m_outgoing          {}; // Game thread to network thread
+    SpscRing<QueuedMessage, RING_SIZE>      m_incoming          {}; // Network thread to game thread
+    mutable TripleBuffer<PublishedState>    m_published         {}; // Network thread to game thread
+    std::array<LatencyHistogram, static_cast<size_t>(LatencyMetric::COUNT)> m_latencies {};
 
     void SetupBroadcastSocket();
+    void SendConnectionRequest();
     void RespondChallenge();
+    /**
+     * Resend the pending handshake packet at regular intervals, give up after HANDSHAKE_TIMEOUT
+     */
+    void UpdateHandshake(clock::time_point p_now);
+    /**
+     * Read and handle one datagram from the socket, returns false when none was waiting
+     */
+    bool ReceivePacket();
     void HandlePacket(const ChallengePacket& p_packet);
     void HandlePacket(const ConnectionAcceptedPacket& p_packet);
+    /**
+     * Route a received message to replication, snapshots or the caller, returns the size copied to o_gameData
+     */
+    int  HandleMessage(uint8_t p_channel, MessageData p_data, double p_receivedAt, unsigned char* o_gameData, unsigned int p_size, uint8_t* o_channel);
+    void ResetReceivedState();
+    bool QueueInput(uint32_t p_tick, MessageData p_input);
+    void SendPendingPackets();
     void Disconnect();
+    void RunNetworkThread();
+    bool IsNetworkThread() const;
+    /**
+     * Refuse a configuration change the network thread would race with, returns true when it is running
+     */
+    bool IsConfigurationLocked(const char* p_setting) const;
+    PublishedState GetPublishedState() const;
+    static double GetLocalMilliseconds();
 public:
     Client();
     ~Client();
     void Connect();
     void SendDisconnect();
-    int Listen(unsigned char* o_gameData, unsigned int p_size);
-    bool SendGameData(const unsigned char* p_data, unsigned int p_size);
+    /**
+     * Move socket, handshake and connection work to a dedicated thread, Listen and SendGameData then only exchange
+     * messages with it through lock-free rings. Channels, inputs, compression and callbacks must be configured before starting it,
+     * their setters are refused while it runs
+     */
+    void StartNetworkThread();
+    void StopNetworkThread();
+    int Listen(unsigned char* o_gameData, unsigned int p_size, uint8_t* o_channel = nullptr);
+    /**
+     * Queue game data, queued messages are coalesced into datagrams on the next Listen or Flush
+     */
+    bool SendGameData(const unsigned char* p_data, unsigned int p_size, uint8_t p_channel = 0);
+    void Flush();
+    /**
+     * Dedicate a channel to snapshots, messages received on it are rebuilt from their delta before being returned by Listen
+     */
+    void SetSnapshotChannel(uint8_t p_channel);
+    /**
+     * Hold snapshots in a jitter buffer instead of returning them from Listen,
+     * Interpolate then plays them out after a delay adapted to the measured jitter
+     */
+    void SetJitterBuffer(bool p_enabled);
+    void RegisterInterpolationCallback(InterpolationCallback p_callback);
+    /**
+     * Call the interpolation callback with the two snapshots around the current render time, once per frame
+     */
+    bool Interpolate();
+    /**
+     * Delay added by the jitter buffer on top of the transit time in milliseconds
+     */
+    double GetBufferingDelay() const;
+    /**
+     * Dedicate channels to entity replication, messages received on them are applied to the entities instead of being returned by Listen
+     */
+    void SetReplicationChannels(uint8_t p_reliableChannel, uint8_t p_unreliableChannel);
+    /**
+     * Dedicate an unreliable channel to inputs, each input is sent with the last p_redundancy inputs the server hasn't acked.
+     * The server must use the same channel
+     */
+    void SetInputChannel(uint8_t p_channel, uint8_t p_redundancy = InputSender::DEFAULT_REDUNDANCY);
+    /**
+     * Queue the input of a tick, ticks must increase
+     */
+    bool SendInput(uint32_t p_tick, const unsigned char* p_data, unsigned int p_size);
+    /**
+     * Predicted states within p_tolerance of the authoritative ones are kept, when states are arrays of floats. 0 compares bytes
+     */
+    void SetPredictionTolerance(float p_tolerance);
+    /**
+     * Record the input applied locally at a tick and the state it predicted
+     */
+    bool StorePrediction(uint32_t p_tick, const unsigned char* p_input, unsigned int p_inputSize, const unsigned char* p_state, unsigned int p_stateSize);
+    /**
+     * Replace the predicted state of a tick while simulating it again after a misprediction
+     */
+    bool UpdatePrediction(uint32_t p_tick, const unsigned char* p_state, unsigned int p_size);
+    /**
+     * Compare the authoritative state of a tick received from the server with its prediction.
+     * Returns the number of ticks to simulate again from o_firstTick with GetPredictedInput, 0 if the prediction holds, -1 for a stale state
+     */
+    int  Reconcile(uint32_t p_tick, const unsigned char* p_state, unsigned int p_size, uint32_t& o_firstTick);
+    /**
+     * Copy the input stored for a tick, returns its size or -1 if the tick isn't in the history or o_input is too small
+     */
+    int  GetPredictedInput(uint32_t p_tick, unsigned char* o_input, unsigned int p_size) const;
+    bool PollEntityEvent(ReplicationClient::Event& o_event);
+    bool GetEntityField(uint32_t p_entityId, uint8_t p_field, void* o_value) const;
+    void ConfigureChannel(uint8_t p_channel, ChannelMode p_mode);
+    /**
+     * Send a parity message every p_groupSize messages of a channel and rebuild lost packets from received parities,
+     * 0 disables it. The server must enable it on the same channel
+     */
+    void SetChannelParity(uint8_t p_channel, uint8_t p_groupSize);
+    /**
+     * Compress game data with an optional dictionary trained offline, the server must use the same one
+     */
+    void SetCompression(bool p_enabled, const uint8_t* p_dictionary = nullptr, unsigned int p_dictionarySize = 0);
 
     void SetActiveTimeout(bool p_value);
+    void RegisterPacketAckedCallback(PacketAckedCallback p_callback);
+
+    uint16_t GetLastSentSequence() const;
+    /**
+     * Smoothed RTT and RTT variance to the server in milliseconds, -1 until the first measure
+     */
+    double   GetRoundTripTime() const;
+    double   GetRoundTripTimeVariance() const;
+    /**
+     * Estimate of Server::GetTime, -1 until the clocks are synchronized
+     */
+    double   GetServerTime() const;
+    /**
+     * Counters of the connection to the server, as of the last network thread iteration when it runs like the RTT and sequence getters
+     */
+    void     GetConnectionStats(ConnectionStats& o_stats);
+    /**
+     * Latency distribution of a metric in microseconds, FAN_OUT is only measured on the server
+     */
+    bool     GetLatencySummary(LatencyMetric p_metric, LatencySummary& o_summary) const;
+    double   GetLatencyPercentile(LatencyMetric p_metric, double p_percentile) const;
+    void     ResetLatencies();
+    /**
+     * Record every datagram the client sends and receives to a file, see PacketCapture
+     */
+    bool     StartCapture(const char* p_path);
+    void     StopCapture();
+    /**
+     * Feed the datagrams a capture received to Listen instead of the socket's, nothing is sent while replaying.
+     * Connect after starting the replay so the recorded handshake is accepted, the network thread must not be running
+     */
+    bool     StartReplay(const char* p_path, bool p_realTime);
+    void     StopReplay();
+    bool     IsReplayFinished() const;
+    /**
+     * Delay, drop, duplicate and reorder the datagrams of this client to test it on a bad network, default conditions turn it off
+     */
+    void     SetNetworkConditions(const NetworkConditions& p_conditions);
 
     int  GetIndex() const;
     char GetState() const;
@@ -69,10 +267,48 @@ extern "C"
     NETWORK_PLUGIN_API void     Internal_ClientDestroy(Client* p_obj);
     NETWORK_PLUGIN_API void     Internal_ClientConnect(Client* p_obj);
     NETWORK_PLUGIN_API void     Internal_ClientDisconnect(Client* p_obj);
+    NETWORK_PLUGIN_API void     Internal_ClientStartNetworkThread(Client* p_obj);
+    NETWORK_PLUGIN_API void     Internal_ClientStopNetworkThread(Client* p_obj);
     NETWORK_PLUGIN_API int      Internal_ClientListen(Client* p_obj, unsigned char* o_gameData, unsigned int p_size);
+    NETWORK_PLUGIN_API int      Internal_ClientListenWithChannel(Client* p_obj, unsigned char* o_gameData, unsigned int p_size, unsigned char* o_channel);
     NETWORK_PLUGIN_API bool     Internal_ClientSendGameData(Client* p_obj, const unsigned char* p_data, unsigned int p_size);
+    NETWORK_PLUGIN_API bool     Internal_ClientSendGameDataOnChannel(Client* p_obj, const unsigned char* p_data, unsigned int p_size, unsigned char p_channel);
+    NETWORK_PLUGIN_API void     Internal_ClientFlush(Client* p_obj);
+    NETWORK_PLUGIN_API void     Internal_ClientSetSnapshotChannel(Client* p_obj, unsigned char p_channel);
+    NETWORK_PLUGIN_API void     Internal_ClientSetJitterBuffer(Client* p_obj, bool p_enabled);
+    NETWORK_PLUGIN_API void     Internal_ClientRegisterInterpolationCallback(Client* p_obj, InterpolationCallback p_callback);
+    NETWORK_PLUGIN_API bool     Internal_ClientInterpolate(Client* p_obj);
+    NETWORK_PLUGIN_API double   Internal_ClientGetBufferingDelay(Client* p_obj);
+    NETWORK_PLUGIN_API void     Internal_ClientSetInputChannel(Client* p_obj, unsigned char p_channel, unsigned char p_redundancy);
+    NETWORK_PLUGIN_API bool     Internal_ClientSendInput(Client* p_obj, unsigned int p_tick, const unsigned char* p_data, unsigned int p_size);
+    NETWORK_PLUGIN_API void     Internal_ClientSetPredictionTolerance(Client* p_obj, float p_tolerance);
+    NETWORK_PLUGIN_API bool     Internal_ClientStorePrediction(Client* p_obj, unsigned int p_tick, const unsigned char* p_input, unsigned int p_inputSize, const unsigned char* p_state, unsigned int p_stateSize);
+    NETWORK_PLUGIN_API bool     Internal_ClientUpdatePrediction(Client* p_obj, unsigned int p_tick, const unsigned char* p_state, unsigned int p_size);
+    NETWORK_PLUGIN_API int      Internal_ClientReconcile(Client* p_obj, unsigned int p_tick, const unsigned char* p_state, unsigned int p_size, unsigned int* o_firstTick);
+    NETWORK_PLUGIN_API int      Internal_ClientGetPredictedInput(Client* p_obj, unsigned int p_tick, unsigned char* o_input, unsigned int p_size);
+    NETWORK_PLUGIN_API void     Internal_ClientSetReplicationChannels(Client* p_obj, unsigned char p_reliableChannel, unsigned char p_unreliableChannel);
+    NETWORK_PLUGIN_API bool     Internal_ClientPollEntityEvent(Client* p_obj, unsigned char* o_event, unsigned int* o_entityId, unsigned short* o_entityType, unsigned int* o_fieldMask);
+    NETWORK_PLUGIN_API bool     Internal_ClientGetEntityField(Client* p_obj, unsigned int p_entityId, unsigned char p_field, void* o_value);
+    NETWORK_PLUGIN_API void     Internal_ClientSetCompression(Client* p_obj, bool p_enabled, const unsigned char* p_dictionary, unsigned int p_dictionarySize);
+    NETWORK_PLUGIN_API void     Internal_ClientConfigureChannel(Client* p_obj, unsigned char p_channel, unsigned char p_mode);
+    NETWORK_PLUGIN_API void     Internal_ClientSetChannelParity(Client* p_obj, unsigned char p_channel, unsigned char p_groupSize);
 
     NETWORK_PLUGIN_API void     Internal_ClientSetActiveTimeout(Client* p_obj, bool p_value);
+    NETWORK_PLUGIN_API void     Internal_ClientRegisterPacketAckedCallback(Client* p_obj, PacketAckedCallback p_callback);
+    NETWORK_PLUGIN_API int      Internal_ClientGetLastSentSequence(Client* p_obj);
+    NETWORK_PLUGIN_API double   Internal_ClientGetRoundTripTime(Client* p_obj);
+    NETWORK_PLUGIN_API double   Internal_ClientGetRoundTripTimeVariance(Client* p_obj);
+    NETWORK_PLUGIN_API double   Internal_ClientGetServerTime(Client* p_obj);
+    NETWORK_PLUGIN_API void     Internal_ClientGetConnectionStats(Client* p_obj, ConnectionStats* o_stats);
+    NETWORK_PLUGIN_API bool     Internal_ClientGetLatencySummary(Client* p_obj, unsigned char p_metric, LatencySummary* o_summary);
+    NETWORK_PLUGIN_API double   Internal_ClientGetLatencyPercentile(Client* p_obj, unsigned char p_metric, double p_percentile);
+    NETWORK_PLUGIN_API void     Internal_ClientResetLatencies(Client* p_obj);
+    NETWORK_PLUGIN_API bool     Internal_ClientStartCapture(Client* p_obj, const char* p_path);
+    NETWORK_PLUGIN_API void     Internal_ClientStopCapture(Client* p_obj);
+    NETWORK_PLUGIN_API bool     Internal_ClientStartReplay(Client* p_obj, const char* p_path, bool p_realTime);
+    NETWORK_PLUGIN_API void     Internal_ClientStopReplay(Client* p_obj);
+    NETWORK_PLUGIN_API bool     Internal_ClientIsReplayFinished(Client* p_obj);
+    NETWORK_PLUGIN_API void     Internal_ClientSetNetworkConditions(Client* p_obj, const NetworkConditions* p_conditions);
 
     NETWORK_PLUGIN_API int      Internal_ClientGetIndex(Client* p_obj);
     NETWORK_PLUGIN_API char     Internal_ClientGetState(Client* p_obj);
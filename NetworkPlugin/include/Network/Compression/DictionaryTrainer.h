@@ -0,0 +1,34 @@
+#pragma once
+#include "stdafx.h"
+#include <unordered_map>
+#include "Network/NetworkPlugin.h"
+
+/**
+ * Builds a compression dictionary offline from captured payloads.
+ * Samples are cut in segments scored by how common their k-grams are across all samples,
+ * the best segments are picked greedily and the k-grams they cover stop counting for the next ones.
+ * The best segments end up last in the dictionary, where offsets are the shortest.
+ */
+class DictionaryTrainer
+{
+    static uint64_t ReadGram(const uint8_t* p_data);
+    static uint64_t ScoreSegment(const uint8_t* p_segment, unsigned int p_size, const std::unordered_map<uint64_t, uint32_t>& p_frequencies);
+
+public:
+    static constexpr unsigned int   GRAM_SIZE       {8};
+    static constexpr unsigned int   SEGMENT_SIZE    {64};
+
+    /**
+     * Returns the size of the dictionary written in o_dictionary
+     */
+    static unsigned int Train(const uint8_t* p_samples, const unsigned int* p_sampleSizes, unsigned int p_sampleCount,
+                              uint8_t* o_dictionary, unsigned int p_capacity);
+};
+
+#pragma region CExport
+extern "C"
+{
+    NETWORK_PLUGIN_API unsigned int Internal_TrainCompressionDictionary(const unsigned char* p_samples, const unsigned int* p_sampleSizes, unsigned int p_sampleCount,
+                                                                        unsigned char* o_dictionary, unsigned int p_capacity);
+}
+#pragma endregion
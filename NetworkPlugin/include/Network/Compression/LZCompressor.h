@@ -0,0 +1,63 @@
+#pragma once
+#include "stdafx.h"
+#include "Network/NetworkPlugin.h"
+
+/**
+ * Byte oriented LZ77 compressor with an optional static dictionary.
+ * The dictionary acts as data preceding every block, so small packets can reference content seen offline.
+ * Sequences are: token (literal length << 4 | match length - MIN_MATCH), extra literal length bytes, literals,
+ * 16 bits little endian offset, extra match length bytes. The last sequence only has literals.
+ */
+class LZCompressor
+{
+public:
+    static const unsigned int   MIN_MATCH           {4};
+    static const unsigned int   MAX_OFFSET          {0xFFFF};
+    static const unsigned int   MAX_DICTIONARY_SIZE {MAX_OFFSET};
+    static const unsigned int   HASH_LOG            {12};
+    static const unsigned int   HASH_SIZE           {1u << HASH_LOG};
+
+private:
+    /**
+     * Positions of the block being compressed, entries stamped by an older block fall back to the dictionary table so it is never copied
+     */
+    struct SourceTable
+    {
+        struct Entry
+        {
+            uint32_t    stamp       {0};
+            uint32_t    position    {0};
+        };
+
+        std::array<Entry, HASH_SIZE>    entries     {};
+        uint32_t                        stamp       {0};
+    };
+
+    std::vector<uint8_t>    m_dictionary        {};
+    std::vector<uint32_t>   m_dictionaryTable   = std::vector<uint32_t>(HASH_SIZE); // Dictionary positions + 1, 0 when empty
+
+    static SourceTable& GetSourceTable();
+    static uint32_t Hash(const uint8_t* p_data);
+    static bool     WriteLength(uint8_t*& p_output, const uint8_t* p_end, uint32_t p_length);
+    static bool     ReadLength(const uint8_t*& p_input, const uint8_t* p_end, uint32_t& o_length);
+    static bool     WriteSequence(uint8_t*& p_output, const uint8_t* p_end, const uint8_t* p_literals, uint32_t p_literalLength,
+                                  uint32_t p_offset, uint32_t p_matchLength);
+
+public:
+    LZCompressor() = default;
+    LZCompressor(const uint8_t* p_dictionary, unsigned int p_size);
+
+    /**
+     * Only the last MAX_DICTIONARY_SIZE bytes of the dictionary can be referenced
+     */
+    void        SetDictionary(const uint8_t* p_dictionary, unsigned int p_size);
+
+    /**
+     * Returns the compressed size, or 0 when the result doesn't fit in p_capacity
+     */
+    uint32_t    Compress(const uint8_t* p_source, uint32_t p_size, uint8_t* o_destination, uint32_t p_capacity) const;
+    /**
+     * Returns false when the data is malformed or doesn't decompress to exactly p_size bytes
+     */
+    bool        Decompress(const uint8_t* p_source, uint32_t p_size, uint8_t* o_destination, uint32_t p_decompressedSize) const;
+};
@@ -0,0 +1,117 @@
+#pragma once
+#include "stdafx.h"
+#include "Network/Packets/Buffer.h"
+
+/**
+ * Adaptive probability of a binary decision being 0, in units of 1 / PROBABILITY_ONE.
+ * Models learn while coding, so the encoder and the decoder must go through the same models in the same order.
+ */
+struct BitModel
+{
+    static const uint32_t   PROBABILITY_BITS    {11};
+    static const uint32_t   PROBABILITY_ONE     {1u << PROBABILITY_BITS};
+    static const uint32_t   MOVE_BITS           {5}; // Adaptation speed, higher is slower
+
+    uint16_t    probability {PROBABILITY_ONE / 2};
+};
+
+/**
+ * Binary range encoder writing bytes through a Buffer.
+ * A decision with probability p costs -log2(p) bits, so values that keep repeating cost a fraction of a bit.
+ * Flush must be called once everything is encoded to write the pending bytes.
+ */
+class RangeEncoder
+{
+    static const uint32_t   TOP     {1u << 24};
+
+    Buffer&     m_buffer;
+    uint64_t    m_low       {0};
+    uint32_t    m_range     {0xFFFFFFFF};
+    uint8_t     m_cache     {0};
+    uint64_t    m_cacheSize {1};
+    bool        m_firstByte {true}; // The first byte never carries and is always 0, it isn't written
+
+    void    ShiftLow();
+
+public:
+    explicit RangeEncoder(Buffer& p_buffer);
+
+    void    EncodeBit(BitModel& p_model, uint32_t p_bit);
+    /**
+     * Encode the p_count lowest bits of p_value with a fixed 1/2 probability, p_count <= 32
+     */
+    void    EncodeDirectBits(uint32_t p_value, unsigned int p_count);
+    void    Flush();
+};
+
+/**
+ * Binary range decoder reading bytes through a Buffer.
+ * Reading past the end of the buffer yields zeros, corrupted data decodes to garbage values rather than failing.
+ */
+class RangeDecoder
+{
+    static const uint32_t   TOP     {1u << 24};
+
+    Buffer&     m_buffer;
+    uint32_t    m_range     {0xFFFFFFFF};
+    uint32_t    m_code      {0};
+
+    uint8_t     NextByte();
+
+public:
+    explicit RangeDecoder(Buffer& p_buffer);
+
+    uint32_t    DecodeBit(BitModel& p_model);
+    uint32_t    DecodeDirectBits(unsigned int p_count);
+};
+
+/**
+ * Model of a BITS wide symbol, such as an enum, coded most significant bit first.
+ * Each bit has its own model depending on the bits before it, so any symbol distribution can be learned.
+ */
+template<unsigned int BITS>
+class BitTreeModel
+{
+    static_assert(BITS > 0 && BITS <= 16, "Bit tree models have 2^BITS probabilities");
+
+    std::array<BitModel, 1u << BITS>    m_models    {};
+
+public:
+    void Encode(RangeEncoder& p_encoder, uint32_t p_symbol)
+    {
+        uint32_t node = 1;
+        for (unsigned int i = BITS; i-- > 0;)
+        {
+            const uint32_t bit = (p_symbol >> i) & 1;
+            p_encoder.EncodeBit(m_models[node], bit);
+            node = (node << 1) | bit;
+        }
+    }
+
+    uint32_t Decode(RangeDecoder& p_decoder)
+    {
+        uint32_t node = 1;
+        for (unsigned int i = 0; i < BITS; ++i)
+            node = (node << 1) | p_decoder.DecodeBit(m_models[node]);
+        return node - (1u << BITS);
+    }
+};
+
+/**
+ * Model of a quantized signed value, typically a delta against the previous value of a field.
+ * Values are coded as zero flag, sign, bit length and the bits below the leading one,
+ * so zero costs a fraction of a bit once it is frequent and small magnitudes stay cheap.
+ * Use one model per field so each one learns its own distribution.
+ * Models are copyable: start every packet from the same initial models (fresh or trained on recorded data),
+ * as adaptive state carried from packet to packet would desynchronize when a packet is lost.
+ */
+class IntegerModel
+{
+    BitModel            m_zero          {};
+    BitModel            m_sign          {};
+    BitTreeModel<5>     m_length        {}; // Bit length - 1 of the magnitude
+
+public:
+    void        Encode(RangeEncoder& p_encoder, int32_t p_value);
+    int32_t     Decode(RangeDecoder& p_decoder);
+};
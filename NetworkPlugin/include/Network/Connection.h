@@ -0,0 +1,197 @@
+#pragma once
+#include "stdafx.h"
+#include "Network/Packets/Packet.h"
+#include "Network/Reliability/SequenceBuffer.h"
+#include "Network/Reliability/CongestionController.h"
+#include "Network/Reliability/TimeSync.h"
+#include "Network/Reliability/MtuDiscovery.h"
+#include "Network/Channels/Channel.h"
+#include "Network/Packets/FragmentReassembler.h"
+#include "Network/Compression/LZCompressor.h"
+#include "Network/Statistics/NetworkStats.h"
+
+typedef void(__stdcall * PacketAckedCallback) (int id, unsigned short sequence);
+
+/**
+ * Per-connection reliability state.
+ * Every outgoing packet carries the most recent received sequence and a bitfield of the previous ones,
+ * so the sender learns which of its packets arrived without dedicated ack packets.
+ * Game data goes through channels, messages are acked when a packet carrying them is acked.
+ * Packets larger than the path MTU found by probing are sent as fragments and reassembled on the other side.
+ * Channels with parity send one message per packet plus a parity message per group, so a lost packet is rebuilt without a resend.
+ * Sending is paced by a congestion controller fed with the RTT of acked packets and the packets the peer reported missing.
+ * Data packets carry timestamps at regular intervals to estimate the RTT and the offset to the remote clock.
+ */
+class Connection
+{
+public:
+    using clock = std::chrono::high_resolution_clock;
+
+    static const unsigned int                               SEQUENCE_BUFFER_SIZE    {1024};
+    static const uint8_t                                    MAX_CHANNELS            {4};
+    static constexpr std::chrono::milliseconds              RESEND_TIME             {100};
+    static constexpr double                                 LOSS_RATE_SMOOTHING     {0.05}; // Weight of each acked or lost packet in the loss rate
+    static constexpr std::array<ChannelMode, MAX_CHANNELS>  DEFAULT_CHANNEL_MODES   {ChannelMode::UNRELIABLE_SEQUENCED, ChannelMode::RELIABLE_ORDERED,
+                                                                                     ChannelMode::UNRELIABLE, ChannelMode::UNRELIABLE};
+
+private:
+    struct SentPacketData
+    {
+        bool                                        acked               {false};
+        clock::time_point                           sendTime            {};
+        uint32_t                                    size                {0};
+        std::vector<std::pair<uint8_t, uint16_t>>   messages            {};
+    };
+
+    struct ReceivedPacketData
+    {
+    };
+
+    SequenceBuffer<SentPacketData, SEQUENCE_BUFFER_SIZE>     m_sentPackets           {};
+    SequenceBuffer<ReceivedPacketData, SEQUENCE_BUFFER_SIZE> m_receivedPackets       {};
+    uint16_t                                                m_sequence              {0};
+    int                                                     m_id                    {-1};
+    PacketAckedCallback                                     m_packetAckedCallback   {nullptr};
+    std::array<Channel, MAX_CHANNELS>                       m_channels              {};
+    std::shared_ptr<const LZCompressor>                     m_compressor            {};
+    CongestionController                                    m_congestion            {};
+    uint16_t                                                m_remoteAck             {0}; // Newest ack received, its window tells which packets the peer missed
+    bool                                                    m_hasRemoteAck          {false};
+    TimeSync                                                m_timeSync              {};
+    clock::time_point                                       m_timeOrigin            {clock::now()};
+    MtuDiscovery                                            m_mtu                   {};
+    ConnectionStats                                         m_stats                 {};
+    bool                                                    m_hasReceivedPacket     {false};
+
+    FragmentReassembler                                     m_reassembler           {};
+    std::unique_ptr<Buffer>                                 m_fragmentPayload       {};
+    SequenceHeader                                          m_fragmentHeader        {};
+    uint8_t                                                 m_fragmentChannel       {0};
+    uint16_t                                                m_fragmentMessageId     {0};
+    uint16_t                                                m_fragmentSize          {0};
+    uint8_t                                                 m_fragmentCount         {0};
+    uint8_t                                                 m_nextFragment          {0};
+
+    void            OnPacketAcked(uint16_t p_sequence, clock::time_point p_now);
+    void            DetectLostPackets(uint16_t p_ack, clock::time_point p_now);
+    void            StartFragments(const SequenceHeader& p_header, const Message& p_message);
+    void            WriteNextFragment(Buffer& o_packet, const ShortSharedKey& p_sharedKey);
+    bool            ReadPayload(const SequenceHeader& p_header, Buffer& p_payload, clock::time_point p_arrival);
+    void            ReadMessages(const SequenceHeader& p_header, Buffer& p_gameData, uint32_t p_gameDataSize, clock::time_point p_arrival);
+
+public:
+    Connection();
+
+    void            Reset();
+    void            SetId(int p_id);
+    void            SetPacketAckedCallback(PacketAckedCallback p_callback);
+    /**
+     * Compress outgoing game data and allow compressed incoming game data, nullptr disables compression
+     */
+    void            SetCompressor(std::shared_ptr<const LZCompressor> p_compressor);
+
+    /**
+     * Reserve the sequence of the next outgoing packet and fill its acks
+     */
+    SequenceHeader  GenerateSendHeader();
+
+    /**
+     * Record a received packet and process the acks it carries.
+     * Returns false for duplicates and packets too old to be tracked.
+     */
+    bool            ProcessReceivedHeader(const SequenceHeader& p_header);
+
+    /**
+     * Whether the congestion controller allows sending another packet now
+     */
+    bool            HasSendBudget();
+    /**
+     * Account a datagram sent under a header from GenerateSendHeader, fragments of a packet add up
+     */
+    void            OnPacketSent(uint16_t p_sequence, uint32_t p_size);
+    /**
+     * Number an unreliable message serialized outside of the channel queues
+     */
+    uint16_t        TakeMessageId(uint8_t p_channel);
+    /**
+     * Attach a message numbered with TakeMessageId to a packet from GenerateSendHeader, so its ack reaches the channel
+     */
+    void            OnMessageSent(uint16_t p_sequence, uint8_t p_channel, uint16_t p_id);
+    float           GetSendRate() const;
+
+    /**
+     * Local times are measured from the time origin, the server uses its start time so clients can read its clock
+     */
+    void            SetTimeOrigin(clock::time_point p_origin);
+    /**
+     * Microseconds since the time origin
+     */
+    uint64_t        GetLocalTime() const;
+    bool            HasTimeSync() const;
+    /**
+     * Smoothed RTT and RTT variance in milliseconds
+     */
+    double          GetRoundTripTime() const;
+    double          GetRoundTripTimeVariance() const;
+    /**
+     * Estimate of the remote local time, in microseconds since its time origin
+     */
+    uint64_t        GetRemoteTime() const;
+
+    /**
+     * Write the next path MTU probe if one is due, sent as is without a sequence
+     */
+    bool            WriteMtuProbe(Buffer& o_packet, const ShortSharedKey& p_sharedKey);
+    void            OnMtuProbeFailed();
+    void            OnMtuProbeAcked(const MtuProbeAckPacket& p_packet);
+    /**
+     * Largest datagram for the path, data packets are packed and fragmented to this size
+     */
+    unsigned int    GetMaxPacketSize() const;
+
+    void            ConfigureChannel(uint8_t p_channel, ChannelMode p_mode);
+    ChannelMode     GetChannelMode(uint8_t p_channel) const;
+    /**
+     * Protect a channel with one parity message every p_groupSize messages, 0 disables it. Both sides must enable it
+     */
+    void            SetParityGroupSize(uint8_t p_channel, unsigned int p_groupSize);
+    bool            QueueMessage(uint8_t p_channel, MessageData p_data, uint16_t* o_id = nullptr);
+    bool            GetLastAckedMessage(uint8_t p_channel, uint16_t& o_id) const;
+    bool            IsMessageAcked(uint8_t p_channel, uint16_t p_id) const;
+    /**
+     * Whether a message was handed to the game on the other side, see Channel::IsMessageDelivered
+     */
+    bool            IsMessageDelivered(uint8_t p_channel, uint16_t p_id) const;
+
+    /**
+     * Serialize as many pending messages as fit in the path MTU into an authenticated data packet,
+     * or the next fragment of a larger one. Returns false when nothing is left to send or the send budget is spent,
+     * in which case queued unreliable messages are dropped and sequenced ones merged into the most recent
+     */
+    bool            WriteNextPacket(Buffer& o_packet, const ShortSharedKey& p_sharedKey);
+
+    /**
+     * Read a data packet after its protocol and type, returns false when the packet was a duplicate
+     */
+    bool            ReadPacket(Buffer& p_packet);
+    /**
+     * Read a data packet fragment after its protocol and type, returns true when it completed a packet
+     */
+    bool            ReadFragment(Buffer& p_packet);
+    /**
+     * Next message ready for the game, o_arrival receives when the datagram carrying it was read
+     */
+    bool            ReceiveMessage(uint8_t& o_channel, MessageData& o_data, clock::time_point* o_arrival = nullptr);
+
+    bool            IsAcked(uint16_t p_sequence) const;
+    uint16_t        GetLastSentSequence() const;
+    uint16_t        GetRemoteSequence() const;
+
+    /**
+     * Account a datagram received from the remote address before it is verified
+     */
+    void            OnDatagramReceived(uint32_t p_size);
+    void            OnAuthenticationFailed();
+    void            OnChecksumFailed();
+    ConnectionStats GetStats() const;
+};
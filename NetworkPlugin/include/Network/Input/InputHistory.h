@@ -0,0 +1,77 @@
+#pragma once
+#include "stdafx.h"
+#include <deque>
+#include "Network/Channels/Channel.h"
+#include "Network/Reliability/SequenceBuffer.h"
+
+/**
+ * Recent inputs of a client by tick.
+ * Every input is sent together with the previous inputs the server hasn't acked yet, so a lost packet is covered
+ * by the next one without a resend. Inputs are written newest first, each one delta encoded against the one before it.
+ * Message: Count + NewestTick, then per input: TickGap + Size + EncodedSize + encoded input
+ */
+class InputSender
+{
+public:
+    static const unsigned int   HISTORY_SIZE        {64};
+    static const unsigned int   DEFAULT_REDUNDANCY  {8};
+    static const unsigned int   HEADER_SIZE         {sizeof(uint8_t) + sizeof(uint32_t)};
+    static const unsigned int   ENTRY_HEADER_SIZE   {sizeof(uint8_t) + 2 * sizeof(uint16_t)};
+    static const unsigned int   MAX_INPUT_SIZE      {0xFFFF};
+    // Older inputs are left out past this size so the message fits a datagram on any path
+    static const unsigned int   MAX_MESSAGE_SIZE    {Packet::MIN_PACKET_SIZE - Packet::CONNECTION_DATA_PACKET_SIZE - Packet::MESSAGE_HEADER_SIZE - Hash::HMAC::SIZE};
+
+private:
+    struct Input
+    {
+        bool            valid       {false};
+        uint32_t        tick        {0};
+        MessageData     data        {};
+    };
+
+    std::array<Input, HISTORY_SIZE>                 m_inputs        {};
+    bool                                            m_hasInput      {false};
+    uint32_t                                        m_newestTick    {0};
+    bool                                            m_hasAckedTick  {false};
+    uint32_t                                        m_ackedTick     {0};
+    SequenceBuffer<uint32_t, HISTORY_SIZE>          m_messageTicks  {}; // Newest tick carried by each sent message
+    unsigned int                                    m_redundancy    {DEFAULT_REDUNDANCY};
+
+public:
+    void        Reset();
+    /**
+     * Number of unacked previous inputs sent with each new one, at most HISTORY_SIZE - 1
+     */
+    void        SetRedundancy(unsigned int p_redundancy);
+
+    /**
+     * Record the input of a tick and encode it with the unacked ones before it.
+     * p_ackedMessage is the last acked message of the input channel when p_hasAck is set.
+     * Returns nullptr when the tick isn't newer than the previous one
+     */
+    MessageData Encode(uint32_t p_tick, MessageData p_input, bool p_hasAck, uint16_t p_ackedMessage);
+    void        Store(uint16_t p_messageId);
+};
+
+/**
+ * Inputs received from one client, each tick is delivered once and in order, older ticks arriving late are dropped
+ */
+class InputReceiver
+{
+public:
+    static const unsigned int   MAX_PENDING_INPUTS  {256};
+
+private:
+    bool                                            m_hasTick       {false};
+    uint32_t                                        m_lastTick      {0};
+    std::deque<std::pair<uint32_t, MessageData>>    m_pending       {};
+
+public:
+    void        Reset();
+
+    /**
+     * Queue the inputs of a message newer than the last delivered tick, returns false when the message is malformed
+     */
+    bool        Decode(const MessageData& p_message);
+    bool        Receive(uint32_t& o_tick, MessageData& o_input);
+};
@@ -0,0 +1,63 @@
+#pragma once
+#include "stdafx.h"
+#include <array>
+#include <vector>
+
+/**
+ * Inputs and predicted states of the client by tick, for client side prediction.
+ * When the authoritative state of a tick arrives it is compared with the prediction of that tick,
+ * on a mismatch the prediction is replaced and every later tick has to be simulated again from the stored inputs.
+ * Entries keep their buffers between ticks so storing a prediction doesn't allocate once the ring is warm.
+ */
+class PredictionBuffer
+{
+public:
+    static const unsigned int   HISTORY_SIZE    {128};
+
+private:
+    struct Entry
+    {
+        bool                    valid       {false};
+        uint32_t                tick        {0};
+        std::vector<uint8_t>    input       {};
+        std::vector<uint8_t>    state       {};
+    };
+
+    std::array<Entry, HISTORY_SIZE>     m_entries           {};
+    bool                                m_hasTick           {false};
+    uint32_t                            m_newestTick        {0};
+    bool                                m_hasConfirmedTick  {false};
+    uint32_t                            m_confirmedTick     {0};
+    float                               m_tolerance         {0.0f};
+
+    Entry*          Find(uint32_t p_tick);
+    const Entry*    Find(uint32_t p_tick) const;
+    bool            Matches(const std::vector<uint8_t>& p_predicted, const uint8_t* p_state, unsigned int p_size) const;
+
+public:
+    void    Reset();
+    /**
+     * States are compared as arrays of floats within p_tolerance when it is above 0, byte for byte otherwise
+     */
+    void    SetTolerance(float p_tolerance);
+
+    /**
+     * Record the input applied at a tick and the state it predicted, ticks must increase
+     */
+    bool    Store(uint32_t p_tick, const uint8_t* p_input, unsigned int p_inputSize, const uint8_t* p_state, unsigned int p_stateSize);
+    /**
+     * Replace the state of a tick while simulating it again
+     */
+    bool    UpdateState(uint32_t p_tick, const uint8_t* p_state, unsigned int p_size);
+
+    /**
+     * Compare the authoritative state of a tick with its prediction.
+     * Returns the number of ticks to simulate again starting at o_firstTick, 0 when the prediction was right
+     * and -1 when the tick is older than the last reconciled one or than the history
+     */
+    int     Reconcile(uint32_t p_tick, const uint8_t* p_state, unsigned int p_size, uint32_t& o_firstTick);
+
+    const std::vector<uint8_t>* GetInput(uint32_t p_tick) const;
+    const std::vector<uint8_t>* GetState(uint32_t p_tick) const;
+    bool    GetNewestTick(uint32_t& o_tick) const;
+};
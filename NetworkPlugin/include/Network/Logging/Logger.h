@@ -0,0 +1,187 @@
+#pragma once
+#include "stdafx.h"
+#include "export.h"
+
+/**
+ * Log a line from a hot or error path, p_level is a LogLevel value without its scope.
+ * The format uses {} placeholders, arguments are copied as is and only formatted on the logger thread.
+ * Each call site delivers at most Logger::MAX_LINES_PER_SITE lines per Logger::RATE_WINDOW, the rest are counted and reported.
+ */
+#define NETWORK_LOG(p_level, ...)                                                   \
+    do                                                                              \
+    {                                                                               \
+        static LogSite networkLogSite;                                              \
+        if (Logger::IsEnabled(LogLevel::p_level))                                   \
+            Logger::Log(networkLogSite, LogLevel::p_level, __VA_ARGS__);            \
+    } while (false)
+
+enum class LogLevel : uint8_t
+{
+    VERBOSE,    // Handshake steps and other per packet events
+    INFO,
+    WARNING,
+    FAILURE,    // ERROR is a Windows macro
+    OFF
+};
+
+/**
+ * Rate limiting state of one NETWORK_LOG call site
+ */
+struct LogSite
+{
+    std::atomic<int64_t>    windowStart {0}; // Milliseconds since the logger origin
+    std::atomic<uint32_t>   count       {0};
+    std::atomic<uint32_t>   suppressed  {0};
+};
+
+/**
+ * Leveled logger that keeps g_debugCallback off the receive path.
+ * Lines are queued in a bounded lock-free multi-producer queue, a full queue drops the line and counts it instead of waiting.
+ * A background thread formats them and hands every line gathered during FLUSH_INTERVAL to the callback in one call.
+ */
+class Logger
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    static const unsigned int                   QUEUE_SIZE          {1024};
+    static const unsigned int                   MAX_ARGUMENTS       {4};
+    static const unsigned int                   TEXT_SIZE           {128}; // Shared by the string arguments of a line, longer ones are cut
+    static const unsigned int                   MAX_LINES_PER_SITE  {10};
+    static constexpr std::chrono::seconds       RATE_WINDOW         {1};
+    static constexpr std::chrono::milliseconds  FLUSH_INTERVAL      {10};
+
+private:
+    enum class ArgumentType : uint8_t
+    {
+        SIGNED,
+        UNSIGNED,
+        REAL,
+        TEXT
+    };
+
+    struct Argument
+    {
+        ArgumentType    type        {ArgumentType::SIGNED};
+        int64_t         integer     {0};
+        uint64_t        unsignedInteger {0};
+        double          real        {0.0};
+        uint16_t        textOffset  {0};
+        uint16_t        textSize    {0};
+    };
+
+    struct Record
+    {
+        LogLevel                            level           {LogLevel::INFO};
+        const char*                         format          {nullptr};
+        uint32_t                            suppressed      {0};
+        uint8_t                             argumentCount   {0};
+        std::array<Argument, MAX_ARGUMENTS> arguments       {};
+        uint16_t                            textSize        {0};
+        std::array<char, TEXT_SIZE>         text            {};
+    };
+
+    struct Cell
+    {
+        std::atomic<uint32_t>   sequence    {0};
+        Record                  record      {};
+    };
+
+    static constexpr unsigned int   CACHE_LINE_SIZE {64};
+
+    std::array<Cell, QUEUE_SIZE>                        m_cells             {};
+    alignas(CACHE_LINE_SIZE) std::atomic<uint32_t>      m_enqueuePosition   {0};
+    alignas(CACHE_LINE_SIZE) uint32_t                   m_dequeuePosition   {0}; // Owned by whoever drains, the thread or a flush without it
+    std::atomic<uint64_t>                               m_dropped           {0};
+    std::atomic<LogLevel>                               m_level             {LogLevel::INFO};
+    std::atomic<bool>                                   m_started           {false};
+    std::atomic<bool>                                   m_running           {false};
+    std::atomic<uint64_t>                               m_flushRequests     {0};
+    std::atomic<uint64_t>                               m_flushesDone       {0};
+    std::thread                                         m_thread            {};
+    const clock::time_point                             m_origin            {clock::now()};
+
+    Logger();
+
+    static Logger&  Get();
+
+    bool            Allow(LogSite& p_site, uint32_t& o_suppressed);
+    /**
+     * Reserve the next free cell, nullptr when the queue is full
+     */
+    Cell*           Claim(uint32_t& o_position);
+    void            Publish(Cell& p_cell, uint32_t p_position);
+    void            Run();
+    void            Drain();
+    static void     Format(const Record& p_record, std::string& o_line);
+
+    static void     SetArgument(Record& p_record, Argument& o_argument, const char* p_value);
+    static void     SetArgument(Record& p_record, Argument& o_argument, const std::string& p_value);
+    static void     SetArgument(Record& p_record, Argument& o_argument, double p_value);
+    template<typename T, typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value, int>::type = 0>
+    static void     SetArgument(Record&, Argument& o_argument, const T p_value)
+    {
+        if (std::is_signed<T>::value)
+        {
+            o_argument.type = ArgumentType::SIGNED;
+            o_argument.integer = static_cast<int64_t>(p_value);
+        }
+        else
+        {
+            o_argument.type = ArgumentType::UNSIGNED;
+            o_argument.unsignedInteger = static_cast<uint64_t>(p_value);
+        }
+    }
+
+    static void     SetArguments(Record&, unsigned int) {}
+    template<typename T, typename... Rest>
+    static void     SetArguments(Record& p_record, const unsigned int p_index, const T& p_value, const Rest&... p_rest)
+    {
+        SetArgument(p_record, p_record.arguments[p_index], p_value);
+        SetArguments(p_record, p_index + 1, p_rest...);
+    }
+
+public:
+    static void     SetLevel(LogLevel p_level);
+    static bool     IsEnabled(LogLevel p_level);
+
+    template<typename... Args>
+    static void     Log(LogSite& p_site, const LogLevel p_level, const char* p_format, const Args&... p_arguments)
+    {
+        static_assert(sizeof...(Args) <= MAX_ARGUMENTS, "Too many log arguments");
+        Logger& logger = Get();
+        uint32_t suppressed;
+        if (!logger.Allow(p_site, suppressed))
+            return;
+
+        uint32_t position;
+        Cell* cell = logger.Claim(position);
+        if (cell == nullptr)
+            return;
+        Record& record = cell->record;
+        record.level = p_level;
+        record.format = p_format;
+        record.suppressed = suppressed;
+        record.argumentCount = static_cast<uint8_t>(sizeof...(Args));
+        record.textSize = 0;
+        SetArguments(record, 0, p_arguments...);
+        logger.Publish(*cell, position);
+    }
+
+    /**
+     * Deliver every queued line before returning, blocks the caller
+     */
+    static void     Flush();
+    /**
+     * Stop the logger thread after delivering the queued lines, the next line starts it again
+     */
+    static void     Shutdown();
+};
+
+#pragma region CExport
+extern "C"
+{
+    NETWORK_PLUGIN_API void     Internal_LoggerSetLevel(unsigned char p_level);
+    NETWORK_PLUGIN_API void     Internal_LoggerFlush();
+}
+#pragma endregion
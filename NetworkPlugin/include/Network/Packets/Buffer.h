@@ -16,7 +16,7 @@ struct Buffer
     void        WriteShort(uint16_t p_value);
     void        WriteByte(uint8_t  p_value);
     void        WriteFloat(float p_value);
-    void        WriteBuffer(unsigned char* p_buffer, unsigned int p_size);
+    void        WriteBuffer(const unsigned char* p_buffer, unsigned int p_size);
 
     uint64_t    ReadLongLong();
     uint32_t    ReadInteger();
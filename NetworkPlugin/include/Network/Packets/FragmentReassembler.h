@@ -0,0 +1,51 @@
+#pragma once
+#include "stdafx.h"
+#include <memory>
+#include "Network/Packets/Packet.h"
+
+/**
+ * Rebuilds data packets split in fragments, keyed by channel and message id.
+ * Memory is bounded by MAX_ENTRIES packets of at most MAX_FRAGMENT_COUNT fragments,
+ * incomplete packets are dropped after TIMEOUT or when a newer packet needs their slot.
+ * The fragment size depends on the path MTU of the sender, fragments are stored in MAX_FRAGMENT_SIZE slots
+ * and packed together once the packet is complete.
+ */
+class FragmentReassembler
+{
+public:
+    using clock = std::chrono::high_resolution_clock;
+
+    static const unsigned int                   MAX_ENTRIES     {16};
+    static constexpr std::chrono::milliseconds  TIMEOUT         {1000};
+
+private:
+    struct Entry
+    {
+        bool                                        inUse           {false};
+        uint8_t                                     channel         {0};
+        uint16_t                                    messageId       {0};
+        uint8_t                                     fragmentCount   {0};
+        uint8_t                                     receivedCount   {0};
+        uint16_t                                    fragmentSize    {0}; // Size of every fragment but the last, 0 until one arrived
+        uint16_t                                    lastSize        {0};
+        std::bitset<Packet::MAX_FRAGMENT_COUNT>     received        {};
+        uint32_t                                    size            {0};
+        std::unique_ptr<Buffer>                     payload         {};
+        clock::time_point                           firstReceived   {};
+    };
+
+    std::array<Entry, MAX_ENTRIES>  m_entries   {};
+
+    Entry*  FindEntry(uint8_t p_channel, uint16_t p_messageId);
+    Entry*  AllocateEntry(clock::time_point p_now);
+
+public:
+    void    Reset();
+
+    /**
+     * Store a fragment, returns the payload of the packet once its last fragment arrived.
+     * Duplicate, inconsistent or overlapping fragments are ignored.
+     */
+    std::unique_ptr<Buffer> AddFragment(const ConnectionDataFragmentPacket& p_fragment, const unsigned char* p_data,
+                                        unsigned int p_size, clock::time_point p_now);
+};
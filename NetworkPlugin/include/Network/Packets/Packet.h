@@ -6,6 +6,8 @@
 
 using namespace Cryptography;
 
+class LZCompressor;
+
 enum class PacketType : uint8_t
 {
     INVALID_PACKET,
@@ -15,34 +17,49 @@ enum class PacketType : uint8_t
     CONNECTION_ACCEPTED,
     CONNECTION_DATA,
     DISCONNECT,
+    CONNECTION_DATA_FRAGMENT,
+    MTU_PROBE,
+    MTU_PROBE_ACK,
 };
 
 class Packet
 {
 public:
     static const    uint32_t                            PROTOCOL_ID;
+    static const    unsigned int                        PREVIOUS_ACK_COUNT              = 32;
     static const    uint32_t                            MINIMUM_HEADER_SIZE             = sizeof(PROTOCOL_ID) + sizeof(uint8_t); // ProtocolID + PacketType
+    static const    uint32_t                            SEQUENCE_HEADER_SIZE            = 2 * sizeof(uint16_t) + PREVIOUS_ACK_COUNT / 8; // Sequence + Ack + AckBits
+    static const    uint32_t                            MESSAGE_HEADER_SIZE             = sizeof(uint8_t) + 2 * sizeof(uint16_t); // Channel + MessageID + Size
+    static const    uint32_t                            EXTENDED_MESSAGE_SIZE           = 0xFFFF; // Size field value announcing a 32 bits size
     static const    uint32_t                            ROUNDED_PUBLIC_KEY_SIZE         = (PUBLIC_KEY_SIZE + 7) / 8;
     static const    unsigned int                        CONNECTION_REQUEST_PACKET_SIZE  = MINIMUM_HEADER_SIZE + ROUNDED_PUBLIC_KEY_SIZE;
     static const    unsigned int                        CHALLENGE_PACKET_SIZE           = MINIMUM_HEADER_SIZE + ROUNDED_PUBLIC_KEY_SIZE;
     static const    unsigned int                        CHALLENGE_RESPONSE_PACKET_SIZE  = MINIMUM_HEADER_SIZE;
     static const    unsigned int                        CONNECTION_ACCEPTED_PACKET_SIZE = MINIMUM_HEADER_SIZE + 4;
-    static const    unsigned int                        CONNECTION_DATA_PACKET_SIZE     = MINIMUM_HEADER_SIZE + 2 + 4;
+    static const    unsigned int                        CONNECTION_DATA_PACKET_SIZE     = MINIMUM_HEADER_SIZE + SEQUENCE_HEADER_SIZE + 4;
     static const    unsigned int                        DISCONNECT_PACKET_SIZE          = MINIMUM_HEADER_SIZE;
+
+    static const    unsigned int                        MTU_PROBE_PACKET_SIZE           = MINIMUM_HEADER_SIZE + sizeof(uint16_t); // + ProbeID, padded to the probed size
+    static const    unsigned int                        MTU_PROBE_ACK_PACKET_SIZE       = MINIMUM_HEADER_SIZE + 2 * sizeof(uint16_t); // + ProbeID + ProbedSize
+
+    static const    unsigned int                        MIN_PACKET_SIZE                 = 508; // Minimum IPv4 reassembly size minus IP options and UDP header, every path carries it
+    static const    unsigned int                        DEFAULT_PACKET_SIZE             = 1200; // Stays below common path MTU until path MTU discovery completes
+    static const    unsigned int                        MAX_PACKET_SIZE                 = 1472; // Ethernet MTU minus IPv4 and UDP headers, receive buffers hold any datagram
+    static const    unsigned int                        MAX_FRAGMENT_COUNT              = 255;
+    static const    unsigned int                        FRAGMENT_HEADER_SIZE            = MINIMUM_HEADER_SIZE + SEQUENCE_HEADER_SIZE + 5; // + Channel + MessageID + FragmentIndex + FragmentCount
+    static const    unsigned int                        MIN_FRAGMENT_SIZE               = MIN_PACKET_SIZE - FRAGMENT_HEADER_SIZE - Hash::HMAC::SIZE;
+    static const    unsigned int                        MAX_FRAGMENT_SIZE               = MAX_PACKET_SIZE - FRAGMENT_HEADER_SIZE - Hash::HMAC::SIZE;
+    static const    uint32_t                            COMPRESSED_FLAG                 = 0x80000000; // Set in the game data size of compressed game data
+    static const    uint8_t                             PARITY_CHANNEL_FLAG             = 0x80; // Set in the channel of parity messages
+    static const    uint8_t                             TIME_SYNC_CHANNEL               = 0x7F; // Channel of the timestamps piggybacked on data packets
+    static const    unsigned int                        MAX_MESSAGE_SIZE                = MIN_FRAGMENT_SIZE * MAX_FRAGMENT_COUNT - sizeof(uint32_t) - MESSAGE_HEADER_SIZE - sizeof(uint32_t); // Fits the fragments of the smallest path MTU
 protected:
 
-    static const    unsigned int                        PREVIOUS_ACK_COUNT              = 32;
     static const    unsigned int                        DATA_PROTOCOL_SIZE              = sizeof(unsigned int);
     static const    unsigned int                        SEQUENCE_SIZE                   = sizeof(int);
     static const    unsigned int                        HEADER_SIZE                     = 2 * DATA_PROTOCOL_SIZE + 2 * SEQUENCE_SIZE;
 
 
-
-    static          int                                 sequence;
-    static          int                                 ack;
-    static          std::bitset<PREVIOUS_ACK_COUNT>     previousAck;
-
-
     /**
      * Compare sequence ID handling wrap around
      */
@@ -62,6 +79,19 @@ public:
 
 };
 
+/**
+ * Sequence of the packet and acknowledgement of the last PREVIOUS_ACK_COUNT + 1 packets received from the remote
+ */
+struct SequenceHeader
+{
+    uint16_t    sequence    = 0;
+    uint16_t    ack         = 0;
+    uint32_t    ackBits     = 0;
+
+    void Write(Buffer& p_buffer) const;
+    void Read(Buffer& p_buffer);
+};
+
 
 struct ConnectionRequestPacket
 {
@@ -95,15 +125,93 @@ struct ConnectionAcceptedPacket
 
 struct ConnectionDataPacket
 {
-    uint16_t        sequence        = 0;
+    static const    unsigned int    SEQUENCE_OFFSET = Packet::MINIMUM_HEADER_SIZE;
+
+    SequenceHeader  header          {};
     uint32_t        gameDataSize    = 0;
     unsigned char*  gameData        = nullptr;
 
     void Write(Buffer& p_buffer, const ShortSharedKey& sharedKey);
     void Read(Buffer& p_buffer);
 
+    /**
+     * Write protocol, type, sequence header and game data size, the game data is written by the caller
+     */
+    static void WriteHeader(Buffer& p_buffer, const SequenceHeader& p_header, uint32_t p_gameDataSize);
+    static void WriteMessageHeader(Buffer& p_buffer, uint8_t p_channel, uint16_t p_id, uint32_t p_size);
+    static void ReadMessageHeader(Buffer& p_buffer, uint8_t& o_channel, uint16_t& o_id, uint32_t& o_size);
+    static unsigned int GetMessageHeaderSize(uint32_t p_size);
+    /**
+     * Compress game data in place as DecompressedSize + LZ stream.
+     * Returns the game data size to write, flagged with COMPRESSED_FLAG, or p_size when compression doesn't pay off
+     */
+    static uint32_t CompressGameData(const LZCompressor& p_compressor, uint8_t* p_gameData, uint32_t p_size);
+    /**
+     * Append the HMAC of everything written so far
+     */
+    static void WriteHMAC(Buffer& p_buffer, const ShortSharedKey& p_sharedKey);
+
+    /**
+     * Serialize header and a single message once without HMAC, so the same buffer can be sent to several connections
+     */
+    static void WriteShared(Buffer& p_buffer, uint8_t p_channel, uint16_t p_id, const unsigned char* p_data, uint16_t p_size, const LZCompressor* p_compressor = nullptr);
+    /**
+     * Overwrite the sequence header of a packet serialized with WriteShared
+     */
+    static void WriteSequenceHeader(Buffer& p_buffer, const SequenceHeader& p_header);
+    /**
+     * Overwrite the message id of an uncompressed packet serialized with WriteShared
+     */
+    static void WriteMessageId(Buffer& p_buffer, uint16_t p_id);
+
     ~ConnectionDataPacket();
 };
+/**
+ * Part of a data packet too large for the path MTU.
+ * All fragments of a packet have the same size except the last one.
+ * Fragments are identified by the message they carry rather than by packet sequence,
+ * so the fragments of a resent reliable message complete the ones received from earlier attempts.
+ * The packet is acked under the sequence of the fragment completing it.
+ */
+struct ConnectionDataFragmentPacket
+{
+    SequenceHeader  header          {};
+    uint8_t         channel         = 0;
+    uint16_t        messageId       = 0;
+    uint8_t         fragmentIndex   = 0;
+    uint8_t         fragmentCount   = 0;
+
+    void Write(Buffer& p_buffer, const ShortSharedKey& sharedKey, const unsigned char* p_fragmentData, uint16_t p_fragmentSize);
+    /**
+     * Read the fragment header, leaving the buffer on the fragment data
+     */
+    void Read(Buffer& p_buffer);
+};
+
+/**
+ * Padded to the probed size, the remote answers with an MtuProbeAckPacket when the whole datagram got through
+ */
+struct MtuProbePacket
+{
+    uint16_t    id          = 0;
+    uint16_t    size        = 0;
+
+    void Write(Buffer& p_buffer, const ShortSharedKey& sharedKey);
+    /**
+     * Read the probe id, the size is the size of the received datagram
+     */
+    void Read(Buffer& p_buffer);
+};
+
+struct MtuProbeAckPacket
+{
+    uint16_t    id          = 0;
+    uint16_t    size        = 0;
+
+    void Write(Buffer& p_buffer, const ShortSharedKey& sharedKey);
+    void Read(Buffer& p_buffer);
+};
+
 struct DisconnectPacket
 {
     void Write(Buffer& p_buffer, const ShortSharedKey& sharedKey);
@@ -0,0 +1,60 @@
+#pragma once
+#include "stdafx.h"
+
+/**
+ * AIMD send rate of a connection, spent through a token bucket.
+ * Until the first congestion event the rate doubles every RTT (slow start), then it grows linearly while the connection
+ * uses its whole budget. It is cut on packet loss or when the RTT rises well above the minimum RTT,
+ * which means queues are building up along the path.
+ * Decreases happen at most once per RTT, the losses of a single congestion event count once.
+ */
+class CongestionController
+{
+public:
+    using clock = std::chrono::high_resolution_clock;
+
+    static constexpr float                      INITIAL_RATE            {64.0f * 1024.0f}; // Bytes per second
+    static constexpr float                      MIN_RATE                {8.0f * 1024.0f};
+    static constexpr float                      MAX_RATE                {4.0f * 1024.0f * 1024.0f};
+    static constexpr float                      ADDITIVE_INCREASE       {32.0f * 1024.0f}; // Rate gained every second of full use without congestion
+    static constexpr float                      MULTIPLICATIVE_DECREASE {0.7f};
+    static constexpr float                      RTT_SMOOTHING           {0.125f};
+    static constexpr std::chrono::milliseconds  MAX_BURST               {50}; // Unused budget accumulates at most for this long
+    static constexpr std::chrono::milliseconds  DELAY_THRESHOLD         {25};
+    static constexpr std::chrono::milliseconds  MIN_DECREASE_INTERVAL   {100};
+    static constexpr std::chrono::seconds       MIN_RTT_WINDOW          {10};
+    static constexpr std::chrono::seconds       LIMITED_WINDOW          {1}; // The rate only grows if the budget ran out this recently
+
+private:
+    float               m_rate          {INITIAL_RATE};
+    float               m_budget        {0.0f};
+    clock::time_point   m_lastUpdate    {};
+    clock::time_point   m_lastLimited   {};
+    clock::time_point   m_lastDecrease  {};
+    clock::duration     m_smoothedRtt   {0};
+    clock::duration     m_minRtt        {0};
+    clock::time_point   m_minRttTime    {};
+    bool                m_hasRtt        {false};
+    bool                m_slowStart     {true};
+
+    void    Refill(clock::time_point p_now);
+    void    Decrease(clock::time_point p_now);
+
+public:
+    void    Reset();
+
+    /**
+     * Whether a packet can be sent now, the last packet may overdraw the budget
+     */
+    bool    HasBudget(clock::time_point p_now);
+    void    OnPacketSent(uint32_t p_size);
+    void    OnPacketAcked(uint32_t p_size, clock::duration p_rtt, clock::time_point p_now);
+    void    OnPacketLost(clock::time_point p_now);
+
+    float           GetSendRate() const;
+    /**
+     * Bytes that can be sent at the last update, negative when the last packet overdrew it
+     */
+    float           GetBudget() const;
+    clock::duration GetSmoothedRtt() const;
+};
@@ -0,0 +1,50 @@
+#pragma once
+#include "stdafx.h"
+#include "Network/Packets/Packet.h"
+
+/**
+ * Path MTU discovery with padded probe packets, sent with the don't fragment bit so oversized ones are dropped on the path.
+ * The largest acked size and the smallest size that failed MAX_ATTEMPTS times bound a binary search,
+ * the default packet size is probed first as most paths carry it.
+ * Once the bounds are closer than SEARCH_RESOLUTION the search stops and restarts upwards after REPROBE_INTERVAL, paths change.
+ */
+class MtuDiscovery
+{
+public:
+    using clock = std::chrono::high_resolution_clock;
+
+    static const unsigned int                   MAX_ATTEMPTS        {3}; // A lost probe alone doesn't prove the size too large
+    static const unsigned int                   SEARCH_RESOLUTION   {16};
+    static constexpr std::chrono::milliseconds  MIN_PROBE_TIMEOUT   {250};
+    static constexpr std::chrono::seconds       REPROBE_INTERVAL    {600};
+
+private:
+    unsigned int        m_low           {Packet::MIN_PACKET_SIZE}; // Largest size known to get through
+    unsigned int        m_high          {Packet::MAX_PACKET_SIZE}; // Largest size not known to fail
+    bool                m_probing       {false};
+    uint16_t            m_probeId       {0};
+    unsigned int        m_probeSize     {0};
+    unsigned int        m_attempts      {0};
+    clock::time_point   m_lastProbe     {};
+    bool                m_complete      {false};
+    clock::time_point   m_completeTime  {};
+
+public:
+    void            Reset();
+
+    /**
+     * Id and size of the probe to send now, if any. Unanswered probes time out after twice p_rtt
+     */
+    bool            GetNextProbe(clock::time_point p_now, clock::duration p_rtt, uint16_t& o_id, uint16_t& o_size);
+    void            OnProbeAcked(uint16_t p_id, uint16_t p_size);
+    /**
+     * Count the current probe size as too large, when the socket refused to send it
+     */
+    void            OnProbeFailed();
+
+    /**
+     * Largest datagram to send on the path, the default size until it is known to fail
+     */
+    unsigned int    GetMaxPacketSize() const;
+    bool            IsComplete() const;
+};
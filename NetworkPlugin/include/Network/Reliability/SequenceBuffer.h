@@ -0,0 +1,87 @@
+#pragma once
+#include <array>
+#include "Network/Packets/Packet.h"
+
+/**
+ * Fixed size ring of entries indexed by a wrapping 16 bits sequence
+ */
+template<typename T, unsigned int N>
+class SequenceBuffer
+{
+    static constexpr uint32_t   EMPTY_ENTRY         = 0xFFFFFFFF;
+
+    uint16_t                    m_sequence          {0};
+    std::array<uint32_t, N>     m_entrySequences    {};
+    std::array<T, N>            m_entries           {};
+
+    void RemoveEntries(uint16_t p_start, uint16_t p_end)
+    {
+        for (uint16_t sequence = p_start; sequence != static_cast<uint16_t>(p_end + 1); ++sequence)
+            m_entrySequences[sequence % N] = EMPTY_ENTRY;
+    }
+
+public:
+    SequenceBuffer()
+    {
+        Reset();
+    }
+
+    void Reset()
+    {
+        m_sequence = 0;
+        m_entrySequences.fill(EMPTY_ENTRY);
+    }
+
+    /**
+     * Sequence following the most recent inserted one
+     */
+    uint16_t GetSequence() const
+    {
+        return m_sequence;
+    }
+
+    bool IsTooOld(const uint16_t p_sequence) const
+    {
+        return Packet::SequenceGreaterThan(static_cast<uint16_t>(m_sequence - N), p_sequence);
+    }
+
+    T* Insert(const uint16_t p_sequence)
+    {
+        if (IsTooOld(p_sequence))
+            return nullptr;
+
+        if (Packet::SequenceGreaterThan(static_cast<uint16_t>(p_sequence + 1), m_sequence))
+        {
+            if (static_cast<uint16_t>(p_sequence - m_sequence) >= N)
+                m_entrySequences.fill(EMPTY_ENTRY);
+            else
+                RemoveEntries(m_sequence, p_sequence);
+            m_sequence = p_sequence + 1;
+        }
+
+        const unsigned int index = p_sequence % N;
+        m_entrySequences[index] = p_sequence;
+        m_entries[index] = T{};
+        return &m_entries[index];
+    }
+
+    void Remove(const uint16_t p_sequence)
+    {
+        m_entrySequences[p_sequence % N] = EMPTY_ENTRY;
+    }
+
+    bool Exists(const uint16_t p_sequence) const
+    {
+        return m_entrySequences[p_sequence % N] == p_sequence;
+    }
+
+    T* Find(const uint16_t p_sequence)
+    {
+        return Exists(p_sequence) ? &m_entries[p_sequence % N] : nullptr;
+    }
+
+    const T* Find(const uint16_t p_sequence) const
+    {
+        return Exists(p_sequence) ? &m_entries[p_sequence % N] : nullptr;
+    }
+};
@@ -0,0 +1,57 @@
+#pragma once
+#include "stdafx.h"
+#include "Network/Packets/Buffer.h"
+
+/**
+ * Round trip time and clock offset estimation from timestamps piggybacked on data packets, NTP style.
+ * Each side sends its local time, echoes the last remote time it received and the local time it received it at.
+ * With t0 the echoed time, t1 its reception and t2 the send time on the remote, and t3 the local reception:
+ * RTT = (t3 - t0) - (t2 - t1) and remote clock - local clock = ((t1 - t0) + (t2 - t3)) / 2.
+ * Times are microseconds since a time origin chosen by each side.
+ */
+class TimeSync
+{
+public:
+    static constexpr std::chrono::milliseconds  SYNC_INTERVAL   {100};
+    static const unsigned int                   MESSAGE_SIZE    {sizeof(uint8_t) + 3 * sizeof(uint64_t)}; // Has echo + send time + echo + echo reception
+    static const unsigned int                   FILTER_SIZE     {8};
+
+private:
+    struct Sample
+    {
+        int64_t     rtt     {0};
+        int64_t     offset  {0};
+    };
+
+    uint64_t                        m_lastSent          {0};
+    bool                            m_hasSent           {false};
+    bool                            m_hasRemoteTime     {false};
+    uint64_t                        m_remoteTime        {0};
+    uint64_t                        m_remoteReceivedAt  {0};
+    uint64_t                        m_lastEcho          {0};
+
+    bool                            m_hasSample         {false};
+    double                          m_smoothedRtt       {0.0};
+    double                          m_rttVariance       {0.0};
+    std::array<Sample, FILTER_SIZE> m_samples           {};
+    unsigned int                    m_sampleCount       {0};
+    int64_t                         m_offset            {0};
+
+public:
+    void        Reset();
+
+    bool        ShouldSend(uint64_t p_localTime) const;
+    void        Write(Buffer& p_buffer, uint64_t p_localTime);
+    void        Read(Buffer& p_buffer, uint64_t p_localTime);
+
+    bool        HasSample() const;
+    /**
+     * Smoothed RTT and mean deviation in microseconds, RFC 6298
+     */
+    double      GetSmoothedRtt() const;
+    double      GetRttVariance() const;
+    /**
+     * Remote clock - local clock in microseconds, taken from the recent sample with the lowest RTT as its error is the smallest
+     */
+    int64_t     GetClockOffset() const;
+};
@@ -0,0 +1,52 @@
+#pragma once
+#include "stdafx.h"
+#include "Network/Packets/Buffer.h"
+
+enum class FieldType : uint8_t
+{
+    INT8,
+    INT16,
+    INT32,
+    INT64,
+    FLOAT32,
+    FLOAT64
+};
+
+enum class ReplicationCommand : uint8_t
+{
+    CREATE,     // EntityID + TypeID + FieldCount + FieldTypes + every field
+    DESTROY,    // EntityID
+    UPDATE      // EntityID + UpdateSequence + FieldMask + FieldsSize + dirty fields
+};
+
+/**
+ * Typed fields of a replicated entity, values are stored packed in field order in host byte order
+ */
+struct EntityLayout
+{
+    static const unsigned int   MAX_FIELDS          = 32; // Dirty fields are tracked in a 32 bits mask
+    static const unsigned int   ENTITY_HEADER_SIZE  = sizeof(uint8_t) + sizeof(uint32_t); // Command + EntityID
+    static const unsigned int   UPDATE_HEADER_SIZE  = ENTITY_HEADER_SIZE + sizeof(uint16_t) + sizeof(uint32_t) + sizeof(uint16_t); // + UpdateSequence + FieldMask + FieldsSize
+
+    std::vector<FieldType>  fields      {};
+    std::vector<uint16_t>   offsets     {};
+    uint32_t                size        = 0;
+
+    static unsigned int GetFieldSize(FieldType p_type);
+
+    /**
+     * Build a layout from its field types, returns false when a type is unknown or there are too many fields
+     */
+    bool        Init(const FieldType* p_fields, unsigned int p_fieldCount);
+    /**
+     * Serialized size of the fields in p_mask
+     */
+    uint32_t    GetSize(uint32_t p_mask) const;
+    uint32_t    GetFullMask() const;
+
+    void        WriteFields(Buffer& p_buffer, const uint8_t* p_values, uint32_t p_mask) const;
+    /**
+     * Fields of p_mask outside p_keepMask are read but not stored
+     */
+    void        ReadFields(Buffer& p_buffer, uint8_t* o_values, uint32_t p_mask, uint32_t p_keepMask = 0xFFFFFFFF) const;
+};
@@ -0,0 +1,58 @@
+#pragma once
+#include "stdafx.h"
+#include <deque>
+#include <unordered_map>
+#include "Network/Channels/Channel.h"
+#include "Network/Replication/EntityLayout.h"
+
+enum class EntityEvent : uint8_t
+{
+    CREATED,
+    UPDATED,
+    DESTROYED
+};
+
+/**
+ * Client side copy of the replicated entities, the game polls events and reads fields.
+ * Updates may arrive late or out of order, each field keeps the sequence of the update that last wrote it and ignores older ones
+ */
+class ReplicationClient
+{
+public:
+    static const unsigned int   MAX_EVENTS  {4096}; // Oldest events are dropped when the game doesn't poll them
+
+    struct Event
+    {
+        EntityEvent     type        {EntityEvent::CREATED};
+        uint32_t        entityId    {0};
+        uint16_t        entityType  {0};
+        uint32_t        fieldMask   {0};
+    };
+
+private:
+    struct Entity
+    {
+        uint16_t                type        {0};
+        EntityLayout            layout      {};
+        std::vector<uint8_t>    values      {};
+        uint32_t                sequence    {0}; // Most recent update sequence received, extended past the 16 bits of the wire
+        std::vector<uint32_t>   fieldSequences {};
+    };
+
+    std::unordered_map<uint32_t, Entity>    m_entities  {};
+    std::deque<Event>                       m_events    {};
+
+    void    PushEvent(const Event& p_event);
+    bool    ReadCreate(Buffer& p_buffer);
+    bool    ReadUpdate(Buffer& p_buffer);
+
+public:
+    void    Reset();
+
+    /**
+     * Apply a replication message, returns false when it is malformed
+     */
+    bool    ProcessMessage(const MessageData& p_message);
+    bool    PollEvent(Event& o_event);
+    bool    GetField(uint32_t p_entityId, uint8_t p_field, void* o_value) const;
+};
@@ -0,0 +1,109 @@
+#pragma once
+#include "stdafx.h"
+#include <unordered_map>
+#include "Network/Connection.h"
+#include "Network/Replication/EntityLayout.h"
+
+/**
+ * Server side entity replication.
+ * Creation and destruction go through a reliable channel. Updates only carry the fields changed since the last send
+ * and go through an unreliable channel once the client acked the creation, fields of updates not delivered in time are marked dirty again.
+ * Updates are numbered per entity so the client never lets a late update overwrite the fields of a newer one.
+ */
+class ReplicationServer
+{
+public:
+    using clock = std::chrono::high_resolution_clock;
+
+    static constexpr std::chrono::milliseconds  UPDATE_TIMEOUT      {250};
+    static const unsigned int                   MAX_MESSAGE_SIZE    {1000}; // Commands are split so messages share datagrams instead of being fragmented
+
+private:
+    enum class EntityState : uint8_t
+    {
+        PENDING_CREATE,
+        CREATING,
+        CREATED
+    };
+
+    struct Entity
+    {
+        uint16_t                type        {0};
+        std::vector<uint8_t>    values      {};
+    };
+
+    struct ClientEntity
+    {
+        EntityState     state               {EntityState::PENDING_CREATE};
+        uint16_t        creationMessage     {0};
+        uint32_t        dirtyMask           {0};
+        uint16_t        updateSequence      {0}; // Of the last update sent, the creation is 0
+        bool            listedDirty         {false};
+    };
+
+    struct PendingCreation
+    {
+        uint16_t                messageId   {0};
+        std::vector<uint32_t>   entities    {};
+    };
+
+    struct PendingUpdate
+    {
+        uint16_t                                    messageId   {0};
+        clock::time_point                           sent        {};
+        std::vector<std::pair<uint32_t, uint32_t>>  fields      {}; // EntityID + FieldMask
+    };
+
+    /**
+     * Each list only holds the entities with work to do, ids of entities destroyed since are skipped
+     */
+    struct ClientView
+    {
+        bool                                        active      {false};
+        std::unordered_map<uint32_t, ClientEntity>  entities    {};
+        std::vector<uint32_t>                       destroyed   {};
+        std::vector<uint32_t>                       toCreate    {}; // PENDING_CREATE entities in creation order
+        std::vector<PendingCreation>                creations   {}; // Creation messages not delivered yet, oldest first
+        std::vector<uint32_t>                       dirty       {}; // CREATED entities with dirty fields
+        std::vector<PendingUpdate>                  pending     {};
+    };
+
+    std::unordered_map<uint16_t, EntityLayout>      m_layouts           {};
+    std::unordered_map<uint32_t, Entity>            m_entities          {};
+    std::vector<ClientView>                         m_clients           {};
+    uint32_t                                        m_nextEntityId      {0};
+    uint8_t                                         m_reliableChannel   {Connection::MAX_CHANNELS};
+    uint8_t                                         m_unreliableChannel {Connection::MAX_CHANNELS};
+
+    static void MarkDirty(ClientView& p_client, uint32_t p_entityId, ClientEntity& p_entity, uint32_t p_mask);
+    void    WriteCreations(ClientView& p_client, Connection& p_connection);
+    void    ProcessAcks(ClientView& p_client, const Connection& p_connection, clock::time_point p_now);
+    void    WriteUpdates(ClientView& p_client, Connection& p_connection, clock::time_point p_now);
+
+public:
+    explicit ReplicationServer(unsigned int p_maxClients);
+
+    bool    IsEnabled() const;
+    /**
+     * Channels used for replication, the reliable one must be RELIABLE_ORDERED on both sides
+     */
+    void    SetChannels(uint8_t p_reliableChannel, uint8_t p_unreliableChannel);
+
+    bool    RegisterType(uint16_t p_type, const FieldType* p_fields, unsigned int p_fieldCount);
+    /**
+     * Create an entity with zeroed fields, returns its id or -1 when the type is unknown
+     */
+    int64_t CreateEntity(uint16_t p_type);
+    void    DestroyEntity(uint32_t p_entityId);
+    /**
+     * Copy a field value, the field is only marked dirty when its value changed
+     */
+    bool    SetField(uint32_t p_entityId, uint8_t p_field, const void* p_value);
+
+    void    AddClient(unsigned int p_clientIndex);
+    void    RemoveClient(unsigned int p_clientIndex);
+    /**
+     * Queue the creations, destructions and dirty fields of one client on its connection
+     */
+    void    Update(unsigned int p_clientIndex, Connection& p_connection);
+};
@@ -3,6 +3,11 @@
 #include "Address.h"
 #include "Socket.h"
 #include "Network/NetworkPlugin.h"
+#include "Network/Connection.h"
+#include "Network/Snapshots/SnapshotHistory.h"
+#include "Network/Input/InputHistory.h"
+#include "Network/Replication/ReplicationServer.h"
+#include "Network/Statistics/LatencyHistogram.h"
 
 struct ChallengeResponsePacket;
 struct ConnectionRequestPacket;
@@ -10,6 +15,11 @@ struct ConnectionDataPacket;
 struct DisconnectPacket;
 typedef void(__stdcall * ClientConnectCallback) (int id);
 
+// Slot 0 is the local client, tools hosting many clients raise it at build time
+#ifndef NETWORK_MAX_CLIENTS
+#define NETWORK_MAX_CLIENTS 4
+#endif
+
 enum class ServerState : uint8_t
 {
     LOBBY,
@@ -30,6 +40,7 @@ private:
         std::future<ShortSharedKey> sharedKeyFuture     {};
         ShortSharedKey              sharedKey           {};
         clock::time_point           lastReceivedPacket  {clock::now()};
+        clock::time_point           requestTime         {clock::now()}; // First connection request, for the handshake duration
     };
 
     struct ConnectionInfo
@@ -37,13 +48,15 @@ private:
         Address             clientAddress;
         ShortSharedKey      sharedKey           {};
         clock::time_point   lastReceivedPacket  {clock::now()};
-        uint16_t            sequence            {0};
-        uint16_t            ack                 {0};
+        Connection          connection          {};
+        SnapshotSender      snapshots           {};
+        InputReceiver       inputs              {};
     };
 
-    static const int                            MAX_CLIENTS                     {4};
+    static const int                            MAX_CLIENTS                     {NETWORK_MAX_CLIENTS};
     static const int                            TIMEOUT_TIME                    {4};
     static const unsigned short                 SERVER_PORT                     {8755};
+    static const unsigned int                   MAX_AGGREGATED_SIZE             {256}; // Larger unreliable payloads are sent right away
 
     std::random_device                          m_random                        {};
     std::uniform_int_distribution<uint64_t>     m_saltDistribution              {};
@@ -54,9 +67,23 @@ private:
     bool                                        m_connected[MAX_CLIENTS]        {false};
     bool                                        m_challenged[MAX_CLIENTS]       {false};
 
+    std::array<ChannelMode, Connection::MAX_CHANNELS> m_channelModes            {Connection::DEFAULT_CHANNEL_MODES};
+    std::array<uint8_t, Connection::MAX_CHANNELS> m_parityGroupSizes          {};
+    int                                         m_nextReceiveIndex              {0};
+    uint8_t                                     m_snapshotChannel               {Connection::MAX_CHANNELS};
+    uint16_t                                    m_snapshotSequence              {0};
+    uint8_t                                     m_inputChannel                  {Connection::MAX_CHANNELS};
+    ReplicationServer                           m_replication                   {MAX_CLIENTS};
+    std::shared_ptr<const LZCompressor>         m_compressor                    {};
+    clock::time_point                           m_startTime                     {clock::now()}; // Origin of the server time sent to clients
+
     ClientConnectCallback                       m_clientConnectCallback         {nullptr};
+    PacketAckedCallback                         m_packetAckedCallback           {nullptr};
     Socket                                      m_socket                        {};
     int                                         m_numConnections                {0};
+    ConnectionStats                             m_departedStats                 {}; // Counters of the clients that left
+    std::array<LatencyHistogram, static_cast<size_t>(LatencyMetric::COUNT)> m_latencies {};
+    uint64_t                                    m_checksumFailures              {0}; // Datagrams from senders without a connection
     std::atomic<ServerState>                    m_state                         {ServerState::LOBBY};
 
 
@@ -65,6 +92,10 @@ private:
     int                     FindExistingConnectionIndex(const ConnectionInfo& p_connectionInfo) const;
     int                     FindExistingConnectionIndex(const Address& p_address) const;
     int                     FindExistingChallengeIndex(const Address& p_address) const;
+    /**
+     * Wait for the key computed for a challenge if it is still pending
+     */
+    void                    ResolveSharedKey(ChallengeInfo& p_challenge);
 
     bool                    IsClientConnected(unsigned int p_clientIndex) const;
     const ConnectionInfo&   GetClientConnectionInfo(unsigned int p_clientIndex) const;
@@ -72,6 +103,11 @@ private:
     void                    HandlePacket(const ConnectionRequestPacket& p_packet,  const Address& p_sender);
     void                    HandlePacket(const ChallengeResponsePacket& p_packet,  const Address& p_sender);
 
+    void                    ReceivePacket();
+    void                    SendPendingPackets();
+    void                    SendPendingPackets(ConnectionInfo& p_connectionInfo);
+    int                     ReceiveMessage(unsigned char* o_gameData, unsigned int p_size, uint8_t* o_channel);
+
     void                    CheckForTimeouts();
     void                    KickClient(const Address& p_address);
     void                    RemoveClient(const Address& p_address);
@@ -80,12 +116,83 @@ public:
     Server();
     ~Server();
 
-    int  Listen(unsigned char* o_gameData, unsigned int p_size);
+    int  Listen(unsigned char* o_gameData, unsigned int p_size, uint8_t* o_channel = nullptr);
     int  GetConnectedClientCount() const;
     void SwitchToLobby();
     void SwitchToGame();
     void RegisterDebugCallback(ClientConnectCallback p_callback);
-    void PropagateGameData(unsigned char* p_buffer, unsigned int p_size);
+    void RegisterPacketAckedCallback(PacketAckedCallback p_callback);
+    uint16_t GetLastSentSequence(unsigned int p_clientIndex) const;
+    /**
+     * Seconds since the server started, the clock clients synchronize to
+     */
+    double   GetTime() const;
+    /**
+     * Smoothed RTT to a client in milliseconds, -1 when unknown
+     */
+    double   GetClientRoundTripTime(unsigned int p_clientIndex) const;
+    bool     GetConnectionStats(unsigned int p_clientIndex, ConnectionStats& o_stats) const;
+    void     GetStats(ServerStats& o_stats) const;
+    /**
+     * Latency distribution of a metric in microseconds since the server started or the last reset
+     */
+    bool     GetLatencySummary(LatencyMetric p_metric, LatencySummary& o_summary) const;
+    double   GetLatencyPercentile(LatencyMetric p_metric, double p_percentile) const;
+    void     ResetLatencies();
+    /**
+     * Record every datagram the server sends and receives to a file, see PacketCapture
+     */
+    bool     StartCapture(const char* p_path);
+    void     StopCapture();
+    /**
+     * Feed the datagrams a capture received to Listen instead of the socket's, nothing is sent while replaying
+     */
+    bool     StartReplay(const char* p_path, bool p_realTime);
+    void     StopReplay();
+    bool     IsReplayFinished() const;
+    /**
+     * Delay, drop, duplicate and reorder the datagrams of this server to test it on a bad network, default conditions turn it off
+     */
+    void     SetNetworkConditions(const NetworkConditions& p_conditions);
+    void ConfigureChannel(uint8_t p_channel, ChannelMode p_mode);
+    /**
+     * Send a parity message every p_groupSize messages of a channel so clients rebuild a lost packet, 0 disables it.
+     * The clients must enable it on the same channel
+     */
+    void SetChannelParity(uint8_t p_channel, uint8_t p_groupSize);
+    /**
+     * Compress game data with an optional dictionary trained offline, the clients must use the same one
+     */
+    void SetCompression(bool p_enabled, const uint8_t* p_dictionary = nullptr, unsigned int p_dictionarySize = 0);
+    /**
+     * Queue game data for every client, small and reliable messages are sent on the next Listen or Flush
+     */
+    void PropagateGameData(unsigned char* p_buffer, unsigned int p_size, uint8_t p_channel = 0);
+    void Flush();
+
+    /**
+     * Dedicate a channel to snapshots, the clients must use the same one
+     */
+    void SetSnapshotChannel(uint8_t p_channel);
+    /**
+     * Queue the game state for every client, delta encoded against the last snapshot each client acked
+     */
+    void PropagateSnapshot(const unsigned char* p_buffer, unsigned int p_size);
+
+    /**
+     * Dedicate a channel to client inputs, the clients must use the same one.
+     * Listen returns each input once, in tick order, as client index + tick + input
+     */
+    void SetInputChannel(uint8_t p_channel);
+
+    /**
+     * Channels used by entity replication, the clients must use the same ones
+     */
+    void    SetReplicationChannels(uint8_t p_reliableChannel, uint8_t p_unreliableChannel);
+    bool    RegisterEntityType(uint16_t p_type, const FieldType* p_fields, unsigned int p_fieldCount);
+    int64_t CreateEntity(uint16_t p_type);
+    void    DestroyEntity(uint32_t p_entityId);
+    bool    SetEntityField(uint32_t p_entityId, uint8_t p_field, const void* p_value);
 };
 
 #pragma region CExport
@@ -94,12 +201,41 @@ extern "C"
     NETWORK_PLUGIN_API Server*  Internal_ServerCreate();
     NETWORK_PLUGIN_API void     Internal_ServerDestroy(Server* p_obj);
     NETWORK_PLUGIN_API int      Internal_ServerListen(Server* p_obj, unsigned char* o_gameData, unsigned int p_size);
+    NETWORK_PLUGIN_API int      Internal_ServerListenWithChannel(Server* p_obj, unsigned char* o_gameData, unsigned int p_size, unsigned char* o_channel);
 
     NETWORK_PLUGIN_API int      Internal_ServerGetConnectedClientCount(Server* p_obj);
     NETWORK_PLUGIN_API void     Internal_ServerSwitchToLobby(Server* p_obj);
     NETWORK_PLUGIN_API void     Internal_ServerSwitchToGame(Server* p_obj);
 
     NETWORK_PLUGIN_API void     Internal_ServerRegisterClientConnectCallback(Server* p_obj, ClientConnectCallback p_callback);
+    NETWORK_PLUGIN_API void     Internal_ServerRegisterPacketAckedCallback(Server* p_obj, PacketAckedCallback p_callback);
+    NETWORK_PLUGIN_API int      Internal_ServerGetLastSentSequence(Server* p_obj, unsigned int p_clientIndex);
+    NETWORK_PLUGIN_API double   Internal_ServerGetTime(Server* p_obj);
+    NETWORK_PLUGIN_API double   Internal_ServerGetClientRoundTripTime(Server* p_obj, unsigned int p_clientIndex);
+    NETWORK_PLUGIN_API bool     Internal_ServerGetConnectionStats(Server* p_obj, unsigned int p_clientIndex, ConnectionStats* o_stats);
+    NETWORK_PLUGIN_API void     Internal_ServerGetStats(Server* p_obj, ServerStats* o_stats);
+    NETWORK_PLUGIN_API bool     Internal_ServerGetLatencySummary(Server* p_obj, unsigned char p_metric, LatencySummary* o_summary);
+    NETWORK_PLUGIN_API double   Internal_ServerGetLatencyPercentile(Server* p_obj, unsigned char p_metric, double p_percentile);
+    NETWORK_PLUGIN_API void     Internal_ServerResetLatencies(Server* p_obj);
+    NETWORK_PLUGIN_API bool     Internal_ServerStartCapture(Server* p_obj, const char* p_path);
+    NETWORK_PLUGIN_API void     Internal_ServerStopCapture(Server* p_obj);
+    NETWORK_PLUGIN_API bool     Internal_ServerStartReplay(Server* p_obj, const char* p_path, bool p_realTime);
+    NETWORK_PLUGIN_API void     Internal_ServerStopReplay(Server* p_obj);
+    NETWORK_PLUGIN_API bool     Internal_ServerIsReplayFinished(Server* p_obj);
+    NETWORK_PLUGIN_API void     Internal_ServerSetNetworkConditions(Server* p_obj, const NetworkConditions* p_conditions);
     NETWORK_PLUGIN_API void     Internal_ServerPropagateGameData(Server* p_obj, unsigned char* p_buffer, unsigned int p_size);
+    NETWORK_PLUGIN_API void     Internal_ServerPropagateGameDataOnChannel(Server* p_obj, unsigned char* p_buffer, unsigned int p_size, unsigned char p_channel);
+    NETWORK_PLUGIN_API void     Internal_ServerFlush(Server* p_obj);
+    NETWORK_PLUGIN_API void     Internal_ServerSetSnapshotChannel(Server* p_obj, unsigned char p_channel);
+    NETWORK_PLUGIN_API void     Internal_ServerPropagateSnapshot(Server* p_obj, const unsigned char* p_buffer, unsigned int p_size);
+    NETWORK_PLUGIN_API void     Internal_ServerSetInputChannel(Server* p_obj, unsigned char p_channel);
+    NETWORK_PLUGIN_API void     Internal_ServerSetReplicationChannels(Server* p_obj, unsigned char p_reliableChannel, unsigned char p_unreliableChannel);
+    NETWORK_PLUGIN_API bool     Internal_ServerRegisterEntityType(Server* p_obj, unsigned short p_type, const unsigned char* p_fields, unsigned int p_fieldCount);
+    NETWORK_PLUGIN_API long long Internal_ServerCreateEntity(Server* p_obj, unsigned short p_type);
+    NETWORK_PLUGIN_API void     Internal_ServerDestroyEntity(Server* p_obj, unsigned int p_entityId);
+    NETWORK_PLUGIN_API bool     Internal_ServerSetEntityField(Server* p_obj, unsigned int p_entityId, unsigned char p_field, const void* p_value);
+    NETWORK_PLUGIN_API void     Internal_ServerSetCompression(Server* p_obj, bool p_enabled, const unsigned char* p_dictionary, unsigned int p_dictionarySize);
+    NETWORK_PLUGIN_API void     Internal_ServerConfigureChannel(Server* p_obj, unsigned char p_channel, unsigned char p_mode);
+    NETWORK_PLUGIN_API void     Internal_ServerSetChannelParity(Server* p_obj, unsigned char p_channel, unsigned char p_groupSize);
 }
 #pragma endregion 
\ No newline at end of file
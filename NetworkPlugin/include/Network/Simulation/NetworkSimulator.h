@@ -0,0 +1,84 @@
+#pragma once
+#include "stdafx.h"
+#include "Network/Address.h"
+#include "Network/Threading/TripleBuffer.h"
+
+/**
+ * Conditions applied to each direction of a link, all zero is a perfect link and disables the simulator
+ */
+struct NetworkConditions
+{
+    float       latency         {0.0f}; // One way delay in milliseconds
+    float       jitter          {0.0f}; // Random delay added on top of the latency, in milliseconds
+    float       lossRate        {0.0f}; // Chance for each datagram to be lost
+    float       burstEnterRate  {0.0f}; // Chance for each datagram to start a burst during which everything is lost
+    float       burstLeaveRate  {1.0f}; // Chance for each datagram to end the burst
+    float       duplicateRate   {0.0f};
+    float       reorderRate     {0.0f}; // Chance for a datagram to be held back behind the ones sent after it
+    float       reorderDelay    {0.0f}; // How long a reordered datagram is held back, in milliseconds
+    uint32_t    bandwidth       {0};    // Bytes per second, 0 is unlimited
+};
+
+/**
+ * Sits between a socket and the wire and delays, drops, duplicates and reorders datagrams in both directions.
+ * Datagrams wait in a timer queue ordered by the time they are due, the socket hands out and sends the due ones whenever it
+ * is used, so nothing sleeps. Conditions may be set from one other thread, everything else runs on the socket's thread.
+ */
+class NetworkSimulator
+{
+public:
+    using clock = std::chrono::high_resolution_clock;
+
+    static const unsigned int   MAX_QUEUED_DATAGRAMS    {1024}; // Per direction, more are dropped like a full router queue
+
+    struct Datagram
+    {
+        clock::time_point       due         {};
+        uint64_t                order       {0}; // Keeps datagrams due at the same time in submission order
+        Address                 address     {};
+        std::vector<uint8_t>    data        {};
+    };
+
+private:
+    struct Link
+    {
+        std::vector<Datagram>   queue       {}; // Min heap on the due time
+        bool                    inBurst     {false};
+        clock::time_point       lastDue     {}; // Jitter alone never reorders, only reorderRate does
+        clock::time_point       linkFree    {}; // When the bandwidth cap lets the next datagram leave
+    };
+
+    TripleBuffer<NetworkConditions> m_published     {};
+    std::atomic<bool>               m_enabled       {false};
+    NetworkConditions               m_conditions    {};
+    Link                            m_outgoing      {};
+    Link                            m_incoming      {};
+    std::mt19937                    m_random        {std::random_device{}()};
+    uint64_t                        m_order         {0};
+
+    bool    Chance(float p_rate);
+    static clock::duration Milliseconds(float p_milliseconds);
+    /**
+     * Heap order, the earliest datagram ends up on top
+     */
+    static bool IsDueLater(const Datagram& p_left, const Datagram& p_right);
+    void    Submit(Link& p_link, const Address& p_address, const unsigned char* p_data, unsigned int p_size, clock::time_point p_now);
+    void    Push(Link& p_link, Datagram&& p_datagram);
+    bool    Pop(Link& p_link, clock::time_point p_now, Datagram& o_datagram);
+
+public:
+    void    SetConditions(const NetworkConditions& p_conditions);
+    /**
+     * True while conditions are set or datagrams are still queued, the socket bypasses the simulator otherwise
+     */
+    bool    IsActive() const;
+
+    void    QueueOutgoing(const Address& p_destination, const unsigned char* p_data, unsigned int p_size);
+    void    QueueIncoming(const Address& p_sender, const unsigned char* p_data, unsigned int p_size);
+    bool    PopOutgoing(clock::time_point p_now, Datagram& o_datagram);
+    bool    PopIncoming(clock::time_point p_now, Datagram& o_datagram);
+    /**
+     * Time until the next datagram of either direction is due, p_max when nothing is queued
+     */
+    std::chrono::microseconds GetTimeUntilNextDue(clock::time_point p_now, std::chrono::microseconds p_max) const;
+};
@@ -0,0 +1,69 @@
+#pragma once
+#include "stdafx.h"
+#include <deque>
+#include "Network/Channels/Channel.h"
+
+/**
+ * Snapshots held by server time and played out after an adaptive delay, so network jitter doesn't reach rendering.
+ * The transit time of each snapshot (local arrival - server time, clock offset included) gives a mean and a jitter,
+ * the playout delay targets mean transit + snapshot interval + JITTER_MULTIPLIER * jitter.
+ * The delay grows quickly when the link gets worse and shrinks slowly, so playout speed only changes by a few percent.
+ * Times are in milliseconds.
+ */
+class JitterBuffer
+{
+public:
+    static const unsigned int   MAX_SNAPSHOTS           {32};
+    static constexpr double     JITTER_MULTIPLIER       {3.0};
+    static constexpr double     STATISTICS_GAIN         {1.0 / 16.0}; // RFC 3550 jitter filter
+    static constexpr double     MAX_DELAY_INCREASE      {0.1}; // Milliseconds of delay per millisecond of playout
+    static constexpr double     MAX_DELAY_DECREASE      {0.01};
+
+    /**
+     * Two snapshots around the render time, to is from when playout is outside the buffered snapshots
+     */
+    struct Sample
+    {
+        MessageData     from        {};
+        MessageData     to          {};
+        float           alpha       {0.0f};
+        double          renderTime  {0.0}; // Server time being rendered
+    };
+
+private:
+    struct Entry
+    {
+        int64_t         serverTime  {0};
+        MessageData     data        {};
+    };
+
+    std::deque<Entry>   m_snapshots         {}; // Sorted by server time
+    bool                m_hasStatistics     {false};
+    uint32_t            m_lastServerTime    {0};
+    int64_t             m_unwrappedTime     {0};
+    double              m_lastTransit       {0.0};
+    double              m_meanTransit       {0.0};
+    double              m_jitter            {0.0};
+    double              m_interval          {0.0};
+    double              m_playoutDelay      {0.0};
+    double              m_lastSampleTime    {0.0};
+    bool                m_hasPlayout        {false};
+
+    int64_t     Unwrap(uint32_t p_serverTime);
+
+public:
+    void        Reset();
+
+    void        Add(uint32_t p_serverTime, MessageData p_snapshot, double p_localTime);
+    /**
+     * Snapshots to interpolate at p_localTime, returns false when the buffer is empty.
+     * Snapshots older than the returned from are released
+     */
+    bool        GetSample(double p_localTime, Sample& o_sample);
+
+    /**
+     * Delay added on top of the mean transit time to absorb jitter
+     */
+    double      GetBufferingDelay() const;
+    double      GetJitter() const;
+};
@@ -0,0 +1,22 @@
+#pragma once
+#include "stdafx.h"
+
+/**
+ * Byte level delta between two snapshots.
+ * The delta is a list of runs: unchanged byte count, changed byte count, changed bytes, counts are varints.
+ * Bytes past the end of the baseline are always part of a changed run, unchanged bytes at the end are omitted.
+ */
+class SnapshotDelta
+{
+    static void WriteVarInt(std::vector<uint8_t>& o_data, uint32_t p_value);
+    static bool ReadVarInt(const uint8_t*& p_data, const uint8_t* p_end, uint32_t& o_value);
+
+public:
+    static const unsigned int   MIN_UNCHANGED_RUN   {3}; // Shorter unchanged runs cost more as a new run than as changed bytes
+
+    static void Encode(const std::vector<uint8_t>& p_baseline, const uint8_t* p_snapshot, uint32_t p_size, std::vector<uint8_t>& o_delta);
+    /**
+     * Apply a delta to its baseline, returns false when the delta is malformed
+     */
+    static bool Decode(const std::vector<uint8_t>& p_baseline, const uint8_t* p_delta, uint32_t p_deltaSize, uint32_t p_size, std::vector<uint8_t>& o_snapshot);
+};
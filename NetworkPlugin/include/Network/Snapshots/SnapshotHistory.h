@@ -0,0 +1,72 @@
+#pragma once
+#include "stdafx.h"
+#include "Network/Channels/Channel.h"
+#include "Network/Reliability/SequenceBuffer.h"
+
+enum class SnapshotType : uint8_t
+{
+    FULL,
+    DELTA
+};
+
+/**
+ * Header in front of every snapshot message, the baseline id is only meaningful for deltas
+ */
+struct SnapshotHeader
+{
+    static const unsigned int   SIZE        = sizeof(uint8_t) + 2 * sizeof(uint16_t) + 2 * sizeof(uint32_t); // Type + SnapshotID + BaselineID + ServerTime + Size
+
+    SnapshotType    type        = SnapshotType::FULL;
+    uint16_t        snapshotId  = 0;
+    uint16_t        baselineId  = 0;
+    uint32_t        serverTime  = 0; // Milliseconds since the server started
+    uint32_t        size        = 0;
+
+    void Write(std::vector<uint8_t>& o_data) const;
+    bool Read(const std::vector<uint8_t>& p_data);
+};
+
+/**
+ * Snapshots recently sent to one client.
+ * Each new snapshot is encoded against the most recent one the client acked, or sent in full when there is none.
+ */
+class SnapshotSender
+{
+public:
+    static const unsigned int   SNAPSHOT_BUFFER_SIZE    {32};
+
+private:
+    struct SentSnapshot
+    {
+        MessageData     data        {};
+        uint16_t        messageId   {0};
+    };
+
+    SequenceBuffer<SentSnapshot, SNAPSHOT_BUFFER_SIZE>  m_sentSnapshots {};
+
+public:
+    void        Reset();
+
+    /**
+     * Encode a snapshot, p_ackedMessage is the last acked message of the snapshot channel when p_hasAck is set
+     */
+    MessageData Encode(uint16_t p_snapshotId, uint32_t p_serverTime, const MessageData& p_snapshot, bool p_hasAck, uint16_t p_ackedMessage) const;
+    void        Store(uint16_t p_snapshotId, MessageData p_snapshot, uint16_t p_messageId);
+};
+
+/**
+ * Snapshots recently received from the server, kept as baselines for the next deltas
+ */
+class SnapshotReceiver
+{
+    SequenceBuffer<MessageData, SnapshotSender::SNAPSHOT_BUFFER_SIZE>   m_snapshots {};
+
+public:
+    void        Reset();
+
+    /**
+     * Rebuild a snapshot from its message, returns nullptr when the message is malformed or its baseline is unknown.
+     * o_serverTime receives the time the snapshot was taken at
+     */
+    MessageData Decode(const MessageData& p_message, uint32_t* o_serverTime = nullptr);
+};
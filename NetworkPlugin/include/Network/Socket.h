@@ -1,6 +1,9 @@
 #pragma once
 #include "export.h"
 #include "Address.h"
+#include "Network/Capture/PacketCapture.h"
+#include "Network/Capture/CaptureReplay.h"
+#include "Network/Simulation/NetworkSimulator.h"
 
 class Address;
 
@@ -8,6 +11,29 @@ class Socket
 {
 private:
     SOCKET m_handle{ INVALID_SOCKET };
+    // Totals of the datagrams that went through the socket, sends and receives may happen on different threads
+    mutable std::atomic<uint64_t> m_packetsSent{ 0 };
+    mutable std::atomic<uint64_t> m_bytesSent{ 0 };
+    mutable std::atomic<uint64_t> m_packetsReceived{ 0 };
+    mutable std::atomic<uint64_t> m_bytesReceived{ 0 };
+    mutable PacketCapture m_capture{};
+    // While a replay is open, receives come from the capture and sends are dropped
+    mutable CaptureReplay m_replay{};
+    // Bypassed unless network conditions are set
+    mutable NetworkSimulator m_simulator{};
+
+    void CountSent(int p_size) const;
+    bool SendDatagram(const Address& p_destination, const unsigned char* p_data, int p_size) const;
+    int  ReceiveDatagram(Address& o_sender, unsigned char* o_data, int p_size) const;
+    /**
+     * Count and capture a datagram handed to the caller, simulated datagrams only once they leave the simulated link
+     */
+    void OnDatagramReceived(const Address& p_sender, const unsigned char* p_data, int p_size) const;
+    bool WaitForSocket(std::chrono::microseconds p_timeout) const;
+    /**
+     * Put the simulated datagrams that reached the end of their delay on the wire
+     */
+    void SendDueDatagrams() const;
 
 public:
     Socket();
@@ -19,10 +45,39 @@ public:
     bool IsOpen() const;
 
     bool AllowBroadcast() const;
+    /**
+     * Drop datagrams larger than the path MTU instead of fragmenting them, path MTU discovery relies on it
+     */
+    bool SetDontFragment(bool p_value) const;
 
     bool Send(const Address& p_destination, const unsigned char* p_data, int p_size) const;
     bool Send(const char* p_address, const short p_port, const unsigned char* p_data, int p_size) const;
+    bool Send(const Address& p_destination, const WSABUF* p_buffers, unsigned int p_bufferCount) const;
     int Receive(Address & o_sender, unsigned char* o_data, int p_size) const;
+    /**
+     * Block until a datagram is waiting or p_timeout elapsed, returns true when one is waiting
+     */
+    bool WaitForData(std::chrono::microseconds p_timeout) const;
+
+    uint64_t GetPacketsSent() const;
+    uint64_t GetBytesSent() const;
+    uint64_t GetPacketsReceived() const;
+    uint64_t GetBytesReceived() const;
+
+    bool StartCapture(const char* p_path, uint64_t p_capacity = PacketCapture::DEFAULT_CAPACITY);
+    void StopCapture();
+    bool StartReplay(const char* p_path, bool p_realTime);
+    void StopReplay();
+    bool IsReplaying() const;
+    bool IsReplayFinished() const;
+    /**
+     * Simulate a bad network on both directions of the socket, default conditions turn the simulator off
+     */
+    void SetNetworkConditions(const NetworkConditions& p_conditions);
+    /**
+     * Called when a session key is agreed with p_address, records it while capturing and swaps in the recorded one while replaying
+     */
+    void OnSessionKey(const Address& p_address, ShortSharedKey& o_key) const;
 };
 
 #pragma region CExport
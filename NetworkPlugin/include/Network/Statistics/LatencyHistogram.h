@@ -0,0 +1,44 @@
+#pragma once
+#include "stdafx.h"
+#include "Network/Statistics/NetworkStats.h"
+
+/**
+ * HDR style histogram of durations in microseconds.
+ * Values below SUB_BUCKET_COUNT are counted exactly, above that each power of two is split into SUB_BUCKET_COUNT / 2
+ * linear buckets, so any value is known within 1 / (SUB_BUCKET_COUNT / 2) of itself and the tail keeps its shape.
+ * Counters are relaxed atomics, a thread may record while another one reads percentiles.
+ */
+class LatencyHistogram
+{
+public:
+    using clock = std::chrono::high_resolution_clock;
+
+    static const unsigned int   SUB_BUCKET_BITS     {6};
+    static const unsigned int   SUB_BUCKET_COUNT    {1u << SUB_BUCKET_BITS};
+    static const unsigned int   SUB_BUCKET_HALF     {SUB_BUCKET_COUNT / 2};
+    static const unsigned int   BUCKET_COUNT        {(64 - SUB_BUCKET_BITS + 2) * SUB_BUCKET_HALF};
+
+private:
+    std::array<std::atomic<uint64_t>, BUCKET_COUNT> m_counts    {};
+    std::atomic<uint64_t>                           m_total     {0};
+    std::atomic<uint64_t>                           m_sum       {0};
+    std::atomic<uint64_t>                           m_min       {UINT64_MAX};
+    std::atomic<uint64_t>                           m_max       {0};
+
+    static unsigned int GetBucket(uint64_t p_value);
+    /**
+     * Largest value counted in a bucket, percentiles report it so they never underestimate
+     */
+    static uint64_t     GetBucketMax(unsigned int p_bucket);
+
+public:
+    void    Reset();
+    void    Record(uint64_t p_microseconds);
+    void    Record(clock::duration p_duration);
+
+    /**
+     * Value under which p_percentile percent of the recorded values fall, -1 when nothing was recorded
+     */
+    double  GetPercentile(double p_percentile) const;
+    void    GetSummary(LatencySummary& o_summary) const;
+};
@@ -0,0 +1,74 @@
+#pragma once
+#include "stdafx.h"
+
+/**
+ * Counters of a connection since it was established, read by the engine in one call.
+ * Every field is 8 bytes wide so the layout is the same on the managed side without packing rules
+ */
+struct ConnectionStats
+{
+    uint64_t    packetsSent             {0};
+    uint64_t    packetsReceived         {0}; // Datagrams from the remote address, authenticated or not
+    uint64_t    bytesSent               {0};
+    uint64_t    bytesReceived           {0};
+    uint64_t    authenticationFailures  {0}; // Datagrams failing the HMAC check
+    uint64_t    checksumFailures        {0}; // Datagrams failing the CRC check
+    uint64_t    outOfOrderPackets       {0}; // Arrived after a newer packet, including the ones too old to be tracked
+    uint64_t    duplicatePackets        {0};
+    uint64_t    ackedPackets            {0};
+    uint64_t    lostPackets             {0};
+    uint64_t    maxPacketSize           {0};
+    double      roundTripTime           {-1.0}; // Milliseconds, -1 until the first measure
+    double      roundTripTimeVariance   {-1.0};
+    double      lossRate                {0.0}; // Smoothed fraction of sent packets never acked
+    double      sendRate                {0.0}; // Bytes per second allowed by the congestion controller
+    double      sendBudget              {0.0}; // Bytes that could be sent right now
+};
+
+/**
+ * Totals of a server across all its clients, including the ones that left
+ */
+struct ServerStats
+{
+    uint64_t    connectedClients        {0};
+    uint64_t    packetsSent             {0}; // Every datagram of the socket, handshakes included
+    uint64_t    packetsReceived         {0};
+    uint64_t    bytesSent               {0};
+    uint64_t    bytesReceived           {0};
+    uint64_t    authenticationFailures  {0};
+    uint64_t    checksumFailures        {0}; // Includes datagrams from unknown senders
+    uint64_t    outOfOrderPackets       {0};
+    uint64_t    duplicatePackets        {0};
+    uint64_t    ackedPackets            {0};
+    uint64_t    lostPackets             {0};
+    double      averageRoundTripTime    {-1.0}; // Milliseconds, over the connected clients with a measure
+    double      lossRate                {0.0}; // Mean over the connected clients
+    double      sendRate                {0.0}; // Sum over the connected clients
+};
+
+enum class LatencyMetric : uint8_t
+{
+    DELIVERY,       // Datagram read to message handed to the game
+    HMAC_VERIFY,    // Authentication of a received datagram
+    FAN_OUT,        // Serializing and sending game data to every client, on the server
+    HANDSHAKE,      // First connection request to connection accepted
+    COUNT
+};
+
+/**
+ * Distribution of a latency metric in microseconds, every value is -1 until something was recorded
+ */
+struct LatencySummary
+{
+    uint64_t    count                   {0};
+    double      min                     {-1.0};
+    double      max                     {-1.0};
+    double      mean                    {-1.0};
+    double      p50                     {-1.0};
+    double      p99                     {-1.0};
+    double      p999                    {-1.0};
+};
+
+static_assert(std::is_standard_layout<ConnectionStats>::value && std::is_standard_layout<ServerStats>::value &&
+              std::is_standard_layout<LatencySummary>::value,
+              "Network statistics are copied as is to the engine");
@@ -0,0 +1,59 @@
+#pragma once
+#include <array>
+#include <atomic>
+
+/**
+ * Bounded lock-free queue between exactly one producer thread and one consumer thread.
+ * Each index is only written by one side, the other side reads it with acquire ordering so the slot contents are visible.
+ * Indices live on their own cache line so the two threads don't invalidate each other's line on every operation.
+ */
+template<typename T, unsigned int N>
+class SpscRing
+{
+    static_assert(N > 0 && (N & (N - 1)) == 0, "SpscRing size must be a power of two");
+
+    static constexpr unsigned int   CACHE_LINE_SIZE {64};
+
+    alignas(CACHE_LINE_SIZE) std::atomic<uint32_t>  m_head      {0}; // Next slot to read, written by the consumer
+    alignas(CACHE_LINE_SIZE) std::atomic<uint32_t>  m_tail      {0}; // Next slot to write, written by the producer
+    alignas(CACHE_LINE_SIZE) std::array<T, N>       m_entries   {};
+
+public:
+    /**
+     * Producer side, returns false when the ring is full
+     */
+    bool TryPush(T&& p_value)
+    {
+        const uint32_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head.load(std::memory_order_acquire) == N)
+            return false;
+
+        m_entries[tail % N] = std::move(p_value);
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Consumer side, returns false when the ring is empty
+     */
+    bool TryPop(T& o_value)
+    {
+        const uint32_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire))
+            return false;
+
+        o_value = std::move(m_entries[head % N]);
+        m_entries[head % N] = T{};
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Consumer side, drop everything pushed so far
+     */
+    void Clear()
+    {
+        T value;
+        while (TryPop(value)) {}
+    }
+};
@@ -0,0 +1,40 @@
+#pragma once
+#include <array>
+#include <atomic>
+
+/**
+ * Latest value handed from exactly one writer thread to one reader thread without blocking either.
+ * The writer fills its own slot and swaps it with the shared one, the reader swaps the shared slot with its own when it holds
+ * something new, so each side always owns a slot the other never touches. Values published between two reads are skipped.
+ */
+template<typename T>
+class TripleBuffer
+{
+    static constexpr uint8_t    INDEX_MASK  {0x3};
+    static constexpr uint8_t    NEW_VALUE   {0x4}; // Set in m_shared when the shared slot holds a value the reader hasn't seen
+
+    std::array<T, 3>        m_slots     {};
+    std::atomic<uint8_t>    m_shared    {1};
+    uint8_t                 m_write     {0}; // Owned by the writer
+    uint8_t                 m_read      {2}; // Owned by the reader
+
+public:
+    /**
+     * Writer side
+     */
+    void Publish(const T& p_value)
+    {
+        m_slots[m_write] = p_value;
+        m_write = m_shared.exchange(static_cast<uint8_t>(m_write | NEW_VALUE), std::memory_order_acq_rel) & INDEX_MASK;
+    }
+
+    /**
+     * Reader side, the most recent value published or the previous one read when nothing was published since
+     */
+    const T& Read()
+    {
+        if (m_shared.load(std::memory_order_relaxed) & NEW_VALUE)
+            m_read = m_shared.exchange(m_read, std::memory_order_acq_rel) & INDEX_MASK;
+        return m_slots[m_read];
+    }
+};
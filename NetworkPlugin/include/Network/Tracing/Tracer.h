@@ -0,0 +1,91 @@
+#pragma once
+#include "stdafx.h"
+#include "export.h"
+
+/**
+ * Scoped zones are compiled in when NETWORK_TRACING is defined (Debug configurations) and vanish otherwise.
+ * Each name must be a string literal, events only keep the pointer.
+ */
+#ifdef NETWORK_TRACING
+#define NETWORK_TRACE_CONCAT_INNER(p_a, p_b)    p_a##p_b
+#define NETWORK_TRACE_CONCAT(p_a, p_b)          NETWORK_TRACE_CONCAT_INNER(p_a, p_b)
+#define NETWORK_TRACE_ZONE(p_name)              const TraceZone NETWORK_TRACE_CONCAT(traceZone, __COUNTER__) {p_name}
+#else
+#define NETWORK_TRACE_ZONE(p_name)              ((void)0)
+#endif
+
+/**
+ * Zone events go to a ring owned by the thread that records them, so recording never locks nor contends.
+ * Rings are linked once in a lock-free list and outlive their thread, the last EVENTS_PER_THREAD events of each are dumped.
+ * Event fields are relaxed atomics, a ring lapped during a dump may give a mixed event but never a data race.
+ */
+class Tracer
+{
+public:
+    using clock = std::chrono::high_resolution_clock;
+
+    static const unsigned int   EVENTS_PER_THREAD   {16384};
+
+private:
+    struct Event
+    {
+        std::atomic<const char*>    name        {nullptr};
+        std::atomic<int64_t>        start       {0}; // Nanoseconds since the trace origin
+        std::atomic<int64_t>        duration    {0};
+    };
+
+    struct ThreadBuffer
+    {
+        std::array<Event, EVENTS_PER_THREAD>    events      {};
+        std::atomic<uint64_t>                   head        {0}; // Events recorded so far, written by the owning thread
+        uint32_t                                threadId    {0};
+        ThreadBuffer*                           next        {nullptr};
+    };
+
+    static std::atomic<bool>            s_enabled;
+    static std::atomic<ThreadBuffer*>   s_buffers;
+    static std::atomic<uint32_t>        s_nextThreadId;
+    static const clock::time_point      s_origin;
+
+    static ThreadBuffer&    GetThreadBuffer();
+
+public:
+    static void     SetEnabled(bool p_enabled);
+    static bool     IsEnabled();
+    static int64_t  Now();
+    static void     Record(const char* p_name, int64_t p_start, int64_t p_end);
+    /**
+     * Write the recorded events as a Chrome trace event JSON file, readable by chrome://tracing and Perfetto
+     */
+    static bool     WriteChromeTrace(const char* p_path);
+};
+
+class TraceZone
+{
+    const char* m_name;
+    int64_t     m_start;
+
+public:
+    explicit TraceZone(const char* p_name) :
+        m_name{p_name},
+        m_start{Tracer::IsEnabled() ? Tracer::Now() : -1}
+    {
+    }
+
+    ~TraceZone()
+    {
+        if (m_start >= 0)
+            Tracer::Record(m_name, m_start, Tracer::Now());
+    }
+
+    TraceZone(const TraceZone&) = delete;
+    TraceZone& operator=(const TraceZone&) = delete;
+};
+
+#pragma region CExport
+extern "C"
+{
+    NETWORK_PLUGIN_API void     Internal_TracingSetEnabled(bool p_enabled);
+    NETWORK_PLUGIN_API bool     Internal_TracingWriteChromeTrace(const char* p_path);
+}
+#pragma endregion
@@ -0,0 +1,186 @@
+#include "stdafx.h"
+#include "Network/Capture/CaptureReplay.h"
+#include "Network/Address.h"
+#include "Network/NetworkPlugin.h"
+
+CaptureReplay::~CaptureReplay()
+{
+    Close();
+}
+
+bool CaptureReplay::Open(const char* p_path, const bool p_realTime)
+{
+    Close();
+
+    m_file = CreateFileA(p_path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (m_file == INVALID_HANDLE_VALUE)
+    {
+        g_debugCallback(("Unable to open capture file " + std::string(p_path)).c_str());
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(m_file, &fileSize) || static_cast<uint64_t>(fileSize.QuadPart) < sizeof(CaptureFileHeader))
+    {
+        g_debugCallback("Capture file too small");
+        Close();
+        return false;
+    }
+
+    m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    m_view = m_mapping != nullptr ? static_cast<const unsigned char*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+    if (m_view == nullptr)
+    {
+        g_debugCallback("Unable to map capture file");
+        Close();
+        return false;
+    }
+
+    CaptureFileHeader header;
+    std::memcpy(&header, m_view, sizeof(header));
+    if (header.magic != PacketCapture::MAGIC || header.version != PacketCapture::VERSION || header.recordSize < sizeof(CaptureRecordHeader))
+    {
+        g_debugCallback("Invalid capture file");
+        Close();
+        return false;
+    }
+
+    // A capture that was never stopped has no data size, there is nothing trustworthy to replay
+    m_end = std::min<uint64_t>(sizeof(CaptureFileHeader) + header.dataSize, static_cast<uint64_t>(fileSize.QuadPart));
+    m_offset = sizeof(CaptureFileHeader);
+    m_lastOffset = m_offset;
+    m_recordSize = header.recordSize;
+    m_realTime = p_realTime;
+    m_started = false;
+    m_replayedCount.store(0, std::memory_order_relaxed);
+
+    SkipToReceived();
+    if (!IsFinished())
+        m_firstTimestamp = ReadRecordHeader(m_offset).timestamp;
+    m_active.store(true);
+    return true;
+}
+
+void CaptureReplay::Close()
+{
+    m_active.store(false);
+    if (m_view != nullptr)
+        UnmapViewOfFile(m_view);
+    if (m_mapping != nullptr)
+        CloseHandle(m_mapping);
+    if (m_file != INVALID_HANDLE_VALUE)
+        CloseHandle(m_file);
+
+    m_view = nullptr;
+    m_mapping = nullptr;
+    m_file = INVALID_HANDLE_VALUE;
+    m_offset = 0;
+    m_end = 0;
+}
+
+bool CaptureReplay::IsActive() const
+{
+    return m_active.load(std::memory_order_relaxed);
+}
+
+bool CaptureReplay::IsFinished() const
+{
+    return m_offset >= m_end;
+}
+
+CaptureRecordHeader CaptureReplay::ReadRecordHeader(const uint64_t p_offset) const
+{
+    CaptureRecordHeader record;
+    std::memcpy(&record, m_view + p_offset, sizeof(record));
+    return record;
+}
+
+void CaptureReplay::SkipToReceived()
+{
+    while (m_offset + m_recordSize <= m_end)
+    {
+        const CaptureRecordHeader record = ReadRecordHeader(m_offset);
+        if (m_offset + m_recordSize + record.size > m_end)
+            break;
+        if (record.type == CaptureRecordType::RECEIVED)
+            return;
+        m_offset += m_recordSize + record.size;
+    }
+    // A truncated record ends the capture
+    m_offset = m_end;
+}
+
+bool CaptureReplay::IsDue(const CaptureRecordHeader& p_record)
+{
+    if (!m_realTime)
+        return true;
+
+    const clock::time_point now = clock::now();
+    if (!m_started)
+    {
+        m_started = true;
+        m_startTime = now;
+    }
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now - m_startTime).count()) >= p_record.timestamp - m_firstTimestamp;
+}
+
+int CaptureReplay::Receive(Address& o_sender, unsigned char* o_data, const int p_size)
+{
+    if (IsFinished())
+        return -1;
+
+    const CaptureRecordHeader record = ReadRecordHeader(m_offset);
+    if (!IsDue(record))
+        return -1;
+
+    const int size = std::min<int>(record.size, p_size);
+    std::memcpy(o_data, m_view + m_offset + m_recordSize, size);
+    o_sender = { record.address, record.port };
+
+    m_lastOffset = m_offset;
+    m_offset += m_recordSize + record.size;
+    SkipToReceived();
+    m_replayedCount.fetch_add(1, std::memory_order_relaxed);
+    return size;
+}
+
+bool CaptureReplay::WaitForData(const std::chrono::microseconds p_timeout)
+{
+    if (IsFinished())
+    {
+        std::this_thread::sleep_for(p_timeout);
+        return false;
+    }
+
+    const CaptureRecordHeader record = ReadRecordHeader(m_offset);
+    if (IsDue(record))
+        return true;
+
+    // IsDue started the clock, only real time replays get here
+    const clock::time_point dueTime = m_startTime + std::chrono::nanoseconds{record.timestamp - m_firstTimestamp};
+    std::this_thread::sleep_for(std::min<clock::duration>(dueTime - clock::now(), p_timeout));
+    return IsDue(record);
+}
+
+bool CaptureReplay::FindSessionKey(const Address& p_address, ShortSharedKey& o_key) const
+{
+    for (uint64_t offset = m_lastOffset; offset + m_recordSize <= m_end;)
+    {
+        const CaptureRecordHeader record = ReadRecordHeader(offset);
+        if (offset + m_recordSize + record.size > m_end)
+            break;
+        if (record.type == CaptureRecordType::SESSION_KEY && record.size == o_key.size() &&
+            Address{record.address, record.port} == p_address)
+        {
+            std::memcpy(o_key.data(), m_view + offset + m_recordSize, o_key.size());
+            return true;
+        }
+        offset += m_recordSize + record.size;
+    }
+    return false;
+}
+
+uint64_t CaptureReplay::GetReplayedCount() const
+{
+    return m_replayedCount.load(std::memory_order_relaxed);
+}
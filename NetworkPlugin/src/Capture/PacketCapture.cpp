@@ -0,0 +1,158 @@
+#include "stdafx.h"
+#include "Network/Capture/PacketCapture.h"
+#include "Network/Address.h"
+#include "Network/NetworkPlugin.h"
+
+PacketCapture::~PacketCapture()
+{
+    Stop();
+}
+
+bool PacketCapture::Start(const char* p_path, const uint64_t p_capacity)
+{
+    if (IsRecording())
+        Stop();
+
+    m_capacity = sizeof(CaptureFileHeader) + p_capacity;
+    m_file = CreateFileA(p_path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (m_file == INVALID_HANDLE_VALUE)
+    {
+        g_debugCallback(("Unable to create capture file " + std::string(p_path)).c_str());
+        return false;
+    }
+
+    // Mapping a file larger than itself grows it to the mapping size
+    m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READWRITE, static_cast<DWORD>(m_capacity >> 32), static_cast<DWORD>(m_capacity), nullptr);
+    m_view = m_mapping != nullptr ? static_cast<unsigned char*>(MapViewOfFile(m_mapping, FILE_MAP_WRITE, 0, 0, static_cast<SIZE_T>(m_capacity))) : nullptr;
+    if (m_view == nullptr)
+    {
+        g_debugCallback("Unable to map capture file");
+        if (m_mapping != nullptr)
+            CloseHandle(m_mapping);
+        CloseHandle(m_file);
+        m_mapping = nullptr;
+        m_file = INVALID_HANDLE_VALUE;
+        return false;
+    }
+
+    CaptureFileHeader header;
+    header.magic = MAGIC;
+    header.version = VERSION;
+    header.recordSize = sizeof(CaptureRecordHeader);
+    std::memcpy(m_view, &header, sizeof(header));
+
+    m_startTime = clock::now();
+    m_writeOffset.store(sizeof(CaptureFileHeader), std::memory_order_relaxed);
+    m_recordCount.store(0, std::memory_order_relaxed);
+    m_droppedCount.store(0, std::memory_order_relaxed);
+    m_recording.store(true);
+    return true;
+}
+
+void PacketCapture::Stop()
+{
+    if (!m_recording.exchange(false))
+        return;
+
+    // A record that saw m_recording set before the exchange is still copying into the view
+    while (m_writers.load() != 0)
+        std::this_thread::yield();
+
+    const uint64_t end = m_writeOffset.load(std::memory_order_relaxed);
+    const uint64_t dataSize = end - sizeof(CaptureFileHeader);
+    std::memcpy(m_view + offsetof(CaptureFileHeader, dataSize), &dataSize, sizeof(dataSize));
+
+    UnmapViewOfFile(m_view);
+    CloseHandle(m_mapping);
+
+    LARGE_INTEGER size;
+    size.QuadPart = static_cast<LONGLONG>(end);
+    if (!SetFilePointerEx(m_file, size, nullptr, FILE_BEGIN) || !SetEndOfFile(m_file))
+        g_debugCallback("Unable to trim capture file");
+    CloseHandle(m_file);
+
+    m_view = nullptr;
+    m_mapping = nullptr;
+    m_file = INVALID_HANDLE_VALUE;
+}
+
+bool PacketCapture::IsRecording() const
+{
+    return m_recording.load(std::memory_order_relaxed);
+}
+
+bool PacketCapture::Reserve(const uint64_t p_size, uint64_t& o_offset)
+{
+    o_offset = m_writeOffset.load(std::memory_order_relaxed);
+    do
+    {
+        if (o_offset + p_size > m_capacity)
+        {
+            m_droppedCount.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+    } while (!m_writeOffset.compare_exchange_weak(o_offset, o_offset + p_size, std::memory_order_relaxed));
+
+    m_recordCount.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void PacketCapture::WriteHeader(const uint64_t p_offset, const CaptureRecordType p_type, const Address& p_address, const uint16_t p_size) const
+{
+    CaptureRecordHeader record;
+    record.timestamp = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - m_startTime).count());
+    record.address = ntohl(p_address.GetAddress());
+    record.port = p_address.GetPort();
+    record.size = p_size;
+    record.type = p_type;
+    std::memcpy(m_view + p_offset, &record, sizeof(record));
+}
+
+void PacketCapture::Record(const CaptureRecordType p_type, const Address& p_address, const unsigned char* p_data, const int p_size)
+{
+    if (!IsRecording() || p_size < 0)
+        return;
+
+    m_writers.fetch_add(1);
+    uint64_t offset;
+    if (m_recording.load() && Reserve(sizeof(CaptureRecordHeader) + p_size, offset))
+    {
+        WriteHeader(offset, p_type, p_address, static_cast<uint16_t>(p_size));
+        std::memcpy(m_view + offset + sizeof(CaptureRecordHeader), p_data, p_size);
+    }
+    m_writers.fetch_sub(1);
+}
+
+void PacketCapture::Record(const CaptureRecordType p_type, const Address& p_address, const WSABUF* p_buffers, const unsigned int p_bufferCount)
+{
+    if (!IsRecording())
+        return;
+
+    uint64_t size = 0;
+    for (unsigned int i = 0; i < p_bufferCount; ++i)
+        size += p_buffers[i].len;
+
+    m_writers.fetch_add(1);
+    uint64_t offset;
+    if (m_recording.load() && Reserve(sizeof(CaptureRecordHeader) + size, offset))
+    {
+        WriteHeader(offset, p_type, p_address, static_cast<uint16_t>(size));
+        offset += sizeof(CaptureRecordHeader);
+        for (unsigned int i = 0; i < p_bufferCount; ++i)
+        {
+            std::memcpy(m_view + offset, p_buffers[i].buf, p_buffers[i].len);
+            offset += p_buffers[i].len;
+        }
+    }
+    m_writers.fetch_sub(1);
+}
+
+uint64_t PacketCapture::GetRecordCount() const
+{
+    return m_recordCount.load(std::memory_order_relaxed);
+}
+
+uint64_t PacketCapture::GetDroppedCount() const
+{
+    return m_droppedCount.load(std::memory_order_relaxed);
+}
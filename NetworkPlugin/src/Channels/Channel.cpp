@@ -0,0 +1,277 @@
+#include "stdafx.h"
+#include "Network/Channels/Channel.h"
+
+void Channel::Reset()
+{
+    m_sendSequence = 0;
+    m_oldestUnackedMessage = 0;
+    m_sendQueue.clear();
+    m_sentMessages.Reset();
+    m_ackedMessages.Reset();
+    m_lastAckedMessage = 0;
+    m_hasAckedMessage = false;
+    m_newestAckedPacket = 0;
+    m_hasAckedPacket = false;
+
+    m_receiveSequence = 0;
+    m_lastReceivedPacket = 0;
+    m_lastReceivedMessage = 0;
+    m_hasReceived = false;
+    m_receivedMessages.Reset();
+    m_receiveQueue.clear();
+
+    m_parityEncoder.Reset();
+    m_pendingParity = {};
+    m_parityDecoder.Reset();
+}
+
+void Channel::SetIndex(const uint8_t p_index)
+{
+    m_index = p_index;
+}
+
+void Channel::SetMode(const ChannelMode p_mode)
+{
+    m_mode = p_mode;
+    Reset();
+}
+
+ChannelMode Channel::GetMode() const
+{
+    return m_mode;
+}
+
+void Channel::SetParityGroupSize(const unsigned int p_groupSize)
+{
+    m_parityEncoder.SetGroupSize(p_groupSize);
+    m_pendingParity = {};
+}
+
+unsigned int Channel::GetParityGroupSize() const
+{
+    return m_parityEncoder.GetGroupSize();
+}
+
+bool Channel::Send(MessageData p_data, uint16_t* o_id)
+{
+    if (m_mode != ChannelMode::RELIABLE_ORDERED)
+    {
+        if (m_sendQueue.size() >= MAX_SEND_QUEUE_SIZE)
+            return false;
+        // Unreliable messages are numbered too, so their acks and fragments can be told apart
+        if (o_id != nullptr)
+            *o_id = m_sendSequence;
+        m_sendQueue.push_back({ m_index, m_sendSequence++, std::move(p_data) });
+        return true;
+    }
+
+    if (static_cast<uint16_t>(m_sendSequence - m_oldestUnackedMessage) >= MESSAGE_WINDOW_SIZE)
+        return false;
+
+    if (o_id != nullptr)
+        *o_id = m_sendSequence;
+    SentMessage* message = m_sentMessages.Insert(m_sendSequence++);
+    message->data = std::move(p_data);
+    return true;
+}
+
+uint16_t Channel::TakeMessageId()
+{
+    return m_sendSequence++;
+}
+
+bool Channel::GetNextMessage(const clock::time_point p_now, const clock::duration p_resendTime, const uint32_t p_maxSize, Message& o_message)
+{
+    if (m_pendingParity.data != nullptr)
+    {
+        if (m_pendingParity.data->size() > p_maxSize)
+            return false;
+
+        o_message = std::move(m_pendingParity);
+        m_pendingParity = {};
+        return true;
+    }
+
+    if (!m_sendQueue.empty())
+    {
+        if (m_sendQueue.front().data->size() > p_maxSize)
+            return false;
+
+        o_message = std::move(m_sendQueue.front());
+        m_sendQueue.pop_front();
+        if (m_parityEncoder.Add(o_message.id, *o_message.data, m_pendingParity.data))
+            m_pendingParity = { m_index, o_message.id, std::move(m_pendingParity.data), true };
+        return true;
+    }
+
+    for (uint16_t id = m_oldestUnackedMessage; id != m_sendSequence; ++id)
+    {
+        SentMessage* message = m_sentMessages.Find(id);
+        if (message == nullptr || (message->sent && p_now - message->lastSent < p_resendTime) || message->data->size() > p_maxSize)
+            continue;
+
+        // Resends aren't protected, they are already late
+        if (!message->sent && m_parityEncoder.Add(id, *message->data, m_pendingParity.data))
+            m_pendingParity = { m_index, id, std::move(m_pendingParity.data), true };
+
+        message->sent = true;
+        message->lastSent = p_now;
+        o_message = { m_index, id, message->data };
+        return true;
+    }
+    return false;
+}
+
+bool Channel::HasMessagesToSend() const
+{
+    return m_pendingParity.data != nullptr || !m_sendQueue.empty() || (m_mode == ChannelMode::RELIABLE_ORDERED && m_oldestUnackedMessage != m_sendSequence);
+}
+
+void Channel::TrimSendQueue()
+{
+    switch (m_mode)
+    {
+        case ChannelMode::UNRELIABLE:
+            m_sendQueue.clear();
+            break;
+        case ChannelMode::UNRELIABLE_SEQUENCED:
+            // The receiver drops anything older than the last message it got, only the most recent is worth sending
+            if (m_sendQueue.size() > 1)
+                m_sendQueue.erase(m_sendQueue.begin(), m_sendQueue.end() - 1);
+            break;
+        case ChannelMode::RELIABLE_ORDERED:
+            break;
+    }
+}
+
+void Channel::OnMessageAcked(const uint16_t p_id, const uint16_t p_packetSequence)
+{
+    // The receiver drops a sequenced message when a newer packet of the channel came first. Acks are processed newest first,
+    // so an older packet acked after a newer one may have been dropped, messages of the same packet are all delivered
+    const bool delivered = m_mode != ChannelMode::UNRELIABLE_SEQUENCED || !m_hasAckedPacket
+                           || !Packet::SequenceGreaterThan(m_newestAckedPacket, p_packetSequence);
+    if (!m_hasAckedPacket || Packet::SequenceGreaterThan(p_packetSequence, m_newestAckedPacket))
+    {
+        m_hasAckedPacket = true;
+        m_newestAckedPacket = p_packetSequence;
+    }
+
+    if (!m_ackedMessages.Exists(p_id))
+    {
+        bool* ackedMessage = m_ackedMessages.Insert(p_id);
+        if (ackedMessage != nullptr)
+            *ackedMessage = delivered;
+    }
+    if (!m_hasAckedMessage || Packet::SequenceGreaterThan(p_id, m_lastAckedMessage))
+    {
+        m_hasAckedMessage = true;
+        m_lastAckedMessage = p_id;
+    }
+
+    if (m_mode != ChannelMode::RELIABLE_ORDERED)
+        return;
+
+    m_sentMessages.Remove(p_id);
+    while (m_oldestUnackedMessage != m_sendSequence && !m_sentMessages.Exists(m_oldestUnackedMessage))
+        ++m_oldestUnackedMessage;
+}
+
+void Channel::ProcessMessage(const uint16_t p_packetSequence, const uint16_t p_id, MessageData p_data, const clock::time_point p_arrival)
+{
+    // Already received, or rebuilt from a parity
+    if (GetParityGroupSize() > 0 && !m_parityDecoder.AddMessage(p_id, p_data))
+        return;
+
+    Deliver(p_packetSequence, p_id, std::move(p_data), false, p_arrival);
+    RecoverMessages(p_arrival);
+}
+
+void Channel::ProcessParity(MessageData p_parity, const clock::time_point p_arrival)
+{
+    // Received messages are only remembered once parity is enabled on this side too
+    if (GetParityGroupSize() == 0)
+        return;
+    m_parityDecoder.AddParity(std::move(p_parity));
+    RecoverMessages(p_arrival);
+}
+
+void Channel::RecoverMessages(const clock::time_point p_arrival)
+{
+    uint16_t id;
+    MessageData data;
+    while (m_parityDecoder.Recover(id, data))
+        Deliver(0, id, std::move(data), true, p_arrival);
+}
+
+void Channel::Deliver(const uint16_t p_packetSequence, const uint16_t p_id, MessageData p_data, const bool p_recovered,
+                      const clock::time_point p_arrival)
+{
+    switch (m_mode)
+    {
+        case ChannelMode::UNRELIABLE:
+            m_receiveQueue.push_back({ std::move(p_data), p_arrival });
+            break;
+        case ChannelMode::UNRELIABLE_SEQUENCED:
+            // The packet of a recovered message is unknown, it is ordered by message id instead
+            if (m_hasReceived && (p_recovered ? Packet::SequenceGreaterThan(m_lastReceivedMessage, p_id)
+                                              : Packet::SequenceGreaterThan(m_lastReceivedPacket, p_packetSequence)))
+                return;
+            m_hasReceived = true;
+            if (!p_recovered)
+                m_lastReceivedPacket = p_packetSequence;
+            m_lastReceivedMessage = p_id;
+            m_receiveQueue.push_back({ std::move(p_data), p_arrival });
+            break;
+        case ChannelMode::RELIABLE_ORDERED:
+        {
+            // Already delivered, or too far ahead to be buffered
+            if (static_cast<uint16_t>(p_id - m_receiveSequence) >= MESSAGE_WINDOW_SIZE)
+                return;
+
+            ReceivedMessage* message = m_receivedMessages.Insert(p_id);
+            if (message == nullptr)
+                return;
+            *message = { std::move(p_data), p_arrival };
+
+            while ((message = m_receivedMessages.Find(m_receiveSequence)) != nullptr)
+            {
+                m_receiveQueue.push_back(std::move(*message));
+                m_receivedMessages.Remove(m_receiveSequence);
+                ++m_receiveSequence;
+            }
+            break;
+        }
+    }
+}
+
+bool Channel::GetLastAckedMessage(uint16_t& o_id) const
+{
+    o_id = m_lastAckedMessage;
+    return m_hasAckedMessage;
+}
+
+bool Channel::IsMessageAcked(const uint16_t p_id) const
+{
+    return m_ackedMessages.Exists(p_id);
+}
+
+bool Channel::IsMessageDelivered(const uint16_t p_id) const
+{
+    // Reliable messages are held by the receiver until every older one arrived
+    if (m_mode == ChannelMode::RELIABLE_ORDERED)
+        return Packet::SequenceGreaterThan(m_oldestUnackedMessage, p_id);
+    const bool* delivered = m_ackedMessages.Find(p_id);
+    return delivered != nullptr && *delivered;
+}
+
+bool Channel::Receive(MessageData& o_data, clock::time_point* o_arrival)
+{
+    if (m_receiveQueue.empty())
+        return false;
+
+    o_data = std::move(m_receiveQueue.front().data);
+    if (o_arrival != nullptr)
+        *o_arrival = m_receiveQueue.front().arrival;
+    m_receiveQueue.pop_front();
+    return true;
+}
@@ -0,0 +1,143 @@
+#include "stdafx.h"
+#include "Network/Channels/ParityGroup.h"
+
+void ParityEncoder::Reset()
+{
+    m_ids.clear();
+    m_parity.clear();
+}
+
+void ParityEncoder::SetGroupSize(const unsigned int p_groupSize)
+{
+    m_groupSize = std::min(p_groupSize, MAX_GROUP_SIZE);
+    Reset();
+}
+
+unsigned int ParityEncoder::GetGroupSize() const
+{
+    return m_groupSize;
+}
+
+bool ParityEncoder::Add(const uint16_t p_id, const std::vector<uint8_t>& p_data, std::shared_ptr<const std::vector<uint8_t>>& o_parity)
+{
+    if (m_groupSize == 0 || p_data.size() > MAX_PROTECTED_SIZE)
+        return false;
+
+    const size_t size = p_data.size();
+    if (m_parity.size() < sizeof(uint16_t) + size)
+        m_parity.resize(sizeof(uint16_t) + size, 0);
+    m_parity[0] ^= static_cast<uint8_t>(size >> 8);
+    m_parity[1] ^= static_cast<uint8_t>(size);
+    for (size_t i = 0; i < size; ++i)
+        m_parity[sizeof(uint16_t) + i] ^= p_data[i];
+    m_ids.push_back(p_id);
+
+    if (m_ids.size() < m_groupSize)
+        return false;
+
+    auto parity = std::make_shared<std::vector<uint8_t>>();
+    parity->reserve(sizeof(uint8_t) + m_ids.size() * sizeof(uint16_t) + m_parity.size());
+    parity->push_back(static_cast<uint8_t>(m_ids.size()));
+    for (const uint16_t id : m_ids)
+    {
+        parity->push_back(static_cast<uint8_t>(id >> 8));
+        parity->push_back(static_cast<uint8_t>(id));
+    }
+    parity->insert(parity->end(), m_parity.begin(), m_parity.end());
+    o_parity = std::move(parity);
+    Reset();
+    return true;
+}
+
+void ParityDecoder::Reset()
+{
+    m_received.Reset();
+    m_pending.fill(nullptr);
+    m_nextPending = 0;
+}
+
+bool ParityDecoder::AddMessage(const uint16_t p_id, const MessageData& p_data)
+{
+    if (m_received.Exists(p_id))
+        return false;
+
+    // Too old to be remembered, the channel decides what to do with it
+    MessageData* message = m_received.Insert(p_id);
+    if (message != nullptr)
+        *message = p_data;
+    return true;
+}
+
+void ParityDecoder::AddParity(MessageData p_parity)
+{
+    // The oldest pending parity is given up when the ring is full
+    m_pending[m_nextPending] = std::move(p_parity);
+    m_nextPending = (m_nextPending + 1) % MAX_PENDING_PARITY;
+}
+
+bool ParityDecoder::Recover(uint16_t& o_id, MessageData& o_data)
+{
+    for (MessageData& parity : m_pending)
+    {
+        if (parity == nullptr)
+            continue;
+
+        bool recovered = false;
+        if (Resolve(*parity, recovered, o_id, o_data))
+            parity = nullptr;
+        if (recovered)
+            return true;
+    }
+    return false;
+}
+
+bool ParityDecoder::Resolve(const std::vector<uint8_t>& p_parity, bool& o_recovered, uint16_t& o_id, MessageData& o_data)
+{
+    const size_t count = p_parity.empty() ? 0 : p_parity[0];
+    const size_t blockOffset = sizeof(uint8_t) + count * sizeof(uint16_t);
+    if (count == 0 || count > ParityEncoder::MAX_GROUP_SIZE || p_parity.size() < blockOffset + sizeof(uint16_t))
+        return true;
+
+    unsigned int missingCount = 0;
+    uint16_t missingId = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        const uint16_t id = static_cast<uint16_t>((p_parity[1 + 2 * i] << 8) | p_parity[2 + 2 * i]);
+        if (m_received.IsTooOld(id))
+            return true;
+        if (!m_received.Exists(id))
+        {
+            ++missingCount;
+            missingId = id;
+        }
+    }
+    if (missingCount != 1)
+        return missingCount == 0;
+
+    std::vector<uint8_t> block(p_parity.begin() + blockOffset, p_parity.end());
+    for (size_t i = 0; i < count; ++i)
+    {
+        const uint16_t id = static_cast<uint16_t>((p_parity[1 + 2 * i] << 8) | p_parity[2 + 2 * i]);
+        if (id == missingId)
+            continue;
+
+        const std::vector<uint8_t>& data = **m_received.Find(id);
+        if (sizeof(uint16_t) + data.size() > block.size())
+            return true;
+        block[0] ^= static_cast<uint8_t>(data.size() >> 8);
+        block[1] ^= static_cast<uint8_t>(data.size());
+        for (size_t j = 0; j < data.size(); ++j)
+            block[sizeof(uint16_t) + j] ^= data[j];
+    }
+
+    const size_t size = (static_cast<size_t>(block[0]) << 8) | block[1];
+    if (sizeof(uint16_t) + size > block.size())
+        return true;
+
+    auto data = std::make_shared<const std::vector<uint8_t>>(block.begin() + sizeof(uint16_t), block.begin() + sizeof(uint16_t) + size);
+    *m_received.Insert(missingId) = data;
+    o_id = missingId;
+    o_data = std::move(data);
+    o_recovered = true;
+    return true;
+}
@@ -4,6 +4,8 @@
 #include "Network/Packets/Packet.h"
 #include "Network/Address.h"
 #include "Network/NetworkPlugin.h"
+#include "Network/Tracing/Tracer.h"
+#include "Network/Logging/Logger.h"
 
 using namespace std::chrono_literals;
 using namespace Cryptography;
@@ -16,6 +18,7 @@ Client::Client()
 
 Client::~Client()
 {
+    StopNetworkThread();
     if(m_state == ClientState::CONNECTED)
         SendDisconnect();
     m_socket.Close();
@@ -24,7 +27,7 @@ Client::~Client()
 
 void Client::SetupBroadcastSocket()
 {
-    if (!m_socket.Open(CLIENT_PORT) || !m_socket.AllowBroadcast())
+    if (!m_socket.Open(CLIENT_PORT) || !m_socket.AllowBroadcast() || !m_socket.SetDontFragment(true))
     {
         g_debugCallback("Unable to open client socket");
     }
@@ -32,75 +35,93 @@ void Client::SetupBroadcastSocket()
 
 void Client::Connect()
 {
+    if (m_runNetworkThread.load() && !IsNetworkThread())
+    {
+        m_connectRequested.store(true);
+        return;
+    }
+
     try
     {
         if(m_state.load() == ClientState::DISCONNECTED)
         {
-            Buffer packet;
             KeyExchange::DiffieHellman::GenerateKeyPair(m_privateKey, m_publicKey);
             //m_salt = m_saltDistribution(m_random);
-            ConnectionRequestPacket packetInfo {m_publicKey};
-            packetInfo.Write(packet);
             m_state.store(ClientState::SENDING_REQUEST);
-
-            const clock::time_point start = clock::now();
-            //while(m_state.load() == ClientState::SENDING_REQUEST)
-            {
-                if(!m_socket.Send({INADDR_BROADCAST, SERVER_PORT}, packet.data, packet.size))
-                    g_debugCallback("Failed to send connection request packet");
-                else
-                    g_debugCallback("Client sent connection request packet");
-                /*if((std::chrono::high_resolution_clock::now() - start) > 5s)
-                {
-                    g_debugCallback("Connection attempt timed out after 5s");
-                    Disconnect();
-                    return;
-                }*/
-                //std::this_thread::sleep_for(1000ms);
-            }
+            m_handshakeStart = clock::now();
+            m_connectRequestTime = m_handshakeStart;
+            SendConnectionRequest();
         }
     }
     catch(std::exception& e)
     {
-        g_debugCallback(e.what());
+        NETWORK_LOG(FAILURE, "{}", e.what());
     }
 
 }
 
+void Client::SendConnectionRequest()
+{
+    NETWORK_TRACE_ZONE("Handshake::SendConnectionRequest");
+    Buffer packet;
+    ConnectionRequestPacket packetInfo {m_publicKey};
+    packetInfo.Write(packet);
+    m_lastHandshakeSend = clock::now();
+    if(!m_socket.Send({INADDR_BROADCAST, SERVER_PORT}, packet.data, packet.size))
+        NETWORK_LOG(WARNING, "Failed to send connection request packet");
+    else
+        NETWORK_LOG(VERBOSE, "Client sent connection request packet");
+}
+
 void Client::RespondChallenge()
 {
+    NETWORK_TRACE_ZONE("Handshake::RespondChallenge");
     try
     {
         Buffer packet;
         ChallengeResponsePacket packetInfo;
         packetInfo.Write(packet, m_sharedKey);
-        m_state.store(ClientState::SENDING_CHALLENGE_RESPONSE);
-        const clock::time_point start = clock::now();
-        //while(m_state.load() == ClientState::SENDING_CHALLENGE_RESPONSE)
-        {
-            g_debugCallback(m_serverAddress.ToString().c_str());
-            if(!m_socket.Send(m_serverAddress, packet.data, packet.size))
-                g_debugCallback("Failed to send Challenge Response packet");
-            else
-                g_debugCallback("Client sent Challenge Response packet");
-
-            /*if((std::chrono::high_resolution_clock::now() - start) > 5s)
-            {
-                g_debugCallback("Respond Challenge attempt timed out after 5s");
-                SendDisconnect();
-                return;
-            }*/
-            //std::this_thread::sleep_for(1000ms);
-        }
+        m_lastHandshakeSend = clock::now();
+        if(!m_socket.Send(m_serverAddress, packet.data, packet.size))
+            NETWORK_LOG(WARNING, "Failed to send Challenge Response packet");
+        else
+            NETWORK_LOG(VERBOSE, "Client sent Challenge Response packet");
     }
     catch(std::exception& e)
     {
-        g_debugCallback(e.what());
+        NETWORK_LOG(FAILURE, "{}", e.what());
+    }
+}
+
+void Client::UpdateHandshake(const clock::time_point p_now)
+{
+    const ClientState state = m_state.load();
+    if (state != ClientState::SENDING_REQUEST && state != ClientState::SENDING_CHALLENGE_RESPONSE)
+        return;
+
+    if (p_now - m_handshakeStart > HANDSHAKE_TIMEOUT)
+    {
+        NETWORK_LOG(WARNING, "Connection attempt timed out after 5s");
+        SendDisconnect();
+        return;
     }
+    if (p_now - m_lastHandshakeSend < HANDSHAKE_RESEND_INTERVAL)
+        return;
+
+    if (state == ClientState::SENDING_REQUEST)
+        SendConnectionRequest();
+    else
+        RespondChallenge();
 }
 
 void Client::SendDisconnect()
 {
+    if (m_runNetworkThread.load() && !IsNetworkThread())
+    {
+        m_disconnectRequested.store(true);
+        return;
+    }
+
     try
     {
         if(m_state.load() != ClientState::DISCONNECTED && m_state.load() != ClientState::SENDING_REQUEST)
@@ -111,33 +132,59 @@ void Client::SendDisconnect()
             for(int i = 0; i < 10; ++i)
             {
                 if(!m_socket.Send(m_serverAddress, packet.data, packet.size))
-                    g_debugCallback("Failed to send Disconnect packet");
+                    NETWORK_LOG(WARNING, "Failed to send Disconnect packet");
             }
-            g_debugCallback("Client sent Disconnect packets");
+            NETWORK_LOG(VERBOSE, "Client sent Disconnect packets");
         }
         Disconnect();
     }
     catch(std::exception& e)
     {
-        g_debugCallback(e.what());
+        NETWORK_LOG(FAILURE, "{}", e.what());
     }
 }
 
 void Client::HandlePacket(const ChallengePacket& p_packet)
 {
+    NETWORK_TRACE_ZONE("Handshake::Challenge");
     //if(p_packet.clientSalt != m_salt)
     //    return;
     auto sharedKey = KeyExchange::DiffieHellman::GenerateSharedKey(p_packet.serverPublicKey, m_privateKey);
     m_sharedKey = Hash::SHA256().Hash(reinterpret_cast<unsigned char*>(sharedKey.Get64BitArray()), PUBLIC_KEY_SIZE / 8);
-    std::thread respondThread(&Client::RespondChallenge, this);
-    respondThread.detach();
+    m_socket.OnSessionKey(m_serverAddress, m_sharedKey);
+    m_state.store(ClientState::SENDING_CHALLENGE_RESPONSE);
+    m_handshakeStart = clock::now();
+    RespondChallenge();
 }
 
 void Client::HandlePacket(const ConnectionAcceptedPacket& p_packet)
 {
+    NETWORK_TRACE_ZONE("Handshake::ConnectionAccepted");
     m_index = p_packet.clientID;
+    m_connection.Reset();
+    m_connection.SetId(m_index);
+    m_inputs.Reset();
+    m_latencies[static_cast<size_t>(LatencyMetric::HANDSHAKE)].Record(clock::now() - m_connectRequestTime);
+    // Snapshots and entities belong to the game thread, it resets them when it reaches the marker
+    if (m_runNetworkThread.load())
+    {
+        if (!m_incoming.TryPush({}))
+            NETWORK_LOG(WARNING, "Receive ring full, connection marker dropped");
+    }
+    else
+    {
+        ResetReceivedState();
+    }
     m_state.store(ClientState::CONNECTED);
-    g_debugCallback("Client is connected");
+    NETWORK_LOG(INFO, "Client is connected");
+}
+
+void Client::ResetReceivedState()
+{
+    m_snapshots.Reset();
+    m_jitterBuffer.Reset();
+    m_replication.Reset();
+    m_prediction.Reset();
 }
 
 void Client::Disconnect()
@@ -147,19 +194,29 @@ void Client::Disconnect()
     m_state.store(ClientState::DISCONNECTED);
 }
 
-int Client::Listen(unsigned char* o_gameData, const unsigned int p_size)
+bool Client::ReceivePacket()
 {
-    Buffer buffer(1024);
+    NETWORK_TRACE_ZONE("Client::ReceivePacket");
+    Buffer buffer(Packet::MAX_PACKET_SIZE);
     buffer.size = m_socket.Receive(m_serverAddress,buffer.data, buffer.size);
+    if (buffer.size <= 0)
+        return false;
 
+    m_connection.OnDatagramReceived(static_cast<uint32_t>(buffer.size));
     PacketType packetType = PacketType::INVALID_PACKET;
     if (m_state.load() == ClientState::DISCONNECTED || m_state.load() == ClientState::SENDING_REQUEST)
     {
         packetType = Packet::VerifyPacketCRC(buffer);
+        if (packetType == PacketType::INVALID_PACKET)
+            m_connection.OnChecksumFailed();
     }
     else
     {
+        const clock::time_point verifyStart = clock::now();
         packetType = Packet::VerifyPacketHMAC(m_sharedKey, buffer);
+        m_latencies[static_cast<size_t>(LatencyMetric::HMAC_VERIFY)].Record(clock::now() - verifyStart);
+        if (packetType == PacketType::INVALID_PACKET)
+            m_connection.OnAuthenticationFailed();
     }
 
     if(packetType != PacketType::INVALID_PACKET)
@@ -171,7 +228,7 @@ int Client::Listen(unsigned char* o_gameData, const unsigned int p_size)
         {
             if(m_state.load() == ClientState::SENDING_REQUEST)
             {
-                g_debugCallback("Client received CHALLENGE packet");
+                NETWORK_LOG(VERBOSE, "Client received CHALLENGE packet");
                 ChallengePacket packetInfo{};
                 packetInfo.Read(buffer);
                 HandlePacket(packetInfo);
@@ -182,7 +239,7 @@ int Client::Listen(unsigned char* o_gameData, const unsigned int p_size)
         {
             if(m_state.load() == ClientState::SENDING_CHALLENGE_RESPONSE)
             {
-                g_debugCallback("Client received CONNECTION_ACCEPTED packet");
+                NETWORK_LOG(VERBOSE, "Client received CONNECTION_ACCEPTED packet");
                 ConnectionAcceptedPacket packetInfo{};
                 packetInfo.Read(buffer);
                 HandlePacket(packetInfo);
@@ -190,142 +247,1026 @@ int Client::Listen(unsigned char* o_gameData, const unsigned int p_size)
             break;
         }
         case PacketType::CONNECTION_DATA: 
+        {
+            if (m_state.load() == ClientState::CONNECTED)
+                m_connection.ReadPacket(buffer);
+            break;
+        }
+        case PacketType::CONNECTION_DATA_FRAGMENT:
+        {
+            if (m_state.load() == ClientState::CONNECTED)
+                m_connection.ReadFragment(buffer);
+            break;
+        }
+        case PacketType::MTU_PROBE:
         {
             if (m_state.load() == ClientState::CONNECTED)
             {
-                ConnectionDataPacket packetInfo;
-                packetInfo.Read(buffer);
-                if (Packet::SequenceGreaterThan(packetInfo.sequence, m_ack))
-                {
-                    m_ack = packetInfo.sequence;
-                    if (static_cast<int>(p_size) >= packetInfo.gameDataSize)
-                        memcpy(o_gameData, packetInfo.gameData, packetInfo.gameDataSize);
-                    else
-                    {
-                        g_debugCallback("Buffer too small for Game Data");
-                        return -1;
-                    }
-                    return packetInfo.gameDataSize;
-                }
-                return 0;
+                MtuProbePacket probeInfo{};
+                probeInfo.Read(buffer);
+                Buffer packet;
+                MtuProbeAckPacket { probeInfo.id, probeInfo.size }.Write(packet, m_sharedKey);
+                if (!m_socket.Send(m_serverAddress, packet.data, packet.size))
+                    NETWORK_LOG(WARNING, "Failed to send MtuProbeAck packet");
+            }
+            break;
+        }
+        case PacketType::MTU_PROBE_ACK:
+        {
+            if (m_state.load() == ClientState::CONNECTED)
+            {
+                MtuProbeAckPacket ackInfo{};
+                ackInfo.Read(buffer);
+                m_connection.OnMtuProbeAcked(ackInfo);
             }
+            break;
         }
         case PacketType::DISCONNECT:
             if(m_state.load() != ClientState::DISCONNECTED)
             {
-                g_debugCallback("Client received DISCONNECT packet");
+                NETWORK_LOG(VERBOSE, "Client received DISCONNECT packet");
                 Disconnect();
             }
             break;
         default: break;
     }
-    if(m_activeTimeout && m_state.load() == ClientState::CONNECTED && clock::now() - m_lastReceivedPacket > 5s)
+    return true;
+}
+
+int Client::Listen(unsigned char* o_gameData, const unsigned int p_size, uint8_t* o_channel)
+{
+    NETWORK_TRACE_ZONE("Client::Listen");
+    QueuedMessage message;
+    if (m_runNetworkThread.load())
+    {
+        while (m_incoming.TryPop(message))
+        {
+            if (message.data == nullptr)
+            {
+                ResetReceivedState();
+                continue;
+            }
+            m_latencies[static_cast<size_t>(LatencyMetric::DELIVERY)].Record(clock::now() - message.arrival);
+            const int result = HandleMessage(message.channel, std::move(message.data), message.receivedAt, o_gameData, p_size, o_channel);
+            if (result != 0)
+                return result;
+        }
+        return 0;
+    }
+
+    ReceivePacket();
+    const clock::time_point now = clock::now();
+    UpdateHandshake(now);
+    if(m_activeTimeout && m_state.load() == ClientState::CONNECTED && now - m_lastReceivedPacket > 5s)
     {
-        g_debugCallback("Client connection timed out!");
+        NETWORK_LOG(WARNING, "Client connection timed out!");
         SendDisconnect();
         return 0;
     }
+
+    if (m_state.load() != ClientState::CONNECTED)
+        return 0;
+
+    SendPendingPackets();
+
+    while (m_connection.ReceiveMessage(message.channel, message.data, &message.arrival))
+    {
+        m_latencies[static_cast<size_t>(LatencyMetric::DELIVERY)].Record(clock::now() - message.arrival);
+        const int result = HandleMessage(message.channel, std::move(message.data), GetLocalMilliseconds(), o_gameData, p_size, o_channel);
+        if (result != 0)
+            return result;
+    }
     return 0;
 }
 
-bool Client::SendGameData(const unsigned char* p_data, unsigned int p_size)
+int Client::HandleMessage(const uint8_t p_channel, MessageData p_data, const double p_receivedAt, unsigned char* o_gameData,
+                          const unsigned int p_size, uint8_t* o_channel)
 {
-    if(m_state.load() == ClientState::CONNECTED)
+    if (p_channel == m_replicationChannels[0] || p_channel == m_replicationChannels[1])
     {
-        Buffer packet;
-        ConnectionDataPacket packetInfo { ++m_sequence, p_size, new unsigned char[p_size] };
-        memcpy(packetInfo.gameData, p_data, p_size);
-        packetInfo.Write(packet, m_sharedKey);
-        if(!m_socket.Send(m_serverAddress, packet.data, packet.size))
+        if (!m_replication.ProcessMessage(p_data))
+            NETWORK_LOG(WARNING, "Malformed replication message");
+        return 0;
+    }
+    if (p_channel == m_snapshotChannel)
+    {
+        uint32_t serverTime;
+        if ((p_data = m_snapshots.Decode(p_data, &serverTime)) == nullptr)
+            return 0;
+        if (m_useJitterBuffer)
         {
-            g_debugCallback("Failed to send ConnectionData packet");
-            return false;
+            m_jitterBuffer.Add(serverTime, p_data, p_receivedAt);
+            return 0;
         }
-        return true;
     }
-    return false;
+
+    if (p_size < p_data->size())
+    {
+        NETWORK_LOG(WARNING, "Buffer too small for Game Data");
+        return -1;
+    }
+    memcpy(o_gameData, p_data->data(), p_data->size());
+    if (o_channel != nullptr)
+        *o_channel = p_channel;
+    return static_cast<int>(p_data->size());
 }
 
-void Client::SetActiveTimeout(bool p_value)
+void Client::StartNetworkThread()
 {
-    m_activeTimeout = p_value;
+    if (m_runNetworkThread.load())
+        return;
+    m_runNetworkThread.store(true);
+    m_networkThread = std::thread(&Client::RunNetworkThread, this);
 }
 
-int Client::GetIndex() const
+void Client::StopNetworkThread()
 {
-    return m_index;
+    if (!m_runNetworkThread.load())
+        return;
+    m_runNetworkThread.store(false);
+    if (m_networkThread.joinable())
+        m_networkThread.join();
+    m_networkThreadId.store(std::thread::id());
+    m_outgoing.Clear();
+    m_incoming.Clear();
 }
 
-char Client::GetState() const
+bool Client::IsNetworkThread() const
 {
-    return static_cast<char>(m_state.load());
+    return std::this_thread::get_id() == m_networkThreadId.load();
 }
 
+bool Client::IsConfigurationLocked(const char* p_setting) const
+{
+    if (!m_runNetworkThread.load())
+        return false;
+    NETWORK_LOG(WARNING, "Stop the network thread before changing {}", p_setting);
+    return true;
+}
 
-#pragma region CExport
-extern "C"
+Client::PublishedState Client::GetPublishedState() const
 {
-    Client* Internal_ClientCreate()
+    if (m_runNetworkThread.load())
+        return m_published.Read();
+    return { m_connection.GetStats(), m_connection.GetLastSentSequence(),
+             m_connection.HasTimeSync() ? m_connection.GetRemoteTime() / 1000000.0 : -1.0, clock::now() };
+}
+
+void Client::RunNetworkThread()
+{
+    m_networkThreadId.store(std::this_thread::get_id());
+    while (m_runNetworkThread.load())
     {
-        return new Client;
+        try
+        {
+            if (m_connectRequested.exchange(false))
+                Connect();
+            if (m_disconnectRequested.exchange(false))
+                SendDisconnect();
+
+            m_socket.WaitForData(NETWORK_THREAD_WAIT);
+            while (ReceivePacket()) {}
+
+            const clock::time_point now = clock::now();
+            UpdateHandshake(now);
+            if (m_activeTimeout && m_state.load() == ClientState::CONNECTED && now - m_lastReceivedPacket > 5s)
+            {
+                NETWORK_LOG(WARNING, "Client connection timed out!");
+                SendDisconnect();
+            }
+
+            m_published.Publish({ m_connection.GetStats(), m_connection.GetLastSentSequence(),
+                                  m_connection.HasTimeSync() ? m_connection.GetRemoteTime() / 1000000.0 : -1.0, now });
+
+            QueuedMessage message;
+            if (m_state.load() != ClientState::CONNECTED)
+            {
+                m_outgoing.Clear();
+                continue;
+            }
+
+            while (m_outgoing.TryPop(message))
+            {
+                if (message.isInput)
+                    QueueInput(message.tick, std::move(message.data));
+                else if (!m_connection.QueueMessage(message.channel, std::move(message.data)))
+                    NETWORK_LOG(WARNING, "Failed to queue Game Data message");
+            }
+            SendPendingPackets();
+
+            // Messages are stamped on arrival so the jitter buffer doesn't see the game thread's frame rate
+            const double receivedAt = GetLocalMilliseconds();
+            while (m_connection.ReceiveMessage(message.channel, message.data, &message.arrival))
+            {
+                message.receivedAt = receivedAt;
+                if (!m_incoming.TryPush(std::move(message)))
+                    NETWORK_LOG(WARNING, "Receive ring full, Game Data dropped");
+            }
+        }
+        catch (std::exception& e)
+        {
+            NETWORK_LOG(FAILURE, "{}", e.what());
+        }
     }
+}
 
-    void Internal_ClientDestroy(Client* p_obj)
+void Client::SendPendingPackets()
+{
+    NETWORK_TRACE_ZONE("Client::SendPendingPackets");
+    Buffer probe;
+    if (m_connection.WriteMtuProbe(probe, m_sharedKey) && !m_socket.Send(m_serverAddress, probe.data, probe.size))
+        m_connection.OnMtuProbeFailed();
+
+    while (true)
     {
-        if (p_obj != NULL)
-            delete p_obj;
+        Buffer packet;
+        if (!m_connection.WriteNextPacket(packet, m_sharedKey))
+            return;
+        if (!m_socket.Send(m_serverAddress, packet.data, packet.size))
+            NETWORK_LOG(WARNING, "Failed to send ConnectionData packet");
     }
+}
 
-    void Internal_ClientConnect(Client* p_obj)
+bool Client::SendGameData(const unsigned char* p_data, unsigned int p_size, const uint8_t p_channel)
+{
+    if(m_state.load() == ClientState::CONNECTED)
     {
-        if (p_obj == NULL)
+        if (m_runNetworkThread.load())
         {
-            g_debugCallback("Invalid instance pointer!");
-            return;
+            if (!m_outgoing.TryPush({ std::make_shared<const std::vector<uint8_t>>(p_data, p_data + p_size), p_channel }))
+            {
+                NETWORK_LOG(WARNING, "Send ring full, Game Data dropped");
+                return false;
+            }
+            return true;
+        }
+        if (!m_connection.QueueMessage(p_channel, std::make_shared<const std::vector<uint8_t>>(p_data, p_data + p_size)))
+        {
+            NETWORK_LOG(WARNING, "Failed to queue Game Data message");
+            return false;
         }
+        return true;
+    }
+    return false;
+}
 
-        return p_obj->Connect();
+void Client::SetInputChannel(const uint8_t p_channel, const uint8_t p_redundancy)
+{
+    if (p_channel >= Connection::MAX_CHANNELS)
+    {
+        g_debugCallback("Channel index out of range");
+        return;
     }
-    void Internal_ClientDisconnect(Client* p_obj)
+    if (IsConfigurationLocked("the input channel"))
+        return;
+    m_inputChannel = p_channel;
+    m_inputs.Reset();
+    m_inputs.SetRedundancy(p_redundancy);
+}
+
+bool Client::SendInput(const uint32_t p_tick, const unsigned char* p_data, const unsigned int p_size)
+{
+    if (m_state.load() != ClientState::CONNECTED || m_inputChannel >= Connection::MAX_CHANNELS)
+        return false;
+
+    MessageData input = std::make_shared<const std::vector<uint8_t>>(p_data, p_data + p_size);
+    if (m_runNetworkThread.load())
     {
-        if (p_obj == NULL)
+        QueuedMessage message { std::move(input), m_inputChannel };
+        message.isInput = true;
+        message.tick = p_tick;
+        if (!m_outgoing.TryPush(std::move(message)))
         {
-            g_debugCallback("Invalid instance pointer!");
-            return;
+            NETWORK_LOG(WARNING, "Send ring full, Input dropped");
+            return false;
         }
+        return true;
+    }
+    return QueueInput(p_tick, std::move(input));
+}
 
-        return p_obj->SendDisconnect();
+bool Client::QueueInput(const uint32_t p_tick, MessageData p_input)
+{
+    uint16_t ackedMessage;
+    const bool hasAck = m_connection.GetLastAckedMessage(m_inputChannel, ackedMessage);
+    const MessageData message = m_inputs.Encode(p_tick, std::move(p_input), hasAck, ackedMessage);
+    if (message == nullptr)
+    {
+        NETWORK_LOG(WARNING, "Input tick not newer than the previous one or Input too large");
+        return false;
     }
 
+    uint16_t messageId;
+    if (!m_connection.QueueMessage(m_inputChannel, message, &messageId))
+    {
+        NETWORK_LOG(WARNING, "Failed to queue Input message");
+        return false;
+    }
+    m_inputs.Store(messageId);
+    return true;
+}
 
-    int Internal_ClientListen(Client* p_obj, unsigned char* o_gameData, const unsigned int p_size)
+void Client::SetPredictionTolerance(const float p_tolerance)
+{
+    m_prediction.SetTolerance(p_tolerance);
+}
+
+bool Client::StorePrediction(const uint32_t p_tick, const unsigned char* p_input, const unsigned int p_inputSize, const unsigned char* p_state,
+                             const unsigned int p_stateSize)
+{
+    if (!m_prediction.Store(p_tick, p_input, p_inputSize, p_state, p_stateSize))
     {
-        if (p_obj == NULL)
-        {
-            g_debugCallback("Invalid instance pointer!");
-            return -1;
-        }
-        return p_obj->Listen(o_gameData, p_size);
+        NETWORK_LOG(WARNING, "Prediction tick not newer than the previous one");
+        return false;
     }
+    return true;
+}
 
-    bool Internal_ClientSendGameData(Client* p_obj, const unsigned char* p_data, unsigned int p_size)
+bool Client::UpdatePrediction(const uint32_t p_tick, const unsigned char* p_state, const unsigned int p_size)
+{
+    return m_prediction.UpdateState(p_tick, p_state, p_size);
+}
+
+int Client::Reconcile(const uint32_t p_tick, const unsigned char* p_state, const unsigned int p_size, uint32_t& o_firstTick)
+{
+    return m_prediction.Reconcile(p_tick, p_state, p_size, o_firstTick);
+}
+
+int Client::GetPredictedInput(const uint32_t p_tick, unsigned char* o_input, const unsigned int p_size) const
+{
+    const std::vector<uint8_t>* input = m_prediction.GetInput(p_tick);
+    if (input == nullptr || input->size() > p_size)
+        return -1;
+    memcpy(o_input, input->data(), input->size());
+    return static_cast<int>(input->size());
+}
+
+void Client::Flush()
+{
+    // The network thread flushes on its own
+    if (m_state.load() == ClientState::CONNECTED && !m_runNetworkThread.load())
+        SendPendingPackets();
+}
+
+void Client::SetSnapshotChannel(const uint8_t p_channel)
+{
+    if (p_channel >= Connection::MAX_CHANNELS)
     {
-        if (p_obj == NULL)
-        {
-            g_debugCallback("Invalid instance pointer!");
-            return false;
-        }
-        return p_obj->SendGameData(p_data, p_size);
+        g_debugCallback("Channel index out of range");
+        return;
     }
+    m_snapshotChannel = p_channel;
+    m_snapshots.Reset();
+    m_jitterBuffer.Reset();
+}
 
-    void Internal_ClientSetActiveTimeout(Client* p_obj, bool p_value)
+void Client::SetJitterBuffer(const bool p_enabled)
+{
+    m_useJitterBuffer = p_enabled;
+    m_jitterBuffer.Reset();
+}
+
+void Client::RegisterInterpolationCallback(InterpolationCallback p_callback)
+{
+    m_interpolationCallback = p_callback;
+}
+
+bool Client::Interpolate()
+{
+    JitterBuffer::Sample sample;
+    if (m_interpolationCallback == nullptr || !m_jitterBuffer.GetSample(GetLocalMilliseconds(), sample))
+        return false;
+
+    m_interpolationCallback(sample.from->data(), static_cast<unsigned int>(sample.from->size()),
+                            sample.to->data(), static_cast<unsigned int>(sample.to->size()), sample.alpha);
+    return true;
+}
+
+double Client::GetBufferingDelay() const
+{
+    return m_jitterBuffer.GetBufferingDelay();
+}
+
+double Client::GetLocalMilliseconds()
+{
+    return std::chrono::duration<double, std::milli>(clock::now().time_since_epoch()).count();
+}
+
+void Client::SetReplicationChannels(const uint8_t p_reliableChannel, const uint8_t p_unreliableChannel)
+{
+    if (p_reliableChannel >= Connection::MAX_CHANNELS || p_unreliableChannel >= Connection::MAX_CHANNELS)
     {
-        if (p_obj == NULL)
-        {
-            g_debugCallback("Invalid instance pointer!");
-            return;
-        }
-        return p_obj->SetActiveTimeout(p_value);
+        g_debugCallback("Channel index out of range");
+        return;
+    }
+    m_replicationChannels[0] = p_reliableChannel;
+    m_replicationChannels[1] = p_unreliableChannel;
+    m_replication.Reset();
+}
+
+bool Client::PollEntityEvent(ReplicationClient::Event& o_event)
+{
+    return m_replication.PollEvent(o_event);
+}
+
+bool Client::GetEntityField(const uint32_t p_entityId, const uint8_t p_field, void* o_value) const
+{
+    return m_replication.GetField(p_entityId, p_field, o_value);
+}
+
+void Client::SetCompression(const bool p_enabled, const uint8_t* p_dictionary, const unsigned int p_dictionarySize)
+{
+    if (IsConfigurationLocked("compression"))
+        return;
+    m_connection.SetCompressor(p_enabled ? std::make_shared<const LZCompressor>(p_dictionary, p_dictionarySize) : nullptr);
+}
+
+void Client::ConfigureChannel(const uint8_t p_channel, const ChannelMode p_mode)
+{
+    if (IsConfigurationLocked("channel modes"))
+        return;
+    m_connection.ConfigureChannel(p_channel, p_mode);
+}
+
+void Client::SetChannelParity(const uint8_t p_channel, const uint8_t p_groupSize)
+{
+    if (IsConfigurationLocked("channel parity"))
+        return;
+    m_connection.SetParityGroupSize(p_channel, p_groupSize);
+}
+
+void Client::SetActiveTimeout(bool p_value)
+{
+    m_activeTimeout = p_value;
+}
+
+void Client::RegisterPacketAckedCallback(PacketAckedCallback p_callback)
+{
+    if (IsConfigurationLocked("the packet acked callback"))
+        return;
+    m_connection.SetPacketAckedCallback(p_callback);
+}
+
+uint16_t Client::GetLastSentSequence() const
+{
+    return GetPublishedState().lastSentSequence;
+}
+
+double Client::GetRoundTripTime() const
+{
+    return GetPublishedState().stats.roundTripTime;
+}
+
+double Client::GetRoundTripTimeVariance() const
+{
+    return GetPublishedState().stats.roundTripTimeVariance;
+}
+
+double Client::GetServerTime() const
+{
+    // The estimate is advanced by the time elapsed since the network thread published it
+    const PublishedState state = GetPublishedState();
+    if (state.serverTime < 0.0)
+        return -1.0;
+    return state.serverTime + std::chrono::duration<double>(clock::now() - state.publishedAt).count();
+}
+
+void Client::GetConnectionStats(ConnectionStats& o_stats)
+{
+    o_stats = GetPublishedState().stats;
+}
+
+bool Client::GetLatencySummary(const LatencyMetric p_metric, LatencySummary& o_summary) const
+{
+    if (p_metric >= LatencyMetric::COUNT)
+        return false;
+    m_latencies[static_cast<size_t>(p_metric)].GetSummary(o_summary);
+    return true;
+}
+
+double Client::GetLatencyPercentile(const LatencyMetric p_metric, const double p_percentile) const
+{
+    if (p_metric >= LatencyMetric::COUNT)
+        return -1.0;
+    return m_latencies[static_cast<size_t>(p_metric)].GetPercentile(p_percentile);
+}
+
+void Client::ResetLatencies()
+{
+    for (auto& histogram : m_latencies)
+        histogram.Reset();
+}
+
+bool Client::StartCapture(const char* p_path)
+{
+    return m_socket.StartCapture(p_path);
+}
+
+void Client::StopCapture()
+{
+    m_socket.StopCapture();
+}
+
+bool Client::StartReplay(const char* p_path, const bool p_realTime)
+{
+    if (m_runNetworkThread.load())
+    {
+        g_debugCallback("Stop the network thread before starting a replay");
+        return false;
+    }
+    return m_socket.StartReplay(p_path, p_realTime);
+}
+
+void Client::StopReplay()
+{
+    if (m_runNetworkThread.load())
+    {
+        g_debugCallback("Stop the network thread before stopping a replay");
+        return;
+    }
+    m_socket.StopReplay();
+}
+
+bool Client::IsReplayFinished() const
+{
+    return m_socket.IsReplayFinished();
+}
+
+void Client::SetNetworkConditions(const NetworkConditions& p_conditions)
+{
+    m_socket.SetNetworkConditions(p_conditions);
+}
+
+int Client::GetIndex() const
+{
+    return m_index;
+}
+
+char Client::GetState() const
+{
+    return static_cast<char>(m_state.load());
+}
+
+
+#pragma region CExport
+extern "C"
+{
+    Client* Internal_ClientCreate()
+    {
+        return new Client;
+    }
+
+    void Internal_ClientDestroy(Client* p_obj)
+    {
+        if (p_obj != NULL)
+            delete p_obj;
+    }
+
+    void Internal_ClientConnect(Client* p_obj)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return;
+        }
+
+        return p_obj->Connect();
+    }
+    void Internal_ClientDisconnect(Client* p_obj)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return;
+        }
+
+        return p_obj->SendDisconnect();
+    }
+
+    void Internal_ClientStartNetworkThread(Client* p_obj)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return;
+        }
+        p_obj->StartNetworkThread();
+    }
+
+    void Internal_ClientStopNetworkThread(Client* p_obj)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return;
+        }
+        p_obj->StopNetworkThread();
+    }
+
+
+    int Internal_ClientListen(Client* p_obj, unsigned char* o_gameData, const unsigned int p_size)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return -1;
+        }
+        return p_obj->Listen(o_gameData, p_size);
+    }
+
+    int Internal_ClientListenWithChannel(Client* p_obj, unsigned char* o_gameData, const unsigned int p_size, unsigned char* o_channel)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return -1;
+        }
+        return p_obj->Listen(o_gameData, p_size, o_channel);
+    }
+
+    bool Internal_ClientSendGameData(Client* p_obj, const unsigned char* p_data, unsigned int p_size)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return false;
+        }
+        return p_obj->SendGameData(p_data, p_size);
+    }
+
+    bool Internal_ClientSendGameDataOnChannel(Client* p_obj, const unsigned char* p_data, unsigned int p_size, unsigned char p_channel)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return false;
+        }
+        return p_obj->SendGameData(p_data, p_size, p_channel);
+    }
+
+    void Internal_ClientFlush(Client* p_obj)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return;
+        }
+        p_obj->Flush();
+    }
+
+    void Internal_ClientSetSnapshotChannel(Client* p_obj, unsigned char p_channel)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return;
+        }
+        p_obj->SetSnapshotChannel(p_channel);
+    }
+
+    void Internal_ClientSetJitterBuffer(Client* p_obj, bool p_enabled)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return;
+        }
+        p_obj->SetJitterBuffer(p_enabled);
+    }
+
+    void Internal_ClientRegisterInterpolationCallback(Client* p_obj, InterpolationCallback p_callback)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return;
+        }
+        p_obj->RegisterInterpolationCallback(p_callback);
+    }
+
+    bool Internal_ClientInterpolate(Client* p_obj)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return false;
+        }
+        return p_obj->Interpolate();
+    }
+
+    double Internal_ClientGetBufferingDelay(Client* p_obj)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return 0.0;
+        }
+        return p_obj->GetBufferingDelay();
+    }
+
+    void Internal_ClientSetInputChannel(Client* p_obj, unsigned char p_channel, unsigned char p_redundancy)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return;
+        }
+        p_obj->SetInputChannel(p_channel, p_redundancy);
+    }
+
+    bool Internal_ClientSendInput(Client* p_obj, unsigned int p_tick, const unsigned char* p_data, unsigned int p_size)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return false;
+        }
+        return p_obj->SendInput(p_tick, p_data, p_size);
+    }
+
+    void Internal_ClientSetPredictionTolerance(Client* p_obj, float p_tolerance)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return;
+        }
+        p_obj->SetPredictionTolerance(p_tolerance);
+    }
+
+    bool Internal_ClientStorePrediction(Client* p_obj, unsigned int p_tick, const unsigned char* p_input, unsigned int p_inputSize, const unsigned char* p_state, unsigned int p_stateSize)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return false;
+        }
+        return p_obj->StorePrediction(p_tick, p_input, p_inputSize, p_state, p_stateSize);
+    }
+
+    bool Internal_ClientUpdatePrediction(Client* p_obj, unsigned int p_tick, const unsigned char* p_state, unsigned int p_size)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return false;
+        }
+        return p_obj->UpdatePrediction(p_tick, p_state, p_size);
+    }
+
+    int Internal_ClientReconcile(Client* p_obj, unsigned int p_tick, const unsigned char* p_state, unsigned int p_size, unsigned int* o_firstTick)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return -1;
+        }
+        uint32_t firstTick = 0;
+        const int count = p_obj->Reconcile(p_tick, p_state, p_size, firstTick);
+        if (o_firstTick != NULL)
+            *o_firstTick = firstTick;
+        return count;
+    }
+
+    int Internal_ClientGetPredictedInput(Client* p_obj, unsigned int p_tick, unsigned char* o_input, unsigned int p_size)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return -1;
+        }
+        return p_obj->GetPredictedInput(p_tick, o_input, p_size);
+    }
+
+    void Internal_ClientSetReplicationChannels(Client* p_obj, unsigned char p_reliableChannel, unsigned char p_unreliableChannel)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return;
+        }
+        p_obj->SetReplicationChannels(p_reliableChannel, p_unreliableChannel);
+    }
+
+    bool Internal_ClientPollEntityEvent(Client* p_obj, unsigned char* o_event, unsigned int* o_entityId, unsigned short* o_entityType, unsigned int* o_fieldMask)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return false;
+        }
+
+        ReplicationClient::Event event;
+        if (!p_obj->PollEntityEvent(event))
+            return false;
+        *o_event = static_cast<unsigned char>(event.type);
+        *o_entityId = event.entityId;
+        *o_entityType = event.entityType;
+        *o_fieldMask = event.fieldMask;
+        return true;
+    }
+
+    bool Internal_ClientGetEntityField(Client* p_obj, unsigned int p_entityId, unsigned char p_field, void* o_value)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return false;
+        }
+        return p_obj->GetEntityField(p_entityId, p_field, o_value);
+    }
+
+    void Internal_ClientSetCompression(Client* p_obj, bool p_enabled, const unsigned char* p_dictionary, unsigned int p_dictionarySize)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return;
+        }
+        p_obj->SetCompression(p_enabled, p_dictionary, p_dictionary != NULL ? p_dictionarySize : 0);
+    }
+
+    void Internal_ClientConfigureChannel(Client* p_obj, unsigned char p_channel, unsigned char p_mode)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return;
+        }
+        return p_obj->ConfigureChannel(p_channel, static_cast<ChannelMode>(p_mode));
+    }
+
+    void Internal_ClientSetChannelParity(Client* p_obj, unsigned char p_channel, unsigned char p_groupSize)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return;
+        }
+        p_obj->SetChannelParity(p_channel, p_groupSize);
+    }
+
+    void Internal_ClientSetActiveTimeout(Client* p_obj, bool p_value)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return;
+        }
+        return p_obj->SetActiveTimeout(p_value);
+    }
+
+    void Internal_ClientRegisterPacketAckedCallback(Client* p_obj, PacketAckedCallback p_callback)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return;
+        }
+        return p_obj->RegisterPacketAckedCallback(p_callback);
+    }
+
+    int Internal_ClientGetLastSentSequence(Client* p_obj)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return -1;
+        }
+        return p_obj->GetLastSentSequence();
+    }
+
+    double Internal_ClientGetRoundTripTime(Client* p_obj)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return -1.0;
+        }
+        return p_obj->GetRoundTripTime();
+    }
+
+    double Internal_ClientGetRoundTripTimeVariance(Client* p_obj)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return -1.0;
+        }
+        return p_obj->GetRoundTripTimeVariance();
+    }
+
+    double Internal_ClientGetServerTime(Client* p_obj)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return -1.0;
+        }
+        return p_obj->GetServerTime();
+    }
+
+    void Internal_ClientGetConnectionStats(Client* p_obj, ConnectionStats* o_stats)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return;
+        }
+        if (o_stats != NULL)
+            p_obj->GetConnectionStats(*o_stats);
+    }
+
+    bool Internal_ClientGetLatencySummary(Client* p_obj, unsigned char p_metric, LatencySummary* o_summary)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return false;
+        }
+        if (o_summary == NULL)
+            return false;
+        return p_obj->GetLatencySummary(static_cast<LatencyMetric>(p_metric), *o_summary);
+    }
+
+    double Internal_ClientGetLatencyPercentile(Client* p_obj, unsigned char p_metric, double p_percentile)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return -1.0;
+        }
+        return p_obj->GetLatencyPercentile(static_cast<LatencyMetric>(p_metric), p_percentile);
+    }
+
+    void Internal_ClientResetLatencies(Client* p_obj)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return;
+        }
+        p_obj->ResetLatencies();
+    }
+
+    bool Internal_ClientStartCapture(Client* p_obj, const char* p_path)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return false;
+        }
+        return p_obj->StartCapture(p_path);
+    }
+
+    void Internal_ClientStopCapture(Client* p_obj)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return;
+        }
+        p_obj->StopCapture();
+    }
+
+    bool Internal_ClientStartReplay(Client* p_obj, const char* p_path, const bool p_realTime)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return false;
+        }
+        return p_obj->StartReplay(p_path, p_realTime);
+    }
+
+    void Internal_ClientStopReplay(Client* p_obj)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return;
+        }
+        p_obj->StopReplay();
+    }
+
+    bool Internal_ClientIsReplayFinished(Client* p_obj)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return true;
+        }
+        return p_obj->IsReplayFinished();
+    }
+
+    void Internal_ClientSetNetworkConditions(Client* p_obj, const NetworkConditions* p_conditions)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return;
+        }
+        p_obj->SetNetworkConditions(p_conditions != nullptr ? *p_conditions : NetworkConditions{});
     }
 
     int Internal_ClientGetIndex(Client* p_obj)
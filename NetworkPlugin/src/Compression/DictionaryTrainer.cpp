@@ -0,0 +1,100 @@
+#include "stdafx.h"
+#include "Network/Compression/DictionaryTrainer.h"
+#include <queue>
+#include <unordered_set>
+
+uint64_t DictionaryTrainer::ReadGram(const uint8_t* p_data)
+{
+    uint64_t gram;
+    memcpy(&gram, p_data, sizeof gram);
+    return gram;
+}
+
+uint64_t DictionaryTrainer::ScoreSegment(const uint8_t* p_segment, const unsigned int p_size, const std::unordered_map<uint64_t, uint32_t>& p_frequencies)
+{
+    // A k-gram repeated inside the segment only counts once
+    std::unordered_set<uint64_t> grams;
+    uint64_t score = 0;
+    for (unsigned int i = 0; i + GRAM_SIZE <= p_size; ++i)
+    {
+        const uint64_t gram = ReadGram(p_segment + i);
+        if (!grams.insert(gram).second)
+            continue;
+        const auto frequency = p_frequencies.find(gram);
+        if (frequency != p_frequencies.end())
+            score += frequency->second;
+    }
+    return score;
+}
+
+unsigned int DictionaryTrainer::Train(const uint8_t* p_samples, const unsigned int* p_sampleSizes, const unsigned int p_sampleCount,
+                                      uint8_t* o_dictionary, const unsigned int p_capacity)
+{
+    static_assert(GRAM_SIZE == sizeof(uint64_t), "K-grams are read as 64 bits integers");
+
+    std::unordered_map<uint64_t, uint32_t> frequencies;
+    std::vector<std::pair<const uint8_t*, unsigned int>> segments;
+    const uint8_t* sample = p_samples;
+    for (unsigned int s = 0; s < p_sampleCount; sample += p_sampleSizes[s++])
+    {
+        for (unsigned int i = 0; i + GRAM_SIZE <= p_sampleSizes[s]; ++i)
+            ++frequencies[ReadGram(sample + i)];
+        // Segments overlap by half so a common pattern is not always cut in two
+        for (unsigned int i = 0; i + GRAM_SIZE <= p_sampleSizes[s]; i += SEGMENT_SIZE / 2)
+            segments.emplace_back(sample + i, std::min(SEGMENT_SIZE, p_sampleSizes[s] - i));
+    }
+
+    // Lazy greedy selection, a popped score is recomputed since the segments picked before may have covered its k-grams
+    using Candidate = std::pair<uint64_t, size_t>;
+    std::priority_queue<Candidate> candidates;
+    for (size_t i = 0; i < segments.size(); ++i)
+        candidates.emplace(ScoreSegment(segments[i].first, segments[i].second, frequencies), i);
+
+    std::vector<size_t> picked;
+    unsigned int size = 0;
+    while (!candidates.empty() && size < p_capacity)
+    {
+        const Candidate candidate = candidates.top();
+        candidates.pop();
+        const auto& segment = segments[candidate.second];
+        const uint64_t score = ScoreSegment(segment.first, segment.second, frequencies);
+        if (score == 0)
+            continue;
+        if (!candidates.empty() && score < candidates.top().first)
+        {
+            candidates.emplace(score, candidate.second);
+            continue;
+        }
+
+        picked.push_back(candidate.second);
+        size += std::min(segment.second, p_capacity - size);
+        for (unsigned int i = 0; i + GRAM_SIZE <= segment.second; ++i)
+            frequencies.erase(ReadGram(segment.first + i));
+    }
+
+    unsigned int index = size;
+    for (const size_t segmentIndex : picked)
+    {
+        const auto& segment = segments[segmentIndex];
+        const unsigned int length = std::min(segment.second, index);
+        index -= length;
+        memcpy(o_dictionary + index, segment.first, length);
+    }
+    return size;
+}
+
+#pragma region CExport
+extern "C"
+{
+    unsigned int Internal_TrainCompressionDictionary(const unsigned char* p_samples, const unsigned int* p_sampleSizes, unsigned int p_sampleCount,
+                                                     unsigned char* o_dictionary, unsigned int p_capacity)
+    {
+        if (p_samples == NULL || p_sampleSizes == NULL || o_dictionary == NULL)
+        {
+            g_debugCallback("Invalid dictionary training parameters");
+            return 0;
+        }
+        return DictionaryTrainer::Train(p_samples, p_sampleSizes, p_sampleCount, o_dictionary, p_capacity);
+    }
+}
+#pragma endregion
@@ -0,0 +1,190 @@
+#include "stdafx.h"
+#include "Network/Compression/LZCompressor.h"
+
+bool LZCompressor::WriteLength(uint8_t*& p_output, const uint8_t* p_end, uint32_t p_length)
+{
+    for (; p_length >= 255; p_length -= 255)
+    {
+        if (p_output == p_end)
+            return false;
+        *p_output++ = 255;
+    }
+    if (p_output == p_end)
+        return false;
+    *p_output++ = static_cast<uint8_t>(p_length);
+    return true;
+}
+
+bool LZCompressor::ReadLength(const uint8_t*& p_input, const uint8_t* p_end, uint32_t& o_length)
+{
+    uint8_t byte;
+    do
+    {
+        if (p_input == p_end)
+            return false;
+        byte = *p_input++;
+        o_length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+bool LZCompressor::WriteSequence(uint8_t*& p_output, const uint8_t* p_end, const uint8_t* p_literals, const uint32_t p_literalLength,
+                                 const uint32_t p_offset, const uint32_t p_matchLength)
+{
+    if (p_output == p_end)
+        return false;
+    const uint32_t matchCode = p_matchLength > 0 ? p_matchLength - MIN_MATCH : 0;
+    *p_output++ = static_cast<uint8_t>((std::min(p_literalLength, 15u) << 4) | std::min(matchCode, 15u));
+    if (p_literalLength >= 15 && !WriteLength(p_output, p_end, p_literalLength - 15))
+        return false;
+
+    if (static_cast<uint32_t>(p_end - p_output) < p_literalLength)
+        return false;
+    memcpy(p_output, p_literals, p_literalLength);
+    p_output += p_literalLength;
+
+    if (p_matchLength == 0)
+        return true;
+    if (p_end - p_output < 2)
+        return false;
+    *p_output++ = static_cast<uint8_t>(p_offset);
+    *p_output++ = static_cast<uint8_t>(p_offset >> 8);
+    return matchCode < 15 || WriteLength(p_output, p_end, matchCode - 15);
+}
+
+LZCompressor::LZCompressor(const uint8_t* p_dictionary, const unsigned int p_size)
+{
+    SetDictionary(p_dictionary, p_size);
+}
+
+LZCompressor::SourceTable& LZCompressor::GetSourceTable()
+{
+    // One per thread, connections compressing on several threads share the compressor
+    thread_local SourceTable table;
+    return table;
+}
+
+uint32_t LZCompressor::Hash(const uint8_t* p_data)
+{
+    uint32_t value;
+    memcpy(&value, p_data, sizeof value);
+    return (value * 2654435761u) >> (32 - HASH_LOG);
+}
+
+void LZCompressor::SetDictionary(const uint8_t* p_dictionary, unsigned int p_size)
+{
+    if (p_size > MAX_DICTIONARY_SIZE)
+    {
+        p_dictionary += p_size - MAX_DICTIONARY_SIZE;
+        p_size = MAX_DICTIONARY_SIZE;
+    }
+    m_dictionary.assign(p_dictionary, p_dictionary + p_size);
+
+    std::fill(m_dictionaryTable.begin(), m_dictionaryTable.end(), 0);
+    for (uint32_t i = 0; i + MIN_MATCH <= p_size; ++i)
+        m_dictionaryTable[Hash(m_dictionary.data() + i)] = i + 1;
+}
+
+uint32_t LZCompressor::Compress(const uint8_t* p_source, const uint32_t p_size, uint8_t* o_destination, const uint32_t p_capacity) const
+{
+    // Positions are counted from the start of the dictionary, as if the source followed it
+    const uint32_t dictionarySize = static_cast<uint32_t>(m_dictionary.size());
+    SourceTable& table = GetSourceTable();
+    if (++table.stamp == 0)
+    {
+        table.entries.fill({});
+        table.stamp = 1;
+    }
+
+    uint8_t* output = o_destination;
+    const uint8_t* end = o_destination + p_capacity;
+    uint32_t anchor = 0;
+    uint32_t index = 0;
+    while (index + MIN_MATCH <= p_size)
+    {
+        const uint32_t hash = Hash(p_source + index);
+        SourceTable::Entry& entry = table.entries[hash];
+        const uint32_t candidate = entry.stamp == table.stamp ? entry.position : m_dictionaryTable[hash];
+        entry = { table.stamp, dictionarySize + index + 1 };
+
+        const uint32_t position = dictionarySize + index;
+        if (candidate == 0 || position - (candidate - 1) > MAX_OFFSET)
+        {
+            ++index;
+            continue;
+        }
+
+        // Matches starting in the dictionary stop at its end
+        const uint32_t candidatePosition = candidate - 1;
+        const uint8_t* match;
+        uint32_t limit = p_size - index;
+        if (candidatePosition < dictionarySize)
+        {
+            match = m_dictionary.data() + candidatePosition;
+            limit = std::min(limit, dictionarySize - candidatePosition);
+        }
+        else
+            match = p_source + (candidatePosition - dictionarySize);
+
+        uint32_t length = 0;
+        while (length < limit && match[length] == p_source[index + length])
+            ++length;
+        if (length < MIN_MATCH)
+        {
+            ++index;
+            continue;
+        }
+
+        if (!WriteSequence(output, end, p_source + anchor, index - anchor, position - candidatePosition, length))
+            return 0;
+        index += length;
+        anchor = index;
+    }
+
+    if (!WriteSequence(output, end, p_source + anchor, p_size - anchor, 0, 0))
+        return 0;
+    return static_cast<uint32_t>(output - o_destination);
+}
+
+bool LZCompressor::Decompress(const uint8_t* p_source, const uint32_t p_size, uint8_t* o_destination, const uint32_t p_decompressedSize) const
+{
+    const uint32_t dictionarySize = static_cast<uint32_t>(m_dictionary.size());
+    const uint8_t* input = p_source;
+    const uint8_t* inputEnd = p_source + p_size;
+    uint32_t written = 0;
+    while (input != inputEnd)
+    {
+        const uint8_t token = *input++;
+        uint32_t literalLength = token >> 4;
+        if (literalLength == 15 && !ReadLength(input, inputEnd, literalLength))
+            return false;
+        if (literalLength > static_cast<uint32_t>(inputEnd - input) || literalLength > p_decompressedSize - written)
+            return false;
+        memcpy(o_destination + written, input, literalLength);
+        input += literalLength;
+        written += literalLength;
+
+        if (input == inputEnd)
+            break;
+
+        if (inputEnd - input < 2)
+            return false;
+        const uint32_t offset = input[0] | (input[1] << 8);
+        input += 2;
+        uint32_t matchLength = token & 0x0F;
+        if (matchLength == 15 && !ReadLength(input, inputEnd, matchLength))
+            return false;
+        matchLength += MIN_MATCH;
+
+        if (offset == 0 || offset > written + dictionarySize || matchLength > p_decompressedSize - written)
+            return false;
+
+        // Byte by byte since a match can overlap the bytes it produces
+        for (uint32_t i = 0; i < matchLength; ++i, ++written)
+        {
+            const uint32_t source = written + dictionarySize - offset;
+            o_destination[written] = source < dictionarySize ? m_dictionary[source] : o_destination[source - dictionarySize];
+        }
+    }
+    return written == p_decompressedSize;
+}
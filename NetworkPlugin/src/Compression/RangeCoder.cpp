@@ -0,0 +1,157 @@
+#include "stdafx.h"
+#include "Network/Compression/RangeCoder.h"
+
+RangeEncoder::RangeEncoder(Buffer& p_buffer) :
+    m_buffer{p_buffer}
+{
+}
+
+void RangeEncoder::ShiftLow()
+{
+    // Bytes of 0xFF are held back until we know whether a carry propagates through them
+    if (static_cast<uint32_t>(m_low) < 0xFF000000u || (m_low >> 32) != 0)
+    {
+        const uint8_t carry = static_cast<uint8_t>(m_low >> 32);
+        uint8_t byte = m_cache;
+        do
+        {
+            if (!m_firstByte)
+                m_buffer.WriteByte(static_cast<uint8_t>(byte + carry));
+            m_firstByte = false;
+            byte = 0xFF;
+        } while (--m_cacheSize != 0);
+        m_cache = static_cast<uint8_t>(m_low >> 24);
+    }
+    ++m_cacheSize;
+    m_low = (m_low & 0x00FFFFFF) << 8;
+}
+
+void RangeEncoder::EncodeBit(BitModel& p_model, const uint32_t p_bit)
+{
+    const uint32_t bound = (m_range >> BitModel::PROBABILITY_BITS) * p_model.probability;
+    if (p_bit == 0)
+    {
+        m_range = bound;
+        p_model.probability += (BitModel::PROBABILITY_ONE - p_model.probability) >> BitModel::MOVE_BITS;
+    }
+    else
+    {
+        m_low += bound;
+        m_range -= bound;
+        p_model.probability -= p_model.probability >> BitModel::MOVE_BITS;
+    }
+    while (m_range < TOP)
+    {
+        m_range <<= 8;
+        ShiftLow();
+    }
+}
+
+void RangeEncoder::EncodeDirectBits(const uint32_t p_value, unsigned int p_count)
+{
+    while (p_count-- > 0)
+    {
+        m_range >>= 1;
+        if ((p_value >> p_count) & 1)
+            m_low += m_range;
+        while (m_range < TOP)
+        {
+            m_range <<= 8;
+            ShiftLow();
+        }
+    }
+}
+
+void RangeEncoder::Flush()
+{
+    for (int i = 0; i < 5; ++i)
+        ShiftLow();
+}
+
+RangeDecoder::RangeDecoder(Buffer& p_buffer) :
+    m_buffer{p_buffer}
+{
+    for (int i = 0; i < 4; ++i)
+        m_code = (m_code << 8) | NextByte();
+}
+
+uint8_t RangeDecoder::NextByte()
+{
+    if (m_buffer.index >= m_buffer.size)
+        return 0;
+    return m_buffer.ReadByte();
+}
+
+uint32_t RangeDecoder::DecodeBit(BitModel& p_model)
+{
+    const uint32_t bound = (m_range >> BitModel::PROBABILITY_BITS) * p_model.probability;
+    uint32_t bit;
+    if (m_code < bound)
+    {
+        m_range = bound;
+        p_model.probability += (BitModel::PROBABILITY_ONE - p_model.probability) >> BitModel::MOVE_BITS;
+        bit = 0;
+    }
+    else
+    {
+        m_code -= bound;
+        m_range -= bound;
+        p_model.probability -= p_model.probability >> BitModel::MOVE_BITS;
+        bit = 1;
+    }
+    while (m_range < TOP)
+    {
+        m_range <<= 8;
+        m_code = (m_code << 8) | NextByte();
+    }
+    return bit;
+}
+
+uint32_t RangeDecoder::DecodeDirectBits(unsigned int p_count)
+{
+    uint32_t value = 0;
+    while (p_count-- > 0)
+    {
+        m_range >>= 1;
+        uint32_t bit = 0;
+        if (m_code >= m_range)
+        {
+            m_code -= m_range;
+            bit = 1;
+        }
+        value = (value << 1) | bit;
+        while (m_range < TOP)
+        {
+            m_range <<= 8;
+            m_code = (m_code << 8) | NextByte();
+        }
+    }
+    return value;
+}
+
+void IntegerModel::Encode(RangeEncoder& p_encoder, const int32_t p_value)
+{
+    p_encoder.EncodeBit(m_zero, p_value == 0 ? 0 : 1);
+    if (p_value == 0)
+        return;
+
+    p_encoder.EncodeBit(m_sign, p_value < 0 ? 1 : 0);
+    const uint32_t magnitude = p_value < 0 ? 0u - static_cast<uint32_t>(p_value) : static_cast<uint32_t>(p_value);
+    unsigned int length = 1;
+    while (length < 32 && (magnitude >> length) != 0)
+        ++length;
+
+    m_length.Encode(p_encoder, length - 1);
+    p_encoder.EncodeDirectBits(magnitude, length - 1); // The leading one is implied by the length
+}
+
+int32_t IntegerModel::Decode(RangeDecoder& p_decoder)
+{
+    if (p_decoder.DecodeBit(m_zero) == 0)
+        return 0;
+
+    const bool negative = p_decoder.DecodeBit(m_sign) != 0;
+    const unsigned int length = m_length.Decode(p_decoder) + 1;
+    const uint32_t magnitude = (1u << (length - 1)) | p_decoder.DecodeDirectBits(length - 1);
+    return static_cast<int32_t>(negative ? 0u - magnitude : magnitude);
+}
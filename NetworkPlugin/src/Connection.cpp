@@ -0,0 +1,558 @@
+#include "stdafx.h"
+#include "Network/Connection.h"
+#include "Network/Tracing/Tracer.h"
+
+Connection::Connection()
+{
+    for (uint8_t i = 0; i < MAX_CHANNELS; ++i)
+    {
+        m_channels[i].SetIndex(i);
+        m_channels[i].SetMode(DEFAULT_CHANNEL_MODES[i]);
+    }
+}
+
+void Connection::Reset()
+{
+    m_sentPackets.Reset();
+    m_receivedPackets.Reset();
+    m_sequence = 0;
+    for (auto& channel : m_channels)
+        channel.Reset();
+    m_congestion.Reset();
+    m_hasRemoteAck = false;
+    m_timeSync.Reset();
+    m_mtu.Reset();
+    m_stats = {};
+    m_hasReceivedPacket = false;
+
+    m_reassembler.Reset();
+    m_fragmentPayload.reset();
+    m_fragmentCount = 0;
+    m_nextFragment = 0;
+}
+
+void Connection::SetId(const int p_id)
+{
+    m_id = p_id;
+}
+
+void Connection::SetPacketAckedCallback(PacketAckedCallback p_callback)
+{
+    m_packetAckedCallback = p_callback;
+}
+
+void Connection::SetCompressor(std::shared_ptr<const LZCompressor> p_compressor)
+{
+    m_compressor = std::move(p_compressor);
+}
+
+SequenceHeader Connection::GenerateSendHeader()
+{
+    SequenceHeader header;
+    header.sequence = m_sequence++;
+    m_sentPackets.Insert(header.sequence)->sendTime = clock::now();
+
+    header.ack = GetRemoteSequence();
+    for (unsigned int i = 0; i < Packet::PREVIOUS_ACK_COUNT; ++i)
+    {
+        if (m_receivedPackets.Exists(static_cast<uint16_t>(header.ack - 1 - i)))
+            header.ackBits |= 1u << i;
+    }
+    return header;
+}
+
+bool Connection::ProcessReceivedHeader(const SequenceHeader& p_header)
+{
+    if (m_receivedPackets.Exists(p_header.sequence))
+    {
+        ++m_stats.duplicatePackets;
+        return false;
+    }
+    if (m_hasReceivedPacket && !Packet::SequenceGreaterThan(p_header.sequence, GetRemoteSequence()))
+        ++m_stats.outOfOrderPackets;
+    if (m_receivedPackets.Insert(p_header.sequence) == nullptr)
+        return false;
+    m_hasReceivedPacket = true;
+
+    const clock::time_point now = clock::now();
+    OnPacketAcked(p_header.ack, now);
+    for (unsigned int i = 0; i < Packet::PREVIOUS_ACK_COUNT; ++i)
+    {
+        if (p_header.ackBits & (1u << i))
+            OnPacketAcked(static_cast<uint16_t>(p_header.ack - 1 - i), now);
+    }
+    DetectLostPackets(p_header.ack, now);
+    return true;
+}
+
+void Connection::OnPacketAcked(const uint16_t p_sequence, const clock::time_point p_now)
+{
+    SentPacketData* sentPacket = m_sentPackets.Find(p_sequence);
+    if (sentPacket == nullptr || sentPacket->acked)
+        return;
+
+    sentPacket->acked = true;
+    ++m_stats.ackedPackets;
+    m_stats.lossRate += (0.0 - m_stats.lossRate) * LOSS_RATE_SMOOTHING;
+    m_congestion.OnPacketAcked(sentPacket->size, p_now - sentPacket->sendTime, p_now);
+    for (const auto& message : sentPacket->messages)
+        m_channels[message.first].OnMessageAcked(message.second, p_sequence);
+
+    if (m_packetAckedCallback)
+        m_packetAckedCallback(m_id, p_sequence);
+}
+
+void Connection::DetectLostPackets(const uint16_t p_ack, const clock::time_point p_now)
+{
+    if (Packet::SequenceGreaterThan(p_ack, GetLastSentSequence()))
+        return;
+    // The last ack no longer matches a tracked packet, its window can't be checked
+    if (m_hasRemoteAck && m_sentPackets.Find(m_remoteAck) == nullptr)
+        m_hasRemoteAck = false;
+    if (m_hasRemoteAck && !Packet::SequenceGreaterThan(p_ack, m_remoteAck))
+        return;
+
+    // Packets the last ack window reported missing and that leave the window unacked will never be.
+    // Packets that left it before the peer acked anything later, when it sends less often than us, are not counted
+    if (m_hasRemoteAck)
+    {
+        const uint16_t oldestAckable = static_cast<uint16_t>(p_ack - Packet::PREVIOUS_ACK_COUNT);
+        const uint16_t lossEnd = Packet::SequenceGreaterThan(oldestAckable, m_remoteAck) ? m_remoteAck : oldestAckable;
+        for (uint16_t sequence = static_cast<uint16_t>(m_remoteAck - Packet::PREVIOUS_ACK_COUNT);
+             Packet::SequenceGreaterThan(lossEnd, sequence); ++sequence)
+        {
+            const SentPacketData* sentPacket = m_sentPackets.Find(sequence);
+            if (sentPacket != nullptr && !sentPacket->acked)
+            {
+                m_congestion.OnPacketLost(p_now);
+                ++m_stats.lostPackets;
+                m_stats.lossRate += (1.0 - m_stats.lossRate) * LOSS_RATE_SMOOTHING;
+            }
+        }
+    }
+    m_remoteAck = p_ack;
+    m_hasRemoteAck = true;
+}
+
+bool Connection::HasSendBudget()
+{
+    return m_congestion.HasBudget(clock::now());
+}
+
+void Connection::OnPacketSent(const uint16_t p_sequence, const uint32_t p_size)
+{
+    SentPacketData* sentPacket = m_sentPackets.Find(p_sequence);
+    if (sentPacket != nullptr)
+        sentPacket->size += p_size;
+    m_congestion.OnPacketSent(p_size);
+    ++m_stats.packetsSent;
+    m_stats.bytesSent += p_size;
+}
+
+uint16_t Connection::TakeMessageId(const uint8_t p_channel)
+{
+    return m_channels[p_channel].TakeMessageId();
+}
+
+void Connection::OnMessageSent(const uint16_t p_sequence, const uint8_t p_channel, const uint16_t p_id)
+{
+    SentPacketData* sentPacket = m_sentPackets.Find(p_sequence);
+    if (sentPacket != nullptr)
+        sentPacket->messages.emplace_back(p_channel, p_id);
+}
+
+float Connection::GetSendRate() const
+{
+    return m_congestion.GetSendRate();
+}
+
+void Connection::SetTimeOrigin(const clock::time_point p_origin)
+{
+    m_timeOrigin = p_origin;
+    m_timeSync.Reset();
+}
+
+uint64_t Connection::GetLocalTime() const
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - m_timeOrigin).count());
+}
+
+bool Connection::HasTimeSync() const
+{
+    return m_timeSync.HasSample();
+}
+
+double Connection::GetRoundTripTime() const
+{
+    return m_timeSync.GetSmoothedRtt() / 1000.0;
+}
+
+double Connection::GetRoundTripTimeVariance() const
+{
+    return m_timeSync.GetRttVariance() / 1000.0;
+}
+
+uint64_t Connection::GetRemoteTime() const
+{
+    return static_cast<uint64_t>(static_cast<int64_t>(GetLocalTime()) + m_timeSync.GetClockOffset());
+}
+
+bool Connection::WriteMtuProbe(Buffer& o_packet, const ShortSharedKey& p_sharedKey)
+{
+    const clock::time_point now = clock::now();
+    MtuProbePacket probe;
+    if (!m_congestion.HasBudget(now) || !m_mtu.GetNextProbe(now, m_congestion.GetSmoothedRtt(), probe.id, probe.size))
+        return false;
+
+    probe.Write(o_packet, p_sharedKey);
+    m_congestion.OnPacketSent(probe.size);
+    ++m_stats.packetsSent;
+    m_stats.bytesSent += probe.size;
+    return true;
+}
+
+void Connection::OnMtuProbeFailed()
+{
+    m_mtu.OnProbeFailed();
+}
+
+void Connection::OnMtuProbeAcked(const MtuProbeAckPacket& p_packet)
+{
+    m_mtu.OnProbeAcked(p_packet.id, p_packet.size);
+}
+
+unsigned int Connection::GetMaxPacketSize() const
+{
+    return m_mtu.GetMaxPacketSize();
+}
+
+void Connection::ConfigureChannel(const uint8_t p_channel, const ChannelMode p_mode)
+{
+    if (p_channel >= MAX_CHANNELS)
+    {
+        g_debugCallback("Channel index out of range");
+        return;
+    }
+    if (p_mode > ChannelMode::RELIABLE_ORDERED)
+    {
+        g_debugCallback("Invalid channel mode");
+        return;
+    }
+    m_channels[p_channel].SetMode(p_mode);
+}
+
+ChannelMode Connection::GetChannelMode(const uint8_t p_channel) const
+{
+    return m_channels[p_channel < MAX_CHANNELS ? p_channel : 0].GetMode();
+}
+
+void Connection::SetParityGroupSize(const uint8_t p_channel, const unsigned int p_groupSize)
+{
+    if (p_channel >= MAX_CHANNELS)
+    {
+        g_debugCallback("Channel index out of range");
+        return;
+    }
+    m_channels[p_channel].SetParityGroupSize(p_groupSize);
+}
+
+bool Connection::QueueMessage(const uint8_t p_channel, MessageData p_data, uint16_t* o_id)
+{
+    if (p_channel >= MAX_CHANNELS || p_data->size() > Packet::MAX_MESSAGE_SIZE)
+        return false;
+    return m_channels[p_channel].Send(std::move(p_data), o_id);
+}
+
+bool Connection::GetLastAckedMessage(const uint8_t p_channel, uint16_t& o_id) const
+{
+    return p_channel < MAX_CHANNELS && m_channels[p_channel].GetLastAckedMessage(o_id);
+}
+
+bool Connection::IsMessageAcked(const uint8_t p_channel, const uint16_t p_id) const
+{
+    return p_channel < MAX_CHANNELS && m_channels[p_channel].IsMessageAcked(p_id);
+}
+
+bool Connection::IsMessageDelivered(const uint8_t p_channel, const uint16_t p_id) const
+{
+    return p_channel < MAX_CHANNELS && m_channels[p_channel].IsMessageDelivered(p_id);
+}
+
+bool Connection::WriteNextPacket(Buffer& o_packet, const ShortSharedKey& p_sharedKey)
+{
+    NETWORK_TRACE_ZONE("Connection::WriteNextPacket");
+    if (!HasSendBudget())
+    {
+        // Stale unreliable data would only add queuing delay, reliable messages wait for budget
+        for (auto& channel : m_channels)
+            channel.TrimSendQueue();
+        return false;
+    }
+
+    if (m_nextFragment < m_fragmentCount)
+    {
+        WriteNextFragment(o_packet, p_sharedKey);
+        return true;
+    }
+
+    const unsigned int maxPacketSize = GetMaxPacketSize();
+    const uint32_t maxGameDataSize = maxPacketSize - Packet::CONNECTION_DATA_PACKET_SIZE - Hash::HMAC::SIZE;
+
+    const clock::time_point now = clock::now();
+    SequenceHeader header;
+    uint32_t gameDataSize = 0;
+    Message message;
+    for (auto& channel : m_channels)
+    {
+        // Small messages share the datagram, the header and the HMAC until the packet is full
+        while (true)
+        {
+            const bool isFirst = o_packet.data == nullptr;
+            if (!isFirst && gameDataSize + Packet::MESSAGE_HEADER_SIZE >= maxGameDataSize)
+                break;
+
+            const uint32_t maxSize = isFirst ? Packet::MAX_MESSAGE_SIZE : maxGameDataSize - gameDataSize - Packet::MESSAGE_HEADER_SIZE;
+            if (!channel.GetNextMessage(now, RESEND_TIME, maxSize, message))
+                break;
+
+            if (isFirst)
+                header = GenerateSendHeader();
+            // A parity carries the id of another message, it must not ack it
+            if (!message.parity)
+                m_sentPackets.Find(header.sequence)->messages.emplace_back(message.channel, message.id);
+
+            const uint32_t size = static_cast<uint32_t>(message.data->size());
+            const uint32_t messageSize = ConnectionDataPacket::GetMessageHeaderSize(size) + size;
+            if (isFirst && messageSize > maxGameDataSize)
+            {
+                StartFragments(header, message);
+                WriteNextFragment(o_packet, p_sharedKey);
+                return true;
+            }
+
+            if (isFirst)
+            {
+                o_packet.Init(maxPacketSize);
+                o_packet.index = Packet::CONNECTION_DATA_PACKET_SIZE;
+            }
+            const uint8_t channelField = message.parity ? message.channel | Packet::PARITY_CHANNEL_FLAG : message.channel;
+            ConnectionDataPacket::WriteMessageHeader(o_packet, channelField, message.id, size);
+            o_packet.WriteBuffer(message.data->data(), size);
+            gameDataSize += messageSize;
+
+            // Messages of a group share no packet, a lost packet costs at most one message of the group
+            if (channel.GetParityGroupSize() > 0)
+                break;
+        }
+    }
+
+    if (o_packet.data == nullptr)
+        return false;
+
+    // Timestamps ride along with game data when there is room left
+    const uint64_t localTime = GetLocalTime();
+    if (m_timeSync.ShouldSend(localTime) && gameDataSize + Packet::MESSAGE_HEADER_SIZE + TimeSync::MESSAGE_SIZE <= maxGameDataSize)
+    {
+        ConnectionDataPacket::WriteMessageHeader(o_packet, Packet::TIME_SYNC_CHANNEL, 0, TimeSync::MESSAGE_SIZE);
+        m_timeSync.Write(o_packet, localTime);
+        gameDataSize += Packet::MESSAGE_HEADER_SIZE + TimeSync::MESSAGE_SIZE;
+    }
+
+    // Compressed before the header goes in front, the datagram is cut after the HMAC
+    if (m_compressor)
+        gameDataSize = ConnectionDataPacket::CompressGameData(*m_compressor, o_packet.data + Packet::CONNECTION_DATA_PACKET_SIZE, gameDataSize);
+    const int end = Packet::CONNECTION_DATA_PACKET_SIZE + (gameDataSize & ~Packet::COMPRESSED_FLAG);
+    o_packet.index = 0;
+    ConnectionDataPacket::WriteHeader(o_packet, header, gameDataSize);
+    o_packet.index = end;
+    o_packet.size = end + Hash::HMAC::SIZE;
+    ConnectionDataPacket::WriteHMAC(o_packet, p_sharedKey);
+    OnPacketSent(header.sequence, o_packet.size);
+    return true;
+}
+
+void Connection::StartFragments(const SequenceHeader& p_header, const Message& p_message)
+{
+    // The payload is serialized once and sent fragment by fragment
+    const uint32_t size = static_cast<uint32_t>(p_message.data->size());
+    const uint32_t gameDataSize = ConnectionDataPacket::GetMessageHeaderSize(size) + size;
+    const uint32_t payloadSize = sizeof(uint32_t) + gameDataSize;
+    m_fragmentPayload = std::make_unique<Buffer>(payloadSize);
+    m_fragmentPayload->WriteInteger(gameDataSize);
+    ConnectionDataPacket::WriteMessageHeader(*m_fragmentPayload, p_message.channel, p_message.id, size);
+    m_fragmentPayload->WriteBuffer(p_message.data->data(), size);
+    if (m_compressor)
+    {
+        const uint32_t compressedSize = ConnectionDataPacket::CompressGameData(*m_compressor, m_fragmentPayload->data + sizeof(uint32_t), gameDataSize);
+        m_fragmentPayload->index = 0;
+        m_fragmentPayload->WriteInteger(compressedSize);
+        m_fragmentPayload->size = sizeof(uint32_t) + (compressedSize & ~Packet::COMPRESSED_FLAG);
+    }
+
+    m_fragmentHeader = p_header;
+    m_fragmentChannel = p_message.channel;
+    m_fragmentMessageId = p_message.id;
+    m_fragmentSize = static_cast<uint16_t>(GetMaxPacketSize() - Packet::FRAGMENT_HEADER_SIZE - Hash::HMAC::SIZE);
+    m_fragmentCount = static_cast<uint8_t>((m_fragmentPayload->size + m_fragmentSize - 1) / m_fragmentSize);
+    m_nextFragment = 0;
+}
+
+void Connection::WriteNextFragment(Buffer& o_packet, const ShortSharedKey& p_sharedKey)
+{
+    NETWORK_TRACE_ZONE("Connection::WriteNextFragment");
+    const unsigned int offset = m_nextFragment * m_fragmentSize;
+    const unsigned int size = std::min<unsigned int>(m_fragmentSize, static_cast<unsigned int>(m_fragmentPayload->size) - offset);
+
+    ConnectionDataFragmentPacket fragment { m_fragmentHeader, m_fragmentChannel, m_fragmentMessageId, m_nextFragment, m_fragmentCount };
+    fragment.Write(o_packet, p_sharedKey, m_fragmentPayload->data + offset, static_cast<uint16_t>(size));
+    OnPacketSent(m_fragmentHeader.sequence, o_packet.size);
+
+    if (++m_nextFragment == m_fragmentCount)
+    {
+        m_fragmentPayload.reset();
+        m_fragmentCount = 0;
+        m_nextFragment = 0;
+    }
+}
+
+bool Connection::ReadPacket(Buffer& p_packet)
+{
+    NETWORK_TRACE_ZONE("Connection::ReadPacket");
+    SequenceHeader header;
+    header.Read(p_packet);
+    return ReadPayload(header, p_packet, clock::now());
+}
+
+bool Connection::ReadFragment(Buffer& p_packet)
+{
+    NETWORK_TRACE_ZONE("Connection::ReadFragment");
+    ConnectionDataFragmentPacket fragment;
+    fragment.Read(p_packet);
+    if (m_receivedPackets.Exists(fragment.header.sequence) || m_receivedPackets.IsTooOld(fragment.header.sequence))
+        return false;
+
+    const int fragmentSize = p_packet.size - p_packet.index - static_cast<int>(Hash::HMAC::SIZE);
+    if (fragmentSize <= 0)
+        return false;
+
+    const clock::time_point now = clock::now();
+    std::unique_ptr<Buffer> payload = m_reassembler.AddFragment(fragment, p_packet.data + p_packet.index, fragmentSize, now);
+    return payload != nullptr && ReadPayload(fragment.header, *payload, now);
+}
+
+bool Connection::ReadPayload(const SequenceHeader& p_header, Buffer& p_payload, const clock::time_point p_arrival)
+{
+    const uint32_t gameDataField = p_payload.ReadInteger();
+    const uint32_t gameDataSize = gameDataField & ~Packet::COMPRESSED_FLAG;
+    if (gameDataSize > static_cast<uint32_t>(p_payload.size - p_payload.index))
+        return false;
+
+    if ((gameDataField & Packet::COMPRESSED_FLAG) == 0)
+    {
+        if (!ProcessReceivedHeader(p_header))
+            return false;
+        ReadMessages(p_header, p_payload, gameDataSize, p_arrival);
+        return true;
+    }
+
+    if (!m_compressor || gameDataSize < sizeof(uint32_t))
+        return false;
+    const uint32_t decompressedSize = p_payload.ReadInteger();
+    if (decompressedSize > Packet::MAX_FRAGMENT_SIZE * Packet::MAX_FRAGMENT_COUNT)
+        return false;
+
+    Buffer gameData(decompressedSize);
+    if (!m_compressor->Decompress(p_payload.data + p_payload.index, gameDataSize - sizeof(uint32_t), gameData.data, decompressedSize))
+        return false;
+    if (!ProcessReceivedHeader(p_header))
+        return false;
+    ReadMessages(p_header, gameData, decompressedSize, p_arrival);
+    return true;
+}
+
+void Connection::ReadMessages(const SequenceHeader& p_header, Buffer& p_gameData, const uint32_t p_gameDataSize, const clock::time_point p_arrival)
+{
+    const int end = p_gameData.index + p_gameDataSize;
+    while (p_gameData.index + static_cast<int>(Packet::MESSAGE_HEADER_SIZE) <= end)
+    {
+        uint8_t channel;
+        uint16_t id;
+        uint32_t size;
+        ConnectionDataPacket::ReadMessageHeader(p_gameData, channel, id, size);
+        if (channel == Packet::TIME_SYNC_CHANNEL)
+        {
+            if (size != TimeSync::MESSAGE_SIZE || size > static_cast<uint32_t>(end - p_gameData.index))
+                return;
+            m_timeSync.Read(p_gameData, GetLocalTime());
+            continue;
+        }
+
+        const bool parity = (channel & Packet::PARITY_CHANNEL_FLAG) != 0;
+        channel &= ~Packet::PARITY_CHANNEL_FLAG;
+        if (channel >= MAX_CHANNELS || size > static_cast<uint32_t>(end - p_gameData.index))
+            return;
+
+        auto data = std::make_shared<std::vector<uint8_t>>(size);
+        p_gameData.ReadBuffer(data->data(), size);
+        if (parity)
+            m_channels[channel].ProcessParity(std::move(data), p_arrival);
+        else
+            m_channels[channel].ProcessMessage(p_header.sequence, id, std::move(data), p_arrival);
+    }
+}
+
+bool Connection::ReceiveMessage(uint8_t& o_channel, MessageData& o_data, clock::time_point* o_arrival)
+{
+    for (auto& channel : m_channels)
+    {
+        if (channel.Receive(o_data, o_arrival))
+        {
+            o_channel = static_cast<uint8_t>(&channel - m_channels.data());
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Connection::IsAcked(const uint16_t p_sequence) const
+{
+    const SentPacketData* sentPacket = m_sentPackets.Find(p_sequence);
+    return sentPacket != nullptr && sentPacket->acked;
+}
+
+uint16_t Connection::GetLastSentSequence() const
+{
+    return m_sequence - 1;
+}
+
+uint16_t Connection::GetRemoteSequence() const
+{
+    return m_receivedPackets.GetSequence() - 1;
+}
+
+void Connection::OnDatagramReceived(const uint32_t p_size)
+{
+    ++m_stats.packetsReceived;
+    m_stats.bytesReceived += p_size;
+}
+
+void Connection::OnAuthenticationFailed()
+{
+    ++m_stats.authenticationFailures;
+}
+
+void Connection::OnChecksumFailed()
+{
+    ++m_stats.checksumFailures;
+}
+
+ConnectionStats Connection::GetStats() const
+{
+    ConnectionStats stats = m_stats;
+    stats.maxPacketSize = GetMaxPacketSize();
+    stats.roundTripTime = HasTimeSync() ? GetRoundTripTime() : -1.0;
+    stats.roundTripTimeVariance = HasTimeSync() ? GetRoundTripTimeVariance() : -1.0;
+    stats.sendRate = m_congestion.GetSendRate();
+    stats.sendBudget = m_congestion.GetBudget();
+    return stats;
+}
@@ -0,0 +1,160 @@
+#include "stdafx.h"
+#include "Network/Input/InputHistory.h"
+#include "Network/Snapshots/SnapshotDelta.h"
+#include "Network/Packets/Buffer.h"
+
+#pragma region InputSender
+void InputSender::Reset()
+{
+    const unsigned int redundancy = m_redundancy;
+    *this = InputSender();
+    m_redundancy = redundancy;
+}
+
+void InputSender::SetRedundancy(const unsigned int p_redundancy)
+{
+    m_redundancy = std::min(p_redundancy, HISTORY_SIZE - 1);
+}
+
+MessageData InputSender::Encode(const uint32_t p_tick, MessageData p_input, const bool p_hasAck, const uint16_t p_ackedMessage)
+{
+    if ((m_hasInput && !Packet::SequenceGreaterThan<uint32_t>(p_tick, m_newestTick)) || p_input->size() > MAX_INPUT_SIZE)
+        return nullptr;
+
+    const uint32_t* ackedTick = p_hasAck ? m_messageTicks.Find(p_ackedMessage) : nullptr;
+    if (ackedTick != nullptr && (!m_hasAckedTick || Packet::SequenceGreaterThan<uint32_t>(*ackedTick, m_ackedTick)))
+    {
+        m_hasAckedTick = true;
+        m_ackedTick = *ackedTick;
+    }
+
+    m_hasInput = true;
+    m_newestTick = p_tick;
+    m_inputs[p_tick % HISTORY_SIZE] = { true, p_tick, p_input };
+
+    struct Entry
+    {
+        uint8_t                 tickGap;
+        uint16_t                size;
+        std::vector<uint8_t>    encoded;
+    };
+    std::vector<Entry> entries;
+    entries.push_back({ 0, static_cast<uint16_t>(p_input->size()), *p_input });
+    unsigned int messageSize = HEADER_SIZE + ENTRY_HEADER_SIZE + static_cast<unsigned int>(p_input->size());
+
+    const Input* previous = &m_inputs[p_tick % HISTORY_SIZE];
+    for (uint32_t i = 1; i <= m_redundancy; ++i)
+    {
+        const uint32_t tick = p_tick - i;
+        if (m_hasAckedTick && !Packet::SequenceGreaterThan<uint32_t>(tick, m_ackedTick))
+            break;
+        const Input& input = m_inputs[tick % HISTORY_SIZE];
+        if (!input.valid || input.tick != tick)
+            continue;
+
+        // Consecutive inputs mostly repeat each other, the delta is usually a few bytes
+        Entry entry { static_cast<uint8_t>(previous->tick - tick), static_cast<uint16_t>(input.data->size()), {} };
+        SnapshotDelta::Encode(*previous->data, input.data->data(), entry.size, entry.encoded);
+        if (messageSize + ENTRY_HEADER_SIZE + entry.encoded.size() > MAX_MESSAGE_SIZE)
+            break;
+        messageSize += ENTRY_HEADER_SIZE + static_cast<unsigned int>(entry.encoded.size());
+        entries.push_back(std::move(entry));
+        previous = &input;
+    }
+
+    Buffer buffer(messageSize);
+    buffer.WriteByte(static_cast<uint8_t>(entries.size()));
+    buffer.WriteInteger(p_tick);
+    for (const Entry& entry : entries)
+    {
+        buffer.WriteByte(entry.tickGap);
+        buffer.WriteShort(entry.size);
+        buffer.WriteShort(static_cast<uint16_t>(entry.encoded.size()));
+        buffer.WriteBuffer(entry.encoded.data(), static_cast<unsigned int>(entry.encoded.size()));
+    }
+    return std::make_shared<const std::vector<uint8_t>>(buffer.data, buffer.data + messageSize);
+}
+
+void InputSender::Store(const uint16_t p_messageId)
+{
+    uint32_t* tick = m_messageTicks.Insert(p_messageId);
+    if (tick != nullptr)
+        *tick = m_newestTick;
+}
+#pragma endregion
+
+#pragma region InputReceiver
+void InputReceiver::Reset()
+{
+    *this = InputReceiver();
+}
+
+bool InputReceiver::Decode(const MessageData& p_message)
+{
+    if (p_message->size() < InputSender::HEADER_SIZE)
+        return false;
+
+    Buffer buffer(static_cast<unsigned int>(p_message->size()));
+    std::copy(p_message->begin(), p_message->end(), buffer.data);
+    const uint8_t count = buffer.ReadByte();
+    uint32_t tick = buffer.ReadInteger();
+    if (count == 0)
+        return false;
+
+    std::vector<std::pair<uint32_t, MessageData>> inputs;
+    std::shared_ptr<std::vector<uint8_t>> previous;
+    for (uint8_t i = 0; i < count; ++i)
+    {
+        if (static_cast<unsigned int>(buffer.size - buffer.index) < InputSender::ENTRY_HEADER_SIZE)
+            return false;
+        const uint8_t tickGap = buffer.ReadByte();
+        const uint16_t size = buffer.ReadShort();
+        const uint16_t encodedSize = buffer.ReadShort();
+        if (static_cast<unsigned int>(buffer.size - buffer.index) < encodedSize || (i > 0 && tickGap == 0))
+            return false;
+
+        tick -= tickGap;
+        auto input = std::make_shared<std::vector<uint8_t>>();
+        const uint8_t* encoded = buffer.data + buffer.index;
+        if (i == 0)
+        {
+            if (encodedSize != size)
+                return false;
+            input->assign(encoded, encoded + size);
+        }
+        else if (!SnapshotDelta::Decode(*previous, encoded, encodedSize, size, *input))
+        {
+            return false;
+        }
+        buffer.index += encodedSize;
+
+        // Inputs are written newest first, every one older than the last delivered tick ends the message
+        if (m_hasTick && !Packet::SequenceGreaterThan<uint32_t>(tick, m_lastTick))
+            break;
+        inputs.emplace_back(tick, input);
+        previous = std::move(input);
+    }
+
+    if (inputs.empty())
+        return true;
+
+    m_hasTick = true;
+    m_lastTick = inputs.front().first;
+    for (auto it = inputs.rbegin(); it != inputs.rend(); ++it)
+        m_pending.push_back(std::move(*it));
+    while (m_pending.size() > MAX_PENDING_INPUTS)
+        m_pending.pop_front();
+    return true;
+}
+
+bool InputReceiver::Receive(uint32_t& o_tick, MessageData& o_input)
+{
+    if (m_pending.empty())
+        return false;
+
+    o_tick = m_pending.front().first;
+    o_input = std::move(m_pending.front().second);
+    m_pending.pop_front();
+    return true;
+}
+#pragma endregion
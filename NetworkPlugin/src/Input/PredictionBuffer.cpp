@@ -0,0 +1,124 @@
+#include "stdafx.h"
+#include "Network/Input/PredictionBuffer.h"
+#include "Network/Packets/Packet.h"
+
+void PredictionBuffer::Reset()
+{
+    for (auto& entry : m_entries)
+        entry.valid = false;
+    m_hasTick = false;
+    m_newestTick = 0;
+    m_hasConfirmedTick = false;
+    m_confirmedTick = 0;
+}
+
+void PredictionBuffer::SetTolerance(const float p_tolerance)
+{
+    m_tolerance = p_tolerance;
+}
+
+PredictionBuffer::Entry* PredictionBuffer::Find(const uint32_t p_tick)
+{
+    Entry& entry = m_entries[p_tick % HISTORY_SIZE];
+    return entry.valid && entry.tick == p_tick ? &entry : nullptr;
+}
+
+const PredictionBuffer::Entry* PredictionBuffer::Find(const uint32_t p_tick) const
+{
+    const Entry& entry = m_entries[p_tick % HISTORY_SIZE];
+    return entry.valid && entry.tick == p_tick ? &entry : nullptr;
+}
+
+bool PredictionBuffer::Matches(const std::vector<uint8_t>& p_predicted, const uint8_t* p_state, const unsigned int p_size) const
+{
+    if (p_predicted.size() != p_size)
+        return false;
+    if (m_tolerance <= 0.0f || p_size % sizeof(float) != 0)
+        return memcmp(p_predicted.data(), p_state, p_size) == 0;
+
+    for (unsigned int offset = 0; offset < p_size; offset += sizeof(float))
+    {
+        float predicted;
+        float authoritative;
+        memcpy(&predicted, p_predicted.data() + offset, sizeof(float));
+        memcpy(&authoritative, p_state + offset, sizeof(float));
+        // NaN never matches, a diverged simulation must be corrected
+        if (!(std::abs(predicted - authoritative) <= m_tolerance))
+            return false;
+    }
+    return true;
+}
+
+bool PredictionBuffer::Store(const uint32_t p_tick, const uint8_t* p_input, const unsigned int p_inputSize, const uint8_t* p_state,
+                             const unsigned int p_stateSize)
+{
+    if (m_hasTick && !Packet::SequenceGreaterThan<uint32_t>(p_tick, m_newestTick))
+        return false;
+
+    // Ticks skipped by the caller leave no stale entry behind
+    if (m_hasTick)
+    {
+        for (uint32_t tick = m_newestTick + 1; tick != p_tick && tick - m_newestTick <= HISTORY_SIZE; ++tick)
+            m_entries[tick % HISTORY_SIZE].valid = false;
+    }
+
+    Entry& entry = m_entries[p_tick % HISTORY_SIZE];
+    entry.valid = true;
+    entry.tick = p_tick;
+    entry.input.assign(p_input, p_input + p_inputSize);
+    entry.state.assign(p_state, p_state + p_stateSize);
+    m_hasTick = true;
+    m_newestTick = p_tick;
+    return true;
+}
+
+bool PredictionBuffer::UpdateState(const uint32_t p_tick, const uint8_t* p_state, const unsigned int p_size)
+{
+    Entry* entry = Find(p_tick);
+    if (entry == nullptr)
+        return false;
+    entry->state.assign(p_state, p_state + p_size);
+    return true;
+}
+
+int PredictionBuffer::Reconcile(const uint32_t p_tick, const uint8_t* p_state, const unsigned int p_size, uint32_t& o_firstTick)
+{
+    if (m_hasConfirmedTick && !Packet::SequenceGreaterThan<uint32_t>(p_tick, m_confirmedTick))
+        return -1;
+    if (m_hasTick && m_newestTick - p_tick >= HISTORY_SIZE && Packet::SequenceGreaterThan<uint32_t>(m_newestTick, p_tick))
+        return -1;
+
+    m_hasConfirmedTick = true;
+    m_confirmedTick = p_tick;
+    o_firstTick = p_tick + 1;
+
+    // The server is ahead of the prediction, nothing predicted to correct
+    if (!m_hasTick || Packet::SequenceGreaterThan<uint32_t>(p_tick, m_newestTick))
+        return 0;
+
+    Entry* entry = Find(p_tick);
+    if (entry != nullptr && Matches(entry->state, p_state, p_size))
+        return 0;
+
+    if (entry != nullptr)
+        entry->state.assign(p_state, p_state + p_size);
+    return static_cast<int>(m_newestTick - p_tick);
+}
+
+const std::vector<uint8_t>* PredictionBuffer::GetInput(const uint32_t p_tick) const
+{
+    const Entry* entry = Find(p_tick);
+    return entry != nullptr ? &entry->input : nullptr;
+}
+
+const std::vector<uint8_t>* PredictionBuffer::GetState(const uint32_t p_tick) const
+{
+    const Entry* entry = Find(p_tick);
+    return entry != nullptr ? &entry->state : nullptr;
+}
+
+bool PredictionBuffer::GetNewestTick(uint32_t& o_tick) const
+{
+    o_tick = m_newestTick;
+    return m_hasTick;
+}
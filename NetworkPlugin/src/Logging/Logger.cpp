@@ -0,0 +1,223 @@
+#include "stdafx.h"
+#include "Network/Logging/Logger.h"
+#include "Network/NetworkPlugin.h"
+
+Logger::Logger()
+{
+    for (unsigned int i = 0; i < QUEUE_SIZE; ++i)
+        m_cells[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+Logger& Logger::Get()
+{
+    // Never destroyed, the logger thread may still run while the module's statics are torn down
+    static Logger* logger = new Logger();
+    return *logger;
+}
+
+void Logger::SetLevel(const LogLevel p_level)
+{
+    Get().m_level.store(p_level, std::memory_order_relaxed);
+}
+
+bool Logger::IsEnabled(const LogLevel p_level)
+{
+    return p_level >= Get().m_level.load(std::memory_order_relaxed);
+}
+
+bool Logger::Allow(LogSite& p_site, uint32_t& o_suppressed)
+{
+    // Sites race on the window reset, a few extra or missing lines around it don't matter
+    const int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(clock::now() - m_origin).count();
+    int64_t windowStart = p_site.windowStart.load(std::memory_order_relaxed);
+    if (now - windowStart >= std::chrono::duration_cast<std::chrono::milliseconds>(RATE_WINDOW).count() &&
+        p_site.windowStart.compare_exchange_strong(windowStart, now, std::memory_order_relaxed))
+        p_site.count.store(0, std::memory_order_relaxed);
+
+    if (p_site.count.fetch_add(1, std::memory_order_relaxed) >= MAX_LINES_PER_SITE)
+    {
+        p_site.suppressed.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    o_suppressed = p_site.suppressed.exchange(0, std::memory_order_relaxed);
+    return true;
+}
+
+Logger::Cell* Logger::Claim(uint32_t& o_position)
+{
+    uint32_t position = m_enqueuePosition.load(std::memory_order_relaxed);
+    while (true)
+    {
+        Cell& cell = m_cells[position % QUEUE_SIZE];
+        const int32_t difference = static_cast<int32_t>(cell.sequence.load(std::memory_order_acquire) - position);
+        if (difference == 0)
+        {
+            if (m_enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+            {
+                o_position = position;
+                return &cell;
+            }
+        }
+        else if (difference < 0)
+        {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        else
+        {
+            position = m_enqueuePosition.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+void Logger::Publish(Cell& p_cell, const uint32_t p_position)
+{
+    p_cell.sequence.store(p_position + 1, std::memory_order_release);
+    if (!m_started.exchange(true, std::memory_order_acq_rel))
+    {
+        m_running.store(true, std::memory_order_relaxed);
+        m_thread = std::thread(&Logger::Run, this);
+    }
+}
+
+void Logger::Run()
+{
+    while (m_running.load(std::memory_order_relaxed))
+    {
+        const uint64_t flushRequests = m_flushRequests.load(std::memory_order_acquire);
+        Drain();
+        m_flushesDone.store(flushRequests, std::memory_order_release);
+        std::this_thread::sleep_for(FLUSH_INTERVAL);
+    }
+}
+
+void Logger::Drain()
+{
+    std::string batch;
+    std::string line;
+    while (true)
+    {
+        Cell& cell = m_cells[m_dequeuePosition % QUEUE_SIZE];
+        if (static_cast<int32_t>(cell.sequence.load(std::memory_order_acquire) - (m_dequeuePosition + 1)) < 0)
+            break;
+
+        Format(cell.record, line);
+        cell.sequence.store(m_dequeuePosition + QUEUE_SIZE, std::memory_order_release);
+        ++m_dequeuePosition;
+
+        if (!batch.empty())
+            batch += '\n';
+        batch += line;
+    }
+
+    const uint64_t dropped = m_dropped.exchange(0, std::memory_order_relaxed);
+    if (dropped > 0)
+    {
+        if (!batch.empty())
+            batch += '\n';
+        batch += "[WARNING] " + std::to_string(dropped) + " log lines dropped, the log queue was full";
+    }
+    if (!batch.empty())
+        g_debugCallback(batch.c_str());
+}
+
+void Logger::Format(const Record& p_record, std::string& o_line)
+{
+    static const char* const LEVEL_NAMES[] { "[VERBOSE] ", "[INFO] ", "[WARNING] ", "[FAILURE] ", "" };
+    o_line = LEVEL_NAMES[static_cast<uint8_t>(p_record.level)];
+
+    unsigned int argumentIndex = 0;
+    for (const char* c = p_record.format; *c != '\0'; ++c)
+    {
+        if (c[0] != '{' || c[1] != '}' || argumentIndex >= p_record.argumentCount)
+        {
+            o_line += *c;
+            continue;
+        }
+
+        const Argument& argument = p_record.arguments[argumentIndex++];
+        switch (argument.type)
+        {
+            case ArgumentType::SIGNED:
+                o_line += std::to_string(argument.integer);
+                break;
+            case ArgumentType::UNSIGNED:
+                o_line += std::to_string(argument.unsignedInteger);
+                break;
+            case ArgumentType::REAL:
+                o_line += std::to_string(argument.real);
+                break;
+            case ArgumentType::TEXT:
+                o_line.append(p_record.text.data() + argument.textOffset, argument.textSize);
+                break;
+        }
+        ++c;
+    }
+    if (p_record.suppressed > 0)
+        o_line += " (" + std::to_string(p_record.suppressed) + " similar lines suppressed)";
+}
+
+void Logger::SetArgument(Record& p_record, Argument& o_argument, const char* p_value)
+{
+    o_argument.type = ArgumentType::TEXT;
+    o_argument.textOffset = p_record.textSize;
+    o_argument.textSize = 0;
+    if (p_value == nullptr)
+        return;
+    while (p_value[o_argument.textSize] != '\0' && p_record.textSize < TEXT_SIZE)
+        p_record.text[p_record.textSize++] = p_value[o_argument.textSize++];
+}
+
+void Logger::SetArgument(Record& p_record, Argument& o_argument, const std::string& p_value)
+{
+    SetArgument(p_record, o_argument, p_value.c_str());
+}
+
+void Logger::SetArgument(Record&, Argument& o_argument, const double p_value)
+{
+    o_argument.type = ArgumentType::REAL;
+    o_argument.real = p_value;
+}
+
+void Logger::Flush()
+{
+    // Only the logger thread drains while it runs, without it nothing was queued since the last shutdown
+    Logger& logger = Get();
+    if (!logger.m_running.load(std::memory_order_relaxed))
+        return;
+
+    const uint64_t request = logger.m_flushRequests.fetch_add(1, std::memory_order_acq_rel) + 1;
+    while (logger.m_running.load(std::memory_order_relaxed) && logger.m_flushesDone.load(std::memory_order_acquire) < request)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+void Logger::Shutdown()
+{
+    Logger& logger = Get();
+    if (!logger.m_running.exchange(false, std::memory_order_relaxed))
+        return;
+    if (logger.m_thread.joinable())
+        logger.m_thread.join();
+    logger.Drain();
+    logger.m_started.store(false, std::memory_order_release);
+}
+
+#pragma region CExport
+extern "C"
+{
+    void Internal_LoggerSetLevel(const unsigned char p_level)
+    {
+        if (p_level > static_cast<unsigned char>(LogLevel::OFF))
+        {
+            g_debugCallback("Invalid log level");
+            return;
+        }
+        Logger::SetLevel(static_cast<LogLevel>(p_level));
+    }
+
+    void Internal_LoggerFlush()
+    {
+        Logger::Flush();
+    }
+}
+#pragma endregion
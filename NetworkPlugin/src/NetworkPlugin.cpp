@@ -1,5 +1,6 @@
 #include "stdafx.h"
 #include "Network/NetworkPlugin.h"
+#include "Network/Logging/Logger.h"
 
 DebugCallback g_debugCallback = [](const char* str) { std::cout << str << '\n'; };
 
@@ -17,6 +18,7 @@ bool NetworkAPI::InitializeSockets()
 
 void NetworkAPI::ShutdownSockets()
 {
+    Logger::Shutdown();
     if(isInitialized)
     {
     if (WSACleanup() == SOCKET_ERROR)
@@ -74,7 +74,7 @@ void Buffer::WriteFloat(float p_value)
     index += sizeof(float);
 }
 
-void Buffer::WriteBuffer(unsigned char* p_buffer, unsigned int p_size)
+void Buffer::WriteBuffer(const unsigned char* p_buffer, unsigned int p_size)
 {
     if (index + p_size > static_cast<unsigned>(size))
         throw std::out_of_range("Trying to write out of buffer");
@@ -0,0 +1,106 @@
+#include "stdafx.h"
+#include "Network/Packets/FragmentReassembler.h"
+
+void FragmentReassembler::Reset()
+{
+    for (auto& entry : m_entries)
+        entry = {};
+}
+
+FragmentReassembler::Entry* FragmentReassembler::FindEntry(const uint8_t p_channel, const uint16_t p_messageId)
+{
+    for (auto& entry : m_entries)
+    {
+        if (entry.inUse && entry.channel == p_channel && entry.messageId == p_messageId)
+            return &entry;
+    }
+    return nullptr;
+}
+
+FragmentReassembler::Entry* FragmentReassembler::AllocateEntry(const clock::time_point p_now)
+{
+    Entry* oldest = &m_entries[0];
+    for (auto& entry : m_entries)
+    {
+        if (entry.inUse && p_now - entry.firstReceived > TIMEOUT)
+            entry = {};
+        if (!entry.inUse)
+            return &entry;
+        if (entry.firstReceived < oldest->firstReceived)
+            oldest = &entry;
+    }
+    *oldest = {};
+    return oldest;
+}
+
+std::unique_ptr<Buffer> FragmentReassembler::AddFragment(const ConnectionDataFragmentPacket& p_fragment, const unsigned char* p_data,
+                                                         const unsigned int p_size, const clock::time_point p_now)
+{
+    const uint8_t index = p_fragment.fragmentIndex;
+    const uint8_t count = p_fragment.fragmentCount;
+    if (count == 0 || count > Packet::MAX_FRAGMENT_COUNT || index >= count)
+        return nullptr;
+
+    const bool isLast = index == count - 1;
+    if (p_size == 0 || p_size > Packet::MAX_FRAGMENT_SIZE || (!isLast && p_size < Packet::MIN_FRAGMENT_SIZE))
+        return nullptr;
+
+    Entry* entry = FindEntry(p_fragment.channel, p_fragment.messageId);
+    if (entry != nullptr && p_now - entry->firstReceived > TIMEOUT)
+    {
+        *entry = {};
+        entry = nullptr;
+    }
+
+    if (entry == nullptr)
+    {
+        entry = AllocateEntry(p_now);
+        entry->inUse = true;
+        entry->channel = p_fragment.channel;
+        entry->messageId = p_fragment.messageId;
+        entry->fragmentCount = count;
+        entry->firstReceived = p_now;
+        entry->payload = std::make_unique<Buffer>(count * Packet::MAX_FRAGMENT_SIZE);
+    }
+    else if (entry->fragmentCount != count)
+    {
+        *entry = {};
+        return nullptr;
+    }
+
+    if (entry->received.test(index))
+        return nullptr;
+
+    // Fragments have a fixed size except the last one, which can't be larger
+    const uint16_t fragmentSize = isLast ? entry->fragmentSize : static_cast<uint16_t>(p_size);
+    if ((!isLast && entry->fragmentSize != 0 && entry->fragmentSize != p_size) || (fragmentSize != 0 && p_size > fragmentSize) ||
+        (!isLast && entry->lastSize > p_size))
+    {
+        *entry = {};
+        return nullptr;
+    }
+    if (isLast)
+        entry->lastSize = static_cast<uint16_t>(p_size);
+    else
+        entry->fragmentSize = static_cast<uint16_t>(p_size);
+
+    entry->received.set(index);
+    ++entry->receivedCount;
+    entry->size += p_size;
+    memcpy(entry->payload->data + index * Packet::MAX_FRAGMENT_SIZE, p_data, p_size);
+
+    if (entry->receivedCount < entry->fragmentCount)
+        return nullptr;
+
+    // Slots only move towards the start, each fragment lands before the next one is read
+    std::unique_ptr<Buffer> payload = std::move(entry->payload);
+    for (unsigned int i = 1; i < entry->fragmentCount; ++i)
+    {
+        const unsigned int size = i == entry->fragmentCount - 1u ? entry->lastSize : entry->fragmentSize;
+        memmove(payload->data + i * entry->fragmentSize, payload->data + i * Packet::MAX_FRAGMENT_SIZE, size);
+    }
+    payload->size = entry->size;
+    payload->index = 0;
+    *entry = {};
+    return payload;
+}
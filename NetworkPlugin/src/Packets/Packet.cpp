@@ -1,8 +1,11 @@
 #include "stdafx.h"
 #include "Network/Packets/Packet.h"
+#include "Network/Compression/LZCompressor.h"
 #include "Network/ErrorDetection/CRC.h"
 #include "Network/Client.h"
 #include "Network/ErrorDetection/Checksums.h"
+#include "Network/Tracing/Tracer.h"
+#include "Network/Logging/Logger.h"
 
 const uint32_t                          Packet::PROTOCOL_ID = Fletcher32_improved(reinterpret_cast<const uint16_t*>("NetworkPluginV1.0.0"), 10);
 
@@ -10,6 +13,7 @@ using namespace Cryptography;
 
 PacketType Packet::VerifyPacketHMAC(const ShortSharedKey& p_key, Buffer& p_buffer)
 {
+    NETWORK_TRACE_ZONE("Packet::VerifyPacketHMAC");
     if (p_buffer.size <= (int)Hash::HMAC::SIZE)
         return PacketType::INVALID_PACKET;
 
@@ -23,13 +27,13 @@ PacketType Packet::VerifyPacketHMAC(const ShortSharedKey& p_key, Buffer& p_buffe
     p_buffer.index = 0;
     if (memcmp(newHMAC.data(), hmac.data, Hash::HMAC::SIZE) != 0)
     {
-        g_debugCallback("Invalid HMAC, Discarded packet!");
+        NETWORK_LOG(WARNING, "Invalid HMAC, Discarded packet!");
         return PacketType::INVALID_PACKET;
     }
 
     if (p_buffer.ReadInteger() != PROTOCOL_ID)
     {
-        g_debugCallback("Invalid Protocol id, Discarded packet!");
+        NETWORK_LOG(WARNING, "Invalid Protocol id, Discarded packet!");
         return PacketType::INVALID_PACKET;
     }
     return static_cast<PacketType>(p_buffer.ReadByte());
@@ -37,6 +41,7 @@ PacketType Packet::VerifyPacketHMAC(const ShortSharedKey& p_key, Buffer& p_buffe
 
 PacketType Packet::VerifyPacketCRC(Buffer& p_buffer)
 {
+    NETWORK_TRACE_ZONE("Packet::VerifyPacketCRC");
     if(p_buffer.size <= 0)
         return PacketType::INVALID_PACKET;
 
@@ -48,16 +53,33 @@ PacketType Packet::VerifyPacketCRC(Buffer& p_buffer)
     const uint32_t newCrc = CRC32::GetCRCTableBased(p_buffer.data, p_buffer.size);
     if(crc != newCrc)
     {
-        g_debugCallback("Invalid CRC, Discarded packet!");
+        NETWORK_LOG(WARNING, "Invalid CRC, Discarded packet!");
         return PacketType::INVALID_PACKET;
     }
     return static_cast<PacketType>(p_buffer.ReadByte());
 }
 
 
+#pragma region SequenceHeader
+void SequenceHeader::Write(Buffer& p_buffer) const
+{
+    p_buffer.WriteShort(sequence);
+    p_buffer.WriteShort(ack);
+    p_buffer.WriteInteger(ackBits);
+}
+
+void SequenceHeader::Read(Buffer& p_buffer)
+{
+    sequence    = p_buffer.ReadShort();
+    ack         = p_buffer.ReadShort();
+    ackBits     = p_buffer.ReadInteger();
+}
+#pragma endregion 
+
 #pragma region ConnectionRequestPacket
 void ConnectionRequestPacket::Write(Buffer& p_buffer)
 {
+    NETWORK_TRACE_ZONE("ConnectionRequestPacket::Write");
     CRC32::InitTable();
     p_buffer.Init(Packet::CONNECTION_REQUEST_PACKET_SIZE);
     p_buffer.WriteInteger(Packet::PROTOCOL_ID);
@@ -72,6 +94,7 @@ void ConnectionRequestPacket::Write(Buffer& p_buffer)
 
 void ConnectionRequestPacket::Read(Buffer& p_buffer)
 {
+    NETWORK_TRACE_ZONE("ConnectionRequestPacket::Read");
     p_buffer.ReadBuffer(reinterpret_cast<unsigned char *>(clientPublicKey.Get64BitArray()), Packet::ROUNDED_PUBLIC_KEY_SIZE);
 }
 #pragma endregion 
@@ -79,6 +102,7 @@ void ConnectionRequestPacket::Read(Buffer& p_buffer)
 #pragma  region ChallengePacket
 void ChallengePacket::Write(Buffer& p_buffer)
 {
+    NETWORK_TRACE_ZONE("ChallengePacket::Write");
     CRC32::InitTable();
     p_buffer.Init(Packet::CHALLENGE_PACKET_SIZE);
     p_buffer.WriteInteger(Packet::PROTOCOL_ID);
@@ -93,6 +117,7 @@ void ChallengePacket::Write(Buffer& p_buffer)
 
 void ChallengePacket::Read(Buffer& p_buffer)
 {
+    NETWORK_TRACE_ZONE("ChallengePacket::Read");
     p_buffer.ReadBuffer(reinterpret_cast<unsigned char *>(serverPublicKey.Get64BitArray()), Packet::ROUNDED_PUBLIC_KEY_SIZE);
 }
 #pragma endregion 
@@ -100,6 +125,7 @@ void ChallengePacket::Read(Buffer& p_buffer)
 #pragma  region ChallengeResponsePacket
 void ChallengeResponsePacket::Write(Buffer& p_buffer, const ShortSharedKey& sharedKey)
 {
+    NETWORK_TRACE_ZONE("ChallengeResponsePacket::Write");
     p_buffer.Init(Packet::CHALLENGE_RESPONSE_PACKET_SIZE + Hash::HMAC::SIZE);
     p_buffer.WriteInteger(Packet::PROTOCOL_ID);
     p_buffer.WriteByte(static_cast<uint8_t>(PacketType::CHALLENGE_RESPONSE));
@@ -110,6 +136,7 @@ void ChallengeResponsePacket::Write(Buffer& p_buffer, const ShortSharedKey& shar
 
 void ChallengeResponsePacket::Read(Buffer& p_buffer)
 {
+    NETWORK_TRACE_ZONE("ChallengeResponsePacket::Read");
     //p_buffer.ReadBuffer(sharedKey.data(), sharedKey.size());
 }
 #pragma endregion 
@@ -120,6 +147,7 @@ void ChallengeResponsePacket::Read(Buffer& p_buffer)
 #pragma  region ConnectionAcceptedPacket
 void ConnectionAcceptedPacket::Write(Buffer& p_buffer, const ShortSharedKey& sharedKey)
 {
+    NETWORK_TRACE_ZONE("ConnectionAcceptedPacket::Write");
     p_buffer.Init(Packet::CONNECTION_ACCEPTED_PACKET_SIZE + Hash::HMAC::SIZE);
     p_buffer.WriteInteger(Packet::PROTOCOL_ID);
     p_buffer.WriteByte(static_cast<uint8_t>(PacketType::CONNECTION_ACCEPTED));
@@ -132,6 +160,7 @@ void ConnectionAcceptedPacket::Write(Buffer& p_buffer, const ShortSharedKey& sha
 
 void ConnectionAcceptedPacket::Read(Buffer& p_buffer)
 {
+    NETWORK_TRACE_ZONE("ConnectionAcceptedPacket::Read");
     //p_buffer.ReadBuffer(sharedKey.data(), sharedKey.size());
     clientID    = p_buffer.ReadInteger();
 }
@@ -141,31 +170,180 @@ void ConnectionAcceptedPacket::Read(Buffer& p_buffer)
 void ConnectionDataPacket::Write(Buffer& p_buffer, const ShortSharedKey& sharedKey)
 {
     p_buffer.Init(Packet::CONNECTION_DATA_PACKET_SIZE + gameDataSize + Hash::HMAC::SIZE);
-    p_buffer.WriteInteger(Packet::PROTOCOL_ID);
-    p_buffer.WriteByte(static_cast<uint8_t>(PacketType::CONNECTION_DATA));
-    p_buffer.WriteShort(sequence);
-    p_buffer.WriteInteger(gameDataSize);
+    WriteHeader(p_buffer, header, gameDataSize);
     p_buffer.WriteBuffer(gameData, gameDataSize);
-
-    auto hmac = Hash::HMAC::HMAC_SHA256(sharedKey.data(), sharedKey.size(), p_buffer.data, Packet::CONNECTION_DATA_PACKET_SIZE + gameDataSize);
-    p_buffer.WriteBuffer(hmac.data(), hmac.size());
+    WriteHMAC(p_buffer, sharedKey);
 }
 
 void ConnectionDataPacket::Read(Buffer& p_buffer)
 {
-    sequence = p_buffer.ReadShort();
+    header.Read(p_buffer);
     //p_buffer.ReadBuffer(sharedKey.data(), sharedKey.size());
     gameDataSize = p_buffer.ReadInteger();
     gameData = new unsigned char[gameDataSize];
     p_buffer.ReadBuffer(gameData, gameDataSize);
 }
 
+void ConnectionDataPacket::WriteHeader(Buffer& p_buffer, const SequenceHeader& p_header, const uint32_t p_gameDataSize)
+{
+    p_buffer.WriteInteger(Packet::PROTOCOL_ID);
+    p_buffer.WriteByte(static_cast<uint8_t>(PacketType::CONNECTION_DATA));
+    p_header.Write(p_buffer);
+    p_buffer.WriteInteger(p_gameDataSize);
+}
+
+void ConnectionDataPacket::WriteMessageHeader(Buffer& p_buffer, const uint8_t p_channel, const uint16_t p_id, const uint32_t p_size)
+{
+    p_buffer.WriteByte(p_channel);
+    p_buffer.WriteShort(p_id);
+    if (p_size < Packet::EXTENDED_MESSAGE_SIZE)
+    {
+        p_buffer.WriteShort(static_cast<uint16_t>(p_size));
+        return;
+    }
+    p_buffer.WriteShort(Packet::EXTENDED_MESSAGE_SIZE);
+    p_buffer.WriteInteger(p_size);
+}
+
+void ConnectionDataPacket::ReadMessageHeader(Buffer& p_buffer, uint8_t& o_channel, uint16_t& o_id, uint32_t& o_size)
+{
+    o_channel   = p_buffer.ReadByte();
+    o_id        = p_buffer.ReadShort();
+    o_size      = p_buffer.ReadShort();
+    if (o_size == Packet::EXTENDED_MESSAGE_SIZE)
+        o_size  = p_buffer.ReadInteger();
+}
+
+unsigned int ConnectionDataPacket::GetMessageHeaderSize(const uint32_t p_size)
+{
+    return Packet::MESSAGE_HEADER_SIZE + (p_size < Packet::EXTENDED_MESSAGE_SIZE ? 0 : sizeof(uint32_t));
+}
+
+void ConnectionDataPacket::WriteHMAC(Buffer& p_buffer, const ShortSharedKey& p_sharedKey)
+{
+    NETWORK_TRACE_ZONE("ConnectionDataPacket::WriteHMAC");
+    auto hmac = Hash::HMAC::HMAC_SHA256(p_sharedKey.data(), p_sharedKey.size(), p_buffer.data, p_buffer.index);
+    p_buffer.WriteBuffer(hmac.data(), hmac.size());
+}
+
+uint32_t ConnectionDataPacket::CompressGameData(const LZCompressor& p_compressor, uint8_t* p_gameData, const uint32_t p_size)
+{
+    if (p_size <= sizeof(uint32_t) + 1)
+        return p_size;
+
+    const std::vector<uint8_t> gameData(p_gameData, p_gameData + p_size);
+    const uint32_t compressedSize = p_compressor.Compress(gameData.data(), p_size, p_gameData + sizeof(uint32_t), p_size - sizeof(uint32_t) - 1);
+    if (compressedSize == 0)
+    {
+        memcpy(p_gameData, gameData.data(), p_size);
+        return p_size;
+    }
+
+    const uint32_t decompressedSize = htonl(p_size);
+    memcpy(p_gameData, &decompressedSize, sizeof decompressedSize);
+    return (sizeof(uint32_t) + compressedSize) | Packet::COMPRESSED_FLAG;
+}
+
+void ConnectionDataPacket::WriteShared(Buffer& p_buffer, const uint8_t p_channel, const uint16_t p_id, const unsigned char* p_data, const uint16_t p_size, const LZCompressor* p_compressor)
+{
+    const uint32_t gameDataSize = Packet::MESSAGE_HEADER_SIZE + p_size;
+    p_buffer.Init(Packet::CONNECTION_DATA_PACKET_SIZE + gameDataSize);
+    WriteHeader(p_buffer, {}, gameDataSize);
+    WriteMessageHeader(p_buffer, p_channel, p_id, p_size);
+    p_buffer.WriteBuffer(p_data, p_size);
+    if (p_compressor == nullptr)
+        return;
+
+    const uint32_t compressedSize = CompressGameData(*p_compressor, p_buffer.data + Packet::CONNECTION_DATA_PACKET_SIZE, gameDataSize);
+    p_buffer.index = Packet::CONNECTION_DATA_PACKET_SIZE - sizeof(uint32_t);
+    p_buffer.WriteInteger(compressedSize);
+    p_buffer.size = p_buffer.index = Packet::CONNECTION_DATA_PACKET_SIZE + (compressedSize & ~Packet::COMPRESSED_FLAG);
+}
+
+void ConnectionDataPacket::WriteSequenceHeader(Buffer& p_buffer, const SequenceHeader& p_header)
+{
+    const int index = p_buffer.index;
+    p_buffer.index = SEQUENCE_OFFSET;
+    p_header.Write(p_buffer);
+    p_buffer.index = index;
+}
+
+void ConnectionDataPacket::WriteMessageId(Buffer& p_buffer, const uint16_t p_id)
+{
+    const int index = p_buffer.index;
+    p_buffer.index = Packet::CONNECTION_DATA_PACKET_SIZE + sizeof(uint8_t);
+    p_buffer.WriteShort(p_id);
+    p_buffer.index = index;
+}
+
 ConnectionDataPacket::~ConnectionDataPacket()
 {
         delete gameData;
 }
 #pragma endregion 
 
+#pragma  region ConnectionDataFragmentPacket
+void ConnectionDataFragmentPacket::Write(Buffer& p_buffer, const ShortSharedKey& sharedKey, const unsigned char* p_fragmentData, const uint16_t p_fragmentSize)
+{
+    p_buffer.Init(Packet::FRAGMENT_HEADER_SIZE + p_fragmentSize + Hash::HMAC::SIZE);
+    p_buffer.WriteInteger(Packet::PROTOCOL_ID);
+    p_buffer.WriteByte(static_cast<uint8_t>(PacketType::CONNECTION_DATA_FRAGMENT));
+    header.Write(p_buffer);
+    p_buffer.WriteByte(channel);
+    p_buffer.WriteShort(messageId);
+    p_buffer.WriteByte(fragmentIndex);
+    p_buffer.WriteByte(fragmentCount);
+    p_buffer.WriteBuffer(p_fragmentData, p_fragmentSize);
+    ConnectionDataPacket::WriteHMAC(p_buffer, sharedKey);
+}
+
+void ConnectionDataFragmentPacket::Read(Buffer& p_buffer)
+{
+    header.Read(p_buffer);
+    channel       = p_buffer.ReadByte();
+    messageId     = p_buffer.ReadShort();
+    fragmentIndex = p_buffer.ReadByte();
+    fragmentCount = p_buffer.ReadByte();
+}
+#pragma endregion 
+
+#pragma  region MtuProbePacket
+void MtuProbePacket::Write(Buffer& p_buffer, const ShortSharedKey& sharedKey)
+{
+    p_buffer.Init(size);
+    p_buffer.WriteInteger(Packet::PROTOCOL_ID);
+    p_buffer.WriteByte(static_cast<uint8_t>(PacketType::MTU_PROBE));
+    p_buffer.WriteShort(id);
+    memset(p_buffer.data + p_buffer.index, 0, size - p_buffer.index - Hash::HMAC::SIZE);
+    p_buffer.index = size - Hash::HMAC::SIZE;
+    ConnectionDataPacket::WriteHMAC(p_buffer, sharedKey);
+}
+
+void MtuProbePacket::Read(Buffer& p_buffer)
+{
+    id   = p_buffer.ReadShort();
+    size = static_cast<uint16_t>(p_buffer.size);
+}
+#pragma endregion 
+
+#pragma  region MtuProbeAckPacket
+void MtuProbeAckPacket::Write(Buffer& p_buffer, const ShortSharedKey& sharedKey)
+{
+    p_buffer.Init(Packet::MTU_PROBE_ACK_PACKET_SIZE + Hash::HMAC::SIZE);
+    p_buffer.WriteInteger(Packet::PROTOCOL_ID);
+    p_buffer.WriteByte(static_cast<uint8_t>(PacketType::MTU_PROBE_ACK));
+    p_buffer.WriteShort(id);
+    p_buffer.WriteShort(size);
+    ConnectionDataPacket::WriteHMAC(p_buffer, sharedKey);
+}
+
+void MtuProbeAckPacket::Read(Buffer& p_buffer)
+{
+    id   = p_buffer.ReadShort();
+    size = p_buffer.ReadShort();
+}
+#pragma endregion 
+
 #pragma  region DisconnectPacket
 void DisconnectPacket::Write(Buffer& p_buffer, const ShortSharedKey& sharedKey)
 {
@@ -0,0 +1,99 @@
+#include "stdafx.h"
+#include "Network/Reliability/CongestionController.h"
+
+void CongestionController::Reset()
+{
+    *this = CongestionController();
+}
+
+void CongestionController::Refill(const clock::time_point p_now)
+{
+    const float elapsed = std::chrono::duration<float>(p_now - m_lastUpdate).count();
+    m_lastUpdate = p_now;
+
+    // Slow start grows from acks instead. A connection that doesn't use its budget gives no information about the path, its rate stays
+    if (!m_slowStart && p_now - m_lastLimited < LIMITED_WINDOW)
+        m_rate = std::min(MAX_RATE, m_rate + ADDITIVE_INCREASE * elapsed);
+
+    const float maxBudget = m_rate * std::chrono::duration<float>(MAX_BURST).count();
+    m_budget = std::min(maxBudget, m_budget + m_rate * elapsed);
+}
+
+void CongestionController::Decrease(const clock::time_point p_now)
+{
+    const clock::duration interval = std::max<clock::duration>(MIN_DECREASE_INTERVAL, m_smoothedRtt);
+    if (p_now - m_lastDecrease < interval)
+        return;
+
+    m_lastDecrease = p_now;
+    m_slowStart = false;
+    m_rate = std::max(MIN_RATE, m_rate * MULTIPLICATIVE_DECREASE);
+}
+
+bool CongestionController::HasBudget(const clock::time_point p_now)
+{
+    Refill(p_now);
+    if (m_budget > 0.0f)
+        return true;
+
+    m_lastLimited = p_now;
+    return false;
+}
+
+void CongestionController::OnPacketSent(const uint32_t p_size)
+{
+    m_budget -= static_cast<float>(p_size);
+}
+
+void CongestionController::OnPacketAcked(const uint32_t p_size, const clock::duration p_rtt, const clock::time_point p_now)
+{
+    if (!m_hasRtt)
+    {
+        m_hasRtt = true;
+        m_smoothedRtt = p_rtt;
+    }
+    else
+    {
+        m_smoothedRtt += std::chrono::duration_cast<clock::duration>((p_rtt - m_smoothedRtt) * RTT_SMOOTHING);
+    }
+
+    // The minimum expires so a route change to a longer path isn't taken for congestion forever
+    if (p_rtt < m_minRtt || m_minRtt == clock::duration::zero() || p_now - m_minRttTime > MIN_RTT_WINDOW)
+    {
+        m_minRtt = p_rtt;
+        m_minRttTime = p_now;
+    }
+
+    if (m_smoothedRtt > m_minRtt + DELAY_THRESHOLD)
+    {
+        Decrease(p_now);
+        return;
+    }
+
+    // Every acked byte adds one byte per RTT, the rate doubles each RTT while the budget is the limit
+    if (m_slowStart && p_now - m_lastLimited < LIMITED_WINDOW)
+    {
+        const float rtt = std::max(std::chrono::duration<float>(m_smoothedRtt).count(), 0.001f);
+        m_rate = std::min(MAX_RATE, m_rate + static_cast<float>(p_size) / rtt);
+    }
+}
+
+void CongestionController::OnPacketLost(const clock::time_point p_now)
+{
+    Decrease(p_now);
+}
+
+float CongestionController::GetSendRate() const
+{
+    return m_rate;
+}
+
+float CongestionController::GetBudget() const
+{
+    return m_budget;
+}
+
+CongestionController::clock::duration CongestionController::GetSmoothedRtt() const
+{
+    return m_smoothedRtt;
+}
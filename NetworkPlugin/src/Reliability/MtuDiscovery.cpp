@@ -0,0 +1,77 @@
+#include "stdafx.h"
+#include "Network/Reliability/MtuDiscovery.h"
+
+void MtuDiscovery::Reset()
+{
+    *this = MtuDiscovery();
+}
+
+bool MtuDiscovery::GetNextProbe(const clock::time_point p_now, const clock::duration p_rtt, uint16_t& o_id, uint16_t& o_size)
+{
+    if (m_complete)
+    {
+        if (p_now - m_completeTime < REPROBE_INTERVAL || m_high == Packet::MAX_PACKET_SIZE)
+            return false;
+        m_complete = false;
+        m_high = Packet::MAX_PACKET_SIZE;
+    }
+
+    if (m_probing)
+    {
+        const clock::duration timeout = std::max<clock::duration>(MIN_PROBE_TIMEOUT, 2 * p_rtt);
+        if (p_now - m_lastProbe < timeout)
+            return false;
+        if (m_attempts >= MAX_ATTEMPTS)
+            OnProbeFailed();
+    }
+
+    if (!m_probing)
+    {
+        if (m_high - m_low < SEARCH_RESOLUTION)
+        {
+            m_complete = true;
+            m_completeTime = p_now;
+            return false;
+        }
+
+        m_probing = true;
+        m_attempts = 0;
+        m_probeSize = m_low < Packet::DEFAULT_PACKET_SIZE && Packet::DEFAULT_PACKET_SIZE <= m_high ? Packet::DEFAULT_PACKET_SIZE : (m_low + m_high + 1) / 2;
+    }
+
+    // Each attempt has its own id so a late ack of a previous attempt isn't mistaken for this one
+    ++m_attempts;
+    m_lastProbe = p_now;
+    o_id = ++m_probeId;
+    o_size = static_cast<uint16_t>(m_probeSize);
+    return true;
+}
+
+void MtuDiscovery::OnProbeAcked(const uint16_t p_id, const uint16_t p_size)
+{
+    // Any probe that got through proves its size, whether it is the current one or not
+    if (p_size > m_high || p_size > Packet::MAX_PACKET_SIZE)
+        return;
+    m_low = std::max<unsigned int>(m_low, p_size);
+
+    if (m_probing && static_cast<uint16_t>(m_probeId - p_id) < MAX_ATTEMPTS && p_size == m_probeSize)
+        m_probing = false;
+}
+
+void MtuDiscovery::OnProbeFailed()
+{
+    if (!m_probing)
+        return;
+    m_probing = false;
+    m_high = std::max(m_low, m_probeSize - 1);
+}
+
+unsigned int MtuDiscovery::GetMaxPacketSize() const
+{
+    return m_high >= Packet::DEFAULT_PACKET_SIZE ? std::max(m_low, Packet::DEFAULT_PACKET_SIZE) : m_low;
+}
+
+bool MtuDiscovery::IsComplete() const
+{
+    return m_complete;
+}
@@ -0,0 +1,87 @@
+#include "stdafx.h"
+#include "Network/Reliability/TimeSync.h"
+
+void TimeSync::Reset()
+{
+    *this = TimeSync();
+}
+
+bool TimeSync::ShouldSend(const uint64_t p_localTime) const
+{
+    return !m_hasSent || p_localTime - m_lastSent >= static_cast<uint64_t>(std::chrono::microseconds(SYNC_INTERVAL).count());
+}
+
+void TimeSync::Write(Buffer& p_buffer, const uint64_t p_localTime)
+{
+    p_buffer.WriteByte(m_hasRemoteTime ? 1 : 0);
+    p_buffer.WriteLongLong(p_localTime);
+    p_buffer.WriteLongLong(m_remoteTime);
+    p_buffer.WriteLongLong(m_remoteReceivedAt);
+    m_lastSent = p_localTime;
+    m_hasSent = true;
+}
+
+void TimeSync::Read(Buffer& p_buffer, const uint64_t p_localTime)
+{
+    const bool hasEcho = p_buffer.ReadByte() != 0;
+    const uint64_t remoteSendTime = p_buffer.ReadLongLong();
+    const uint64_t echo = p_buffer.ReadLongLong();
+    const uint64_t echoReceivedAt = p_buffer.ReadLongLong();
+
+    m_hasRemoteTime = true;
+    m_remoteTime = remoteSendTime;
+    m_remoteReceivedAt = p_localTime;
+
+    // The remote repeats its last echo until it hears from us again, each echo is one sample
+    if (!hasEcho || (m_hasSample && echo == m_lastEcho) || echo > p_localTime || echoReceivedAt > remoteSendTime)
+        return;
+    m_lastEcho = echo;
+
+    const int64_t t0 = static_cast<int64_t>(echo);
+    const int64_t t1 = static_cast<int64_t>(echoReceivedAt);
+    const int64_t t2 = static_cast<int64_t>(remoteSendTime);
+    const int64_t t3 = static_cast<int64_t>(p_localTime);
+    const int64_t rtt = std::max<int64_t>((t3 - t0) - (t2 - t1), 0);
+    const int64_t offset = ((t1 - t0) + (t2 - t3)) / 2;
+
+    if (!m_hasSample)
+    {
+        m_hasSample = true;
+        m_smoothedRtt = static_cast<double>(rtt);
+        m_rttVariance = rtt * 0.5;
+    }
+    else
+    {
+        m_rttVariance = 0.75 * m_rttVariance + 0.25 * std::abs(m_smoothedRtt - rtt);
+        m_smoothedRtt = 0.875 * m_smoothedRtt + 0.125 * rtt;
+    }
+
+    m_samples[m_sampleCount++ % FILTER_SIZE] = { rtt, offset };
+    const Sample* best = &m_samples[0];
+    for (unsigned int i = 1; i < std::min(m_sampleCount, FILTER_SIZE); ++i)
+    {
+        if (m_samples[i].rtt < best->rtt)
+            best = &m_samples[i];
+    }
+    m_offset = best->offset;
+}
+
+bool TimeSync::HasSample() const
+{
+    return m_hasSample;
+}
+
+double TimeSync::GetSmoothedRtt() const
+{
+    return m_smoothedRtt;
+}
+
+double TimeSync::GetRttVariance() const
+{
+    return m_rttVariance;
+}
+
+int64_t TimeSync::GetClockOffset() const
+{
+    return m_offset;
+}
@@ -0,0 +1,95 @@
+#include "stdafx.h"
+#include "Network/Replication/EntityLayout.h"
+
+unsigned int EntityLayout::GetFieldSize(const FieldType p_type)
+{
+    switch (p_type)
+    {
+        case FieldType::INT8:       return 1;
+        case FieldType::INT16:      return 2;
+        case FieldType::INT32:
+        case FieldType::FLOAT32:    return 4;
+        case FieldType::INT64:
+        case FieldType::FLOAT64:    return 8;
+        default:                    return 0;
+    }
+}
+
+bool EntityLayout::Init(const FieldType* p_fields, const unsigned int p_fieldCount)
+{
+    if (p_fieldCount == 0 || p_fieldCount > MAX_FIELDS)
+        return false;
+
+    fields.assign(p_fields, p_fields + p_fieldCount);
+    offsets.clear();
+    size = 0;
+    for (const FieldType field : fields)
+    {
+        const unsigned int fieldSize = GetFieldSize(field);
+        if (fieldSize == 0)
+            return false;
+        offsets.push_back(static_cast<uint16_t>(size));
+        size += fieldSize;
+    }
+    return true;
+}
+
+uint32_t EntityLayout::GetSize(const uint32_t p_mask) const
+{
+    uint32_t maskSize = 0;
+    for (unsigned int i = 0; i < fields.size(); ++i)
+    {
+        if (p_mask & (1u << i))
+            maskSize += GetFieldSize(fields[i]);
+    }
+    return maskSize;
+}
+
+uint32_t EntityLayout::GetFullMask() const
+{
+    return fields.size() == MAX_FIELDS ? 0xFFFFFFFF : (1u << fields.size()) - 1;
+}
+
+void EntityLayout::WriteFields(Buffer& p_buffer, const uint8_t* p_values, const uint32_t p_mask) const
+{
+    for (unsigned int i = 0; i < fields.size(); ++i)
+    {
+        if ((p_mask & (1u << i)) == 0)
+            continue;
+
+        // Values are copied as raw bits so floats survive the byte order swap unchanged
+        const uint8_t* value = p_values + offsets[i];
+        switch (GetFieldSize(fields[i]))
+        {
+            case 1: p_buffer.WriteByte(*value); break;
+            case 2: { uint16_t bits; memcpy(&bits, value, sizeof bits); p_buffer.WriteShort(bits); break; }
+            case 4: { uint32_t bits; memcpy(&bits, value, sizeof bits); p_buffer.WriteInteger(bits); break; }
+            case 8: { uint64_t bits; memcpy(&bits, value, sizeof bits); p_buffer.WriteLongLong(bits); break; }
+        }
+    }
+}
+
+void EntityLayout::ReadFields(Buffer& p_buffer, uint8_t* o_values, const uint32_t p_mask, const uint32_t p_keepMask) const
+{
+    for (unsigned int i = 0; i < fields.size(); ++i)
+    {
+        if ((p_mask & (1u << i)) == 0)
+            continue;
+
+        const unsigned int fieldSize = GetFieldSize(fields[i]);
+        if ((p_keepMask & (1u << i)) == 0)
+        {
+            p_buffer.index += fieldSize;
+            continue;
+        }
+
+        uint8_t* value = o_values + offsets[i];
+        switch (fieldSize)
+        {
+            case 1: *value = p_buffer.ReadByte(); break;
+            case 2: { const uint16_t bits = p_buffer.ReadShort(); memcpy(value, &bits, sizeof bits); break; }
+            case 4: { const uint32_t bits = p_buffer.ReadInteger(); memcpy(value, &bits, sizeof bits); break; }
+            case 8: { const uint64_t bits = p_buffer.ReadLongLong(); memcpy(value, &bits, sizeof bits); break; }
+        }
+    }
+}
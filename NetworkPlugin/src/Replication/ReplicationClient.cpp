@@ -0,0 +1,148 @@
+#include "stdafx.h"
+#include "Network/Replication/ReplicationClient.h"
+
+void ReplicationClient::Reset()
+{
+    m_entities.clear();
+    m_events.clear();
+}
+
+void ReplicationClient::PushEvent(const Event& p_event)
+{
+    if (m_events.size() >= MAX_EVENTS)
+        m_events.pop_front();
+    m_events.push_back(p_event);
+}
+
+bool ReplicationClient::ProcessMessage(const MessageData& p_message)
+{
+    Buffer buffer(static_cast<unsigned int>(p_message->size()));
+    buffer.WriteBuffer(p_message->data(), static_cast<unsigned int>(p_message->size()));
+    buffer.index = 0;
+
+    while (buffer.index < buffer.size)
+    {
+        if (buffer.size - buffer.index < static_cast<int>(EntityLayout::ENTITY_HEADER_SIZE))
+            return false;
+
+        const auto command = static_cast<ReplicationCommand>(buffer.ReadByte());
+        switch (command)
+        {
+            case ReplicationCommand::CREATE:
+                if (!ReadCreate(buffer))
+                    return false;
+                break;
+            case ReplicationCommand::DESTROY:
+            {
+                const uint32_t entityId = buffer.ReadInteger();
+                const auto entity = m_entities.find(entityId);
+                if (entity != m_entities.end())
+                {
+                    PushEvent({ EntityEvent::DESTROYED, entityId, entity->second.type, 0 });
+                    m_entities.erase(entity);
+                }
+                break;
+            }
+            case ReplicationCommand::UPDATE:
+                if (!ReadUpdate(buffer))
+                    return false;
+                break;
+            default:
+                return false;
+        }
+    }
+    return true;
+}
+
+bool ReplicationClient::ReadCreate(Buffer& p_buffer)
+{
+    const uint32_t entityId = p_buffer.ReadInteger();
+    if (p_buffer.size - p_buffer.index < static_cast<int>(sizeof(uint16_t) + sizeof(uint8_t)))
+        return false;
+
+    Entity entity;
+    entity.type = p_buffer.ReadShort();
+    const uint8_t fieldCount = p_buffer.ReadByte();
+    if (p_buffer.size - p_buffer.index < fieldCount)
+        return false;
+
+    std::vector<FieldType> fields(fieldCount);
+    for (auto& field : fields)
+        field = static_cast<FieldType>(p_buffer.ReadByte());
+    if (!entity.layout.Init(fields.data(), fieldCount) || p_buffer.size - p_buffer.index < static_cast<int>(entity.layout.size))
+        return false;
+
+    entity.values.resize(entity.layout.size);
+    entity.fieldSequences.resize(fieldCount);
+    entity.layout.ReadFields(p_buffer, entity.values.data(), entity.layout.GetFullMask());
+    PushEvent({ EntityEvent::CREATED, entityId, entity.type, entity.layout.GetFullMask() });
+    m_entities[entityId] = std::move(entity);
+    return true;
+}
+
+bool ReplicationClient::ReadUpdate(Buffer& p_buffer)
+{
+    const uint32_t entityId = p_buffer.ReadInteger();
+    if (p_buffer.size - p_buffer.index < static_cast<int>(sizeof(uint16_t) + sizeof(uint32_t) + sizeof(uint16_t)))
+        return false;
+    const uint16_t updateSequence = p_buffer.ReadShort();
+    const uint32_t fieldMask = p_buffer.ReadInteger();
+    const uint16_t fieldsSize = p_buffer.ReadShort();
+    if (p_buffer.size - p_buffer.index < fieldsSize)
+        return false;
+
+    // Unreliable updates can arrive after the destruction of their entity
+    const auto entity = m_entities.find(entityId);
+    if (entity == m_entities.end())
+    {
+        p_buffer.index += fieldsSize;
+        return true;
+    }
+
+    Entity& target = entity->second;
+    const EntityLayout& layout = target.layout;
+    if ((fieldMask & ~layout.GetFullMask()) != 0 || layout.GetSize(fieldMask) != fieldsSize)
+        return false;
+
+    // Sequences start at 1 after the creation and stay within half the 16 bits range of each other while in flight
+    const uint32_t sequence = target.sequence + static_cast<int16_t>(static_cast<uint16_t>(updateSequence - static_cast<uint16_t>(target.sequence)));
+    if (static_cast<int32_t>(sequence - target.sequence) > 0)
+        target.sequence = sequence;
+
+    // A field already written by a newer update keeps its value
+    uint32_t appliedMask = 0;
+    for (unsigned int i = 0; i < layout.fields.size(); ++i)
+    {
+        if ((fieldMask & (1u << i)) != 0 && static_cast<int32_t>(sequence - target.fieldSequences[i]) > 0)
+        {
+            appliedMask |= 1u << i;
+            target.fieldSequences[i] = sequence;
+        }
+    }
+
+    layout.ReadFields(p_buffer, target.values.data(), fieldMask, appliedMask);
+    if (appliedMask != 0)
+        PushEvent({ EntityEvent::UPDATED, entityId, target.type, appliedMask });
+    return true;
+}
+
+bool ReplicationClient::PollEvent(Event& o_event)
+{
+    if (m_events.empty())
+        return false;
+
+    o_event = m_events.front();
+    m_events.pop_front();
+    return true;
+}
+
+bool ReplicationClient::GetField(const uint32_t p_entityId, const uint8_t p_field, void* o_value) const
+{
+    const auto entity = m_entities.find(p_entityId);
+    if (entity == m_entities.end() || p_field >= entity->second.layout.fields.size())
+        return false;
+
+    const EntityLayout& layout = entity->second.layout;
+    memcpy(o_value, entity->second.values.data() + layout.offsets[p_field], EntityLayout::GetFieldSize(layout.fields[p_field]));
+    return true;
+}
@@ -0,0 +1,304 @@
+#include "stdafx.h"
+#include "Network/Replication/ReplicationServer.h"
+
+ReplicationServer::ReplicationServer(const unsigned int p_maxClients) : m_clients(p_maxClients)
+{
+}
+
+bool ReplicationServer::IsEnabled() const
+{
+    return m_reliableChannel < Connection::MAX_CHANNELS && m_unreliableChannel < Connection::MAX_CHANNELS;
+}
+
+void ReplicationServer::SetChannels(const uint8_t p_reliableChannel, const uint8_t p_unreliableChannel)
+{
+    m_reliableChannel = p_reliableChannel;
+    m_unreliableChannel = p_unreliableChannel;
+}
+
+bool ReplicationServer::RegisterType(const uint16_t p_type, const FieldType* p_fields, const unsigned int p_fieldCount)
+{
+    EntityLayout layout;
+    if (!layout.Init(p_fields, p_fieldCount))
+        return false;
+    m_layouts[p_type] = std::move(layout);
+    return true;
+}
+
+int64_t ReplicationServer::CreateEntity(const uint16_t p_type)
+{
+    const auto layout = m_layouts.find(p_type);
+    if (layout == m_layouts.end())
+        return -1;
+
+    const uint32_t entityId = m_nextEntityId++;
+    m_entities[entityId] = { p_type, std::vector<uint8_t>(layout->second.size) };
+    for (auto& client : m_clients)
+    {
+        if (client.active)
+        {
+            client.entities[entityId] = {};
+            client.toCreate.push_back(entityId);
+        }
+    }
+    return entityId;
+}
+
+void ReplicationServer::DestroyEntity(const uint32_t p_entityId)
+{
+    if (m_entities.erase(p_entityId) == 0)
+        return;
+
+    for (auto& client : m_clients)
+    {
+        const auto entity = client.entities.find(p_entityId);
+        if (entity == client.entities.end())
+            continue;
+        // An entity the client never heard of doesn't need to be destroyed on its side
+        if (entity->second.state != EntityState::PENDING_CREATE)
+            client.destroyed.push_back(p_entityId);
+        client.entities.erase(entity);
+    }
+}
+
+bool ReplicationServer::SetField(const uint32_t p_entityId, const uint8_t p_field, const void* p_value)
+{
+    const auto entity = m_entities.find(p_entityId);
+    if (entity == m_entities.end())
+        return false;
+
+    const EntityLayout& layout = m_layouts[entity->second.type];
+    if (p_field >= layout.fields.size())
+        return false;
+
+    uint8_t* value = entity->second.values.data() + layout.offsets[p_field];
+    const unsigned int size = EntityLayout::GetFieldSize(layout.fields[p_field]);
+    if (memcmp(value, p_value, size) == 0)
+        return true;
+
+    memcpy(value, p_value, size);
+    for (auto& client : m_clients)
+    {
+        const auto clientEntity = client.entities.find(p_entityId);
+        if (clientEntity != client.entities.end())
+            MarkDirty(client, p_entityId, clientEntity->second, 1u << p_field);
+    }
+    return true;
+}
+
+void ReplicationServer::AddClient(const unsigned int p_clientIndex)
+{
+    ClientView& client = m_clients[p_clientIndex];
+    client = {};
+    client.active = true;
+    client.toCreate.reserve(m_entities.size());
+    for (const auto& entity : m_entities)
+    {
+        client.entities[entity.first] = {};
+        client.toCreate.push_back(entity.first);
+    }
+}
+
+void ReplicationServer::RemoveClient(const unsigned int p_clientIndex)
+{
+    m_clients[p_clientIndex] = {};
+}
+
+void ReplicationServer::MarkDirty(ClientView& p_client, const uint32_t p_entityId, ClientEntity& p_entity, const uint32_t p_mask)
+{
+    // Fields changed before the creation is delivered are listed once it is
+    p_entity.dirtyMask |= p_mask;
+    if (p_entity.state == EntityState::CREATED && p_entity.dirtyMask != 0 && !p_entity.listedDirty)
+    {
+        p_entity.listedDirty = true;
+        p_client.dirty.push_back(p_entityId);
+    }
+}
+
+void ReplicationServer::Update(const unsigned int p_clientIndex, Connection& p_connection)
+{
+    ClientView& client = m_clients[p_clientIndex];
+    if (!IsEnabled() || !client.active)
+        return;
+
+    const clock::time_point now = clock::now();
+    WriteCreations(client, p_connection);
+    ProcessAcks(client, p_connection, now);
+    WriteUpdates(client, p_connection, now);
+}
+
+void ReplicationServer::WriteCreations(ClientView& p_client, Connection& p_connection)
+{
+    size_t destroyed = 0;
+    size_t created = 0;
+    while (true)
+    {
+        // Destructions first, then creations, until the message is full
+        std::vector<uint32_t> batch;
+        uint32_t size = 0;
+        size_t destroyedEnd = destroyed;
+        while (destroyedEnd < p_client.destroyed.size() && size + EntityLayout::ENTITY_HEADER_SIZE <= MAX_MESSAGE_SIZE)
+        {
+            size += EntityLayout::ENTITY_HEADER_SIZE;
+            ++destroyedEnd;
+        }
+
+        size_t createdEnd = created;
+        for (; createdEnd < p_client.toCreate.size(); ++createdEnd)
+        {
+            const uint32_t entityId = p_client.toCreate[createdEnd];
+            if (p_client.entities.find(entityId) == p_client.entities.end())
+                continue;
+            const Entity& source = m_entities[entityId];
+            const EntityLayout& layout = m_layouts[source.type];
+            const uint32_t entitySize = EntityLayout::ENTITY_HEADER_SIZE + sizeof(uint16_t) + sizeof(uint8_t) + static_cast<uint32_t>(layout.fields.size()) + layout.size;
+            if (size > 0 && size + entitySize > MAX_MESSAGE_SIZE)
+                break;
+            size += entitySize;
+            batch.push_back(entityId);
+        }
+
+        if (size == 0)
+        {
+            created = createdEnd;
+            break;
+        }
+
+        Buffer buffer(size);
+        for (size_t i = destroyed; i < destroyedEnd; ++i)
+        {
+            buffer.WriteByte(static_cast<uint8_t>(ReplicationCommand::DESTROY));
+            buffer.WriteInteger(p_client.destroyed[i]);
+        }
+        for (const uint32_t entityId : batch)
+        {
+            const Entity& source = m_entities[entityId];
+            const EntityLayout& layout = m_layouts[source.type];
+            buffer.WriteByte(static_cast<uint8_t>(ReplicationCommand::CREATE));
+            buffer.WriteInteger(entityId);
+            buffer.WriteShort(source.type);
+            buffer.WriteByte(static_cast<uint8_t>(layout.fields.size()));
+            for (const FieldType field : layout.fields)
+                buffer.WriteByte(static_cast<uint8_t>(field));
+            layout.WriteFields(buffer, source.values.data(), layout.GetFullMask());
+        }
+
+        uint16_t messageId;
+        if (!p_connection.QueueMessage(m_reliableChannel, std::make_shared<const std::vector<uint8_t>>(buffer.data, buffer.data + buffer.size), &messageId))
+            break;
+
+        // The creation carries every field, changes made until then are already on their way
+        for (const uint32_t entityId : batch)
+            p_client.entities[entityId] = { EntityState::CREATING, messageId };
+        if (!batch.empty())
+            p_client.creations.push_back({ messageId, std::move(batch) });
+        destroyed = destroyedEnd;
+        created = createdEnd;
+    }
+    p_client.destroyed.erase(p_client.destroyed.begin(), p_client.destroyed.begin() + destroyed);
+    p_client.toCreate.erase(p_client.toCreate.begin(), p_client.toCreate.begin() + created);
+}
+
+void ReplicationServer::ProcessAcks(ClientView& p_client, const Connection& p_connection, const clock::time_point p_now)
+{
+    // Reliable messages are delivered in order, the first creation still on its way holds back the next ones
+    size_t delivered = 0;
+    for (; delivered < p_client.creations.size(); ++delivered)
+    {
+        const PendingCreation& creation = p_client.creations[delivered];
+        if (!p_connection.IsMessageDelivered(m_reliableChannel, creation.messageId))
+            break;
+        for (const uint32_t entityId : creation.entities)
+        {
+            const auto entity = p_client.entities.find(entityId);
+            if (entity == p_client.entities.end())
+                continue;
+            entity->second.state = EntityState::CREATED;
+            MarkDirty(p_client, entityId, entity->second, 0);
+        }
+    }
+    p_client.creations.erase(p_client.creations.begin(), p_client.creations.begin() + delivered);
+
+    auto update = p_client.pending.begin();
+    while (update != p_client.pending.end())
+    {
+        // An acked update may still have been dropped by a sequenced channel
+        const bool acked = p_connection.IsMessageAcked(m_unreliableChannel, update->messageId);
+        if (acked && p_connection.IsMessageDelivered(m_unreliableChannel, update->messageId))
+        {
+            update = p_client.pending.erase(update);
+            continue;
+        }
+        if (!acked && p_now - update->sent < UPDATE_TIMEOUT)
+        {
+            ++update;
+            continue;
+        }
+
+        // Considered lost, the current values of its fields will be sent again
+        for (const auto& fields : update->fields)
+        {
+            const auto entity = p_client.entities.find(fields.first);
+            if (entity != p_client.entities.end())
+                MarkDirty(p_client, fields.first, entity->second, fields.second);
+        }
+        update = p_client.pending.erase(update);
+    }
+}
+
+void ReplicationServer::WriteUpdates(ClientView& p_client, Connection& p_connection, const clock::time_point p_now)
+{
+    size_t written = 0;
+    while (written < p_client.dirty.size())
+    {
+        PendingUpdate update { 0, p_now };
+        uint32_t size = 0;
+        size_t writtenEnd = written;
+        for (; writtenEnd < p_client.dirty.size(); ++writtenEnd)
+        {
+            const uint32_t entityId = p_client.dirty[writtenEnd];
+            const auto clientEntity = p_client.entities.find(entityId);
+            if (clientEntity == p_client.entities.end())
+                continue;
+            const EntityLayout& layout = m_layouts[m_entities[entityId].type];
+            const uint32_t entitySize = EntityLayout::UPDATE_HEADER_SIZE + layout.GetSize(clientEntity->second.dirtyMask);
+            if (size > 0 && size + entitySize > MAX_MESSAGE_SIZE)
+                break;
+            size += entitySize;
+            update.fields.emplace_back(entityId, clientEntity->second.dirtyMask);
+        }
+
+        if (size == 0)
+        {
+            written = writtenEnd;
+            break;
+        }
+
+        Buffer buffer(size);
+        for (const auto& fields : update.fields)
+        {
+            const Entity& source = m_entities[fields.first];
+            buffer.WriteByte(static_cast<uint8_t>(ReplicationCommand::UPDATE));
+            buffer.WriteInteger(fields.first);
+            buffer.WriteShort(static_cast<uint16_t>(p_client.entities[fields.first].updateSequence + 1));
+            buffer.WriteInteger(fields.second);
+            const EntityLayout& layout = m_layouts[source.type];
+            buffer.WriteShort(static_cast<uint16_t>(layout.GetSize(fields.second)));
+            layout.WriteFields(buffer, source.values.data(), fields.second);
+        }
+
+        if (!p_connection.QueueMessage(m_unreliableChannel, std::make_shared<const std::vector<uint8_t>>(buffer.data, buffer.data + buffer.size), &update.messageId))
+            break;
+
+        for (const auto& fields : update.fields)
+        {
+            ClientEntity& clientEntity = p_client.entities[fields.first];
+            clientEntity.dirtyMask = 0;
+            clientEntity.listedDirty = false;
+            ++clientEntity.updateSequence;
+        }
+        p_client.pending.push_back(std::move(update));
+        written = writtenEnd;
+    }
+    p_client.dirty.erase(p_client.dirty.begin(), p_client.dirty.begin() + written);
+}
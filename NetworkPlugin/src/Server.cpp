@@ -2,12 +2,14 @@
 #include "Network/Server.h"
 #include "Network/Packets/Buffer.h"
 #include "Network/Packets/Packet.h"
+#include "Network/Tracing/Tracer.h"
+#include "Network/Logging/Logger.h"
 
 using namespace Cryptography;
 
 Server::Server()
 {
-    if (!m_socket.Open(SERVER_PORT))
+    if (!m_socket.Open(SERVER_PORT) || !m_socket.SetDontFragment(true))
         g_debugCallback("Unable to open server socket");
 
     m_connected[0] = true;
@@ -83,6 +85,16 @@ int Server::FindExistingChallengeIndex(const Address& p_address) const
     return -1;
 }
 
+void Server::ResolveSharedKey(ChallengeInfo& p_challenge)
+{
+    if (!p_challenge.sharedKeyFuture.valid())
+        return;
+
+    NETWORK_TRACE_ZONE("Handshake::WaitSharedKey");
+    p_challenge.sharedKey = p_challenge.sharedKeyFuture.get();
+    m_socket.OnSessionKey(p_challenge.clientAddress, p_challenge.sharedKey);
+}
+
 bool Server::IsClientConnected(const unsigned int p_clientIndex) const
 {
     if (p_clientIndex > MAX_CLIENTS)
@@ -100,113 +112,236 @@ const Server::ConnectionInfo& Server::GetClientConnectionInfo(unsigned int p_cli
 }
 
 
-int Server::Listen(unsigned char* o_gameData, const unsigned int p_size)
+int Server::Listen(unsigned char* o_gameData, const unsigned int p_size, uint8_t* o_channel)
 {
+    NETWORK_TRACE_ZONE("Server::Listen");
     try
     {
-        Buffer buffer(1024);
-        Address sender;
-        buffer.size = m_socket.Receive(sender, buffer.data, buffer.size);
+        ReceivePacket();
+        SendPendingPackets();
+        return ReceiveMessage(o_gameData, p_size, o_channel);
+    }
+    catch(std::exception& e)
+    {
+        NETWORK_LOG(FAILURE, "{}", e.what());
+    }
+    return 0;
+}
 
-        PacketType packetType = PacketType::INVALID_PACKET;
-        auto connectionIndex = FindExistingConnectionIndex(sender);
-        if (connectionIndex > 0)
+void Server::ReceivePacket()
+{
+    NETWORK_TRACE_ZONE("Server::ReceivePacket");
+    Buffer buffer(Packet::MAX_PACKET_SIZE);
+    Address sender;
+    buffer.size = m_socket.Receive(sender, buffer.data, buffer.size);
+
+    PacketType packetType = PacketType::INVALID_PACKET;
+    auto connectionIndex = FindExistingConnectionIndex(sender);
+    if (connectionIndex > 0)
+    {
+        Connection& connection = m_connections[connectionIndex].connection;
+        connection.OnDatagramReceived(static_cast<uint32_t>(buffer.size));
+        const clock::time_point verifyStart = clock::now();
+        packetType = Packet::VerifyPacketHMAC(m_connections[connectionIndex].sharedKey, buffer);
+        m_latencies[static_cast<size_t>(LatencyMetric::HMAC_VERIFY)].Record(clock::now() - verifyStart);
+        if (packetType == PacketType::INVALID_PACKET)
+            connection.OnAuthenticationFailed();
+    }
+    else
+    {
+        auto challengeIndex = FindExistingChallengeIndex(sender);
+        if (challengeIndex < 0)
         {
-            packetType = Packet::VerifyPacketHMAC(m_connections[connectionIndex].sharedKey, buffer);
+            if (Packet::VerifyPacketCRC(buffer) != PacketType::CONNECTION_REQUEST)
+            {
+                if (buffer.size > 0)
+                    ++m_checksumFailures;
+                return;
+            }
+            else
+            {
+                packetType = PacketType::CONNECTION_REQUEST;
+            }
         }
         else
         {
-            auto challengeIndex = FindExistingChallengeIndex(sender);
-            if (challengeIndex < 0)
+            auto& challenge = m_challenges[challengeIndex];
+            ResolveSharedKey(challenge);
+            packetType = Packet::VerifyPacketHMAC(challenge.sharedKey, buffer);
+            // The client resends its request until the challenge reaches it
+            if (packetType == PacketType::INVALID_PACKET)
             {
-                if (Packet::VerifyPacketCRC(buffer) != PacketType::CONNECTION_REQUEST)
-                {
-                    return 0;
-                }
-                else
-                {
+                buffer.index = 0;
+                if (Packet::VerifyPacketCRC(buffer) == PacketType::CONNECTION_REQUEST)
                     packetType = PacketType::CONNECTION_REQUEST;
-                }
+                else
+                    ++m_checksumFailures;
             }
-            else
+        }
+    }
+    
+    switch (packetType) 
+    {
+        case PacketType::CONNECTION_REQUEST:
+        {
+            if(m_state.load() == ServerState::LOBBY)
             {
-                auto& challenge = m_challenges[challengeIndex];
-                if (challenge.sharedKeyFuture.valid())
-                {
-                    challenge.sharedKey = challenge.sharedKeyFuture.get();
-                }
-                packetType = Packet::VerifyPacketHMAC(challenge.sharedKey, buffer);
+                ConnectionRequestPacket connectionRequestInfo{};
+                connectionRequestInfo.Read(buffer);
+                HandlePacket(connectionRequestInfo, sender);
             }
+            break;
         }
-        
-        switch (packetType) 
+        case PacketType::CHALLENGE_RESPONSE: 
         {
-            case PacketType::CONNECTION_REQUEST:
+            if(m_state.load() == ServerState::LOBBY)
             {
-                if(m_state.load() == ServerState::LOBBY)
-                {
-                    ConnectionRequestPacket connectionRequestInfo{};
-                    connectionRequestInfo.Read(buffer);
-                    HandlePacket(connectionRequestInfo, sender);
-                }
-                break;
+                ChallengeResponsePacket challengeResponseInfo{};
+                challengeResponseInfo.Read(buffer);
+                HandlePacket(challengeResponseInfo, sender);
             }
-            case PacketType::CHALLENGE_RESPONSE: 
+            break;
+        }
+        case PacketType::CONNECTION_DATA:
+        {
+            if(m_state.load() == ServerState::GAME)
             {
-                if(m_state.load() == ServerState::LOBBY)
-                {
-                    ChallengeResponsePacket challengeResponseInfo{};
-                    challengeResponseInfo.Read(buffer);
-                    HandlePacket(challengeResponseInfo, sender);
-                }
-                break;
+                const int clientIdx = FindExistingConnectionIndex(sender);
+                if (clientIdx > 0)
+                    m_connections[clientIdx].connection.ReadPacket(buffer);
             }
-            case PacketType::CONNECTION_DATA:
+            break;
+        }
+        case PacketType::CONNECTION_DATA_FRAGMENT:
+        {
+            if(m_state.load() == ServerState::GAME)
             {
-                if(m_state.load() == ServerState::GAME)
-                {
-                    ConnectionDataPacket connectionDataInfo{};
-                    connectionDataInfo.Read(buffer);
-                    const int clientIdx = FindExistingConnectionIndex(sender);
-                    if (clientIdx > 0)
-                    {
-                        if(static_cast<int>(p_size) >= buffer.size + sizeof(int))
-                        {
-                            *reinterpret_cast<int*>(o_gameData) = clientIdx;
-                            memcpy(o_gameData + sizeof(int), connectionDataInfo.gameData, connectionDataInfo.gameDataSize);
-                            return connectionDataInfo.gameDataSize;
-                        }
-                        else
-                        {
-                            g_debugCallback("Buffer too small for Game Data");
-                            return -1;
-                        }
-                    }
-                }
-                break;
+                const int clientIdx = FindExistingConnectionIndex(sender);
+                if (clientIdx > 0)
+                    m_connections[clientIdx].connection.ReadFragment(buffer);
             }
-            case PacketType::DISCONNECT: 
+            break;
+        }
+        case PacketType::MTU_PROBE:
+        {
+            const int clientIdx = FindExistingConnectionIndex(sender);
+            if (clientIdx > 0)
             {
-                DisconnectPacket disconnectInfo{};
-                disconnectInfo.Read(buffer);
-                const int clientIdx = FindExistingConnectionIndex(sender);
-                const int clientChallIdx = FindExistingChallengeIndex(sender);
-                if ((clientIdx > 0) || 
-                    (clientChallIdx > 0))
-                    RemoveClient(sender);
-                break;
+                MtuProbePacket probeInfo{};
+                probeInfo.Read(buffer);
+                Buffer packet;
+                MtuProbeAckPacket { probeInfo.id, probeInfo.size }.Write(packet, m_connections[clientIdx].sharedKey);
+                if (!m_socket.Send(sender, packet.data, packet.size))
+                    NETWORK_LOG(WARNING, "Server failed to send MtuProbeAck packet");
             }
-            default: return 0;
+            break;
+        }
+        case PacketType::MTU_PROBE_ACK:
+        {
+            const int clientIdx = FindExistingConnectionIndex(sender);
+            if (clientIdx > 0)
+            {
+                MtuProbeAckPacket ackInfo{};
+                ackInfo.Read(buffer);
+                m_connections[clientIdx].connection.OnMtuProbeAcked(ackInfo);
+            }
+            break;
+        }
+        case PacketType::DISCONNECT: 
+        {
+            DisconnectPacket disconnectInfo{};
+            disconnectInfo.Read(buffer);
+            const int clientIdx = FindExistingConnectionIndex(sender);
+            const int clientChallIdx = FindExistingChallengeIndex(sender);
+            if ((clientIdx > 0) || 
+                (clientChallIdx > 0))
+                RemoveClient(sender);
+            break;
         }
-        CheckForTimeouts();
+        default: return;
     }
-    catch(std::exception& e)
+    CheckForTimeouts();
+}
+
+void Server::SendPendingPackets()
+{
+    for (int i = 1; i < MAX_CLIENTS; ++i)
+    {
+        if (!m_connected[i])
+            continue;
+        m_replication.Update(i, m_connections[i].connection);
+        SendPendingPackets(m_connections[i]);
+    }
+}
+
+void Server::SendPendingPackets(ConnectionInfo& p_connectionInfo)
+{
+    NETWORK_TRACE_ZONE("Server::SendPendingPackets");
+    Buffer probe;
+    if (p_connectionInfo.connection.WriteMtuProbe(probe, p_connectionInfo.sharedKey) &&
+        !m_socket.Send(p_connectionInfo.clientAddress, probe.data, probe.size))
+        p_connectionInfo.connection.OnMtuProbeFailed();
+
+    while (true)
+    {
+        Buffer packet;
+        if (!p_connectionInfo.connection.WriteNextPacket(packet, p_connectionInfo.sharedKey))
+            return;
+        if (!m_socket.Send(p_connectionInfo.clientAddress, packet.data, packet.size))
+            NETWORK_LOG(WARNING, "Server failed to send GameData packet");
+    }
+}
+
+int Server::ReceiveMessage(unsigned char* o_gameData, const unsigned int p_size, uint8_t* o_channel)
+{
+    for (int n = 0; n < MAX_CLIENTS; ++n)
     {
-        g_debugCallback(e.what());
+        // Round robin so a chatty client can't starve the others
+        const int clientIdx = (m_nextReceiveIndex + n) % MAX_CLIENTS;
+        if (clientIdx == 0 || !m_connected[clientIdx])
+            continue;
+
+        // Input messages are unpacked into the inputs they carry, each new tick is returned on its own
+        ConnectionInfo& connectionInfo = m_connections[clientIdx];
+        uint8_t channel;
+        MessageData data;
+        uint32_t tick;
+        clock::time_point arrival;
+        bool isInput = false;
+        while (!(isInput = connectionInfo.inputs.Receive(tick, data)) && connectionInfo.connection.ReceiveMessage(channel, data, &arrival))
+        {
+            m_latencies[static_cast<size_t>(LatencyMetric::DELIVERY)].Record(clock::now() - arrival);
+            if (channel != m_inputChannel)
+                break;
+            if (!connectionInfo.inputs.Decode(data))
+                NETWORK_LOG(WARNING, "Malformed input message");
+            data = nullptr;
+        }
+        if (data == nullptr)
+            continue;
+
+        m_nextReceiveIndex = clientIdx + 1;
+        const unsigned int prefixSize = isInput ? sizeof(int) + sizeof(uint32_t) : sizeof(int);
+        if (p_size < data->size() + prefixSize)
+        {
+            NETWORK_LOG(WARNING, "Buffer too small for Game Data");
+            return -1;
+        }
+        *reinterpret_cast<int*>(o_gameData) = clientIdx;
+        if (isInput)
+        {
+            *reinterpret_cast<uint32_t*>(o_gameData + sizeof(int)) = tick;
+            channel = m_inputChannel;
+        }
+        memcpy(o_gameData + prefixSize, data->data(), data->size());
+        if (o_channel != nullptr)
+            *o_channel = channel;
+        return static_cast<int>(data->size() + prefixSize - sizeof(int));
     }
     return 0;
 }
 
+
 int Server::GetConnectedClientCount() const
 {
     return m_numConnections;
@@ -233,33 +368,348 @@ void Server::RegisterDebugCallback(ClientConnectCallback p_callback)
         m_clientConnectCallback = p_callback;
 }
 
+void Server::RegisterPacketAckedCallback(PacketAckedCallback p_callback)
+{
+    m_packetAckedCallback = p_callback;
+    for (auto& connectionInfo : m_connections)
+        connectionInfo.connection.SetPacketAckedCallback(p_callback);
+}
+
+uint16_t Server::GetLastSentSequence(const unsigned int p_clientIndex) const
+{
+    return GetClientConnectionInfo(p_clientIndex).connection.GetLastSentSequence();
+}
+
+double Server::GetTime() const
+{
+    return std::chrono::duration<double>(clock::now() - m_startTime).count();
+}
+
+double Server::GetClientRoundTripTime(const unsigned int p_clientIndex) const
+{
+    if (p_clientIndex >= MAX_CLIENTS || !m_connected[p_clientIndex] || !m_connections[p_clientIndex].connection.HasTimeSync())
+        return -1.0;
+    return m_connections[p_clientIndex].connection.GetRoundTripTime();
+}
+
+bool Server::GetConnectionStats(const unsigned int p_clientIndex, ConnectionStats& o_stats) const
+{
+    if (p_clientIndex == 0 || p_clientIndex >= MAX_CLIENTS || !m_connected[p_clientIndex])
+        return false;
+    o_stats = m_connections[p_clientIndex].connection.GetStats();
+    return true;
+}
+
+void Server::GetStats(ServerStats& o_stats) const
+{
+    o_stats = {};
+    o_stats.connectedClients = static_cast<uint64_t>(m_numConnections);
+    o_stats.packetsSent = m_socket.GetPacketsSent();
+    o_stats.packetsReceived = m_socket.GetPacketsReceived();
+    o_stats.bytesSent = m_socket.GetBytesSent();
+    o_stats.bytesReceived = m_socket.GetBytesReceived();
+    o_stats.authenticationFailures = m_departedStats.authenticationFailures;
+    o_stats.checksumFailures = m_departedStats.checksumFailures + m_checksumFailures;
+    o_stats.outOfOrderPackets = m_departedStats.outOfOrderPackets;
+    o_stats.duplicatePackets = m_departedStats.duplicatePackets;
+    o_stats.ackedPackets = m_departedStats.ackedPackets;
+    o_stats.lostPackets = m_departedStats.lostPackets;
+
+    double roundTripTimes = 0.0;
+    unsigned int measuredClients = 0;
+    unsigned int clients = 0;
+    for (int i = 1; i < MAX_CLIENTS; ++i)
+    {
+        if (!m_connected[i])
+            continue;
+        const ConnectionStats stats = m_connections[i].connection.GetStats();
+        o_stats.authenticationFailures += stats.authenticationFailures;
+        o_stats.checksumFailures += stats.checksumFailures;
+        o_stats.outOfOrderPackets += stats.outOfOrderPackets;
+        o_stats.duplicatePackets += stats.duplicatePackets;
+        o_stats.ackedPackets += stats.ackedPackets;
+        o_stats.lostPackets += stats.lostPackets;
+        o_stats.lossRate += stats.lossRate;
+        o_stats.sendRate += stats.sendRate;
+        ++clients;
+        if (stats.roundTripTime >= 0.0)
+        {
+            roundTripTimes += stats.roundTripTime;
+            ++measuredClients;
+        }
+    }
+    if (clients > 0)
+        o_stats.lossRate /= clients;
+    if (measuredClients > 0)
+        o_stats.averageRoundTripTime = roundTripTimes / measuredClients;
+}
+
+bool Server::GetLatencySummary(const LatencyMetric p_metric, LatencySummary& o_summary) const
+{
+    if (p_metric >= LatencyMetric::COUNT)
+        return false;
+    m_latencies[static_cast<size_t>(p_metric)].GetSummary(o_summary);
+    return true;
+}
+
+double Server::GetLatencyPercentile(const LatencyMetric p_metric, const double p_percentile) const
+{
+    if (p_metric >= LatencyMetric::COUNT)
+        return -1.0;
+    return m_latencies[static_cast<size_t>(p_metric)].GetPercentile(p_percentile);
+}
+
+void Server::ResetLatencies()
+{
+    for (auto& histogram : m_latencies)
+        histogram.Reset();
+}
+
+bool Server::StartCapture(const char* p_path)
+{
+    return m_socket.StartCapture(p_path);
+}
 
-void Server::PropagateGameData(unsigned char* p_buffer, unsigned int p_size)
+void Server::StopCapture()
 {
+    m_socket.StopCapture();
+}
+
+bool Server::StartReplay(const char* p_path, const bool p_realTime)
+{
+    return m_socket.StartReplay(p_path, p_realTime);
+}
+
+void Server::StopReplay()
+{
+    m_socket.StopReplay();
+}
+
+bool Server::IsReplayFinished() const
+{
+    return m_socket.IsReplayFinished();
+}
+
+void Server::SetNetworkConditions(const NetworkConditions& p_conditions)
+{
+    m_socket.SetNetworkConditions(p_conditions);
+}
+
+void Server::SetCompression(const bool p_enabled, const uint8_t* p_dictionary, const unsigned int p_dictionarySize)
+{
+    m_compressor = p_enabled ? std::make_shared<const LZCompressor>(p_dictionary, p_dictionarySize) : nullptr;
+    for (auto& connectionInfo : m_connections)
+        connectionInfo.connection.SetCompressor(m_compressor);
+}
+
+void Server::Flush()
+{
+    const clock::time_point start = clock::now();
+    SendPendingPackets();
+    m_latencies[static_cast<size_t>(LatencyMetric::FAN_OUT)].Record(clock::now() - start);
+}
+
+void Server::ConfigureChannel(const uint8_t p_channel, const ChannelMode p_mode)
+{
+    if (p_channel >= Connection::MAX_CHANNELS)
+    {
+        g_debugCallback("Channel index out of range");
+        return;
+    }
+    if (p_mode > ChannelMode::RELIABLE_ORDERED)
+    {
+        g_debugCallback("Invalid channel mode");
+        return;
+    }
+    m_channelModes[p_channel] = p_mode;
+    for (auto& connectionInfo : m_connections)
+        connectionInfo.connection.ConfigureChannel(p_channel, p_mode);
+}
+
+void Server::SetChannelParity(const uint8_t p_channel, const uint8_t p_groupSize)
+{
+    if (p_channel >= Connection::MAX_CHANNELS)
+    {
+        g_debugCallback("Channel index out of range");
+        return;
+    }
+    m_parityGroupSizes[p_channel] = p_groupSize;
+    for (auto& connectionInfo : m_connections)
+        connectionInfo.connection.SetParityGroupSize(p_channel, p_groupSize);
+}
+
+void Server::PropagateGameData(unsigned char* p_buffer, unsigned int p_size, const uint8_t p_channel)
+{
+    NETWORK_TRACE_ZONE("Server::PropagateGameData");
+    if (p_channel >= Connection::MAX_CHANNELS || p_size > Packet::MAX_MESSAGE_SIZE)
+    {
+        g_debugCallback("Invalid channel or Game Data too large");
+        return;
+    }
+    const clock::time_point start = clock::now();
+
+    const bool needsFragmentation = Packet::CONNECTION_DATA_PACKET_SIZE + ConnectionDataPacket::GetMessageHeaderSize(p_size) + p_size + Hash::HMAC::SIZE > Packet::MAX_PACKET_SIZE;
+    if (m_channelModes[p_channel] == ChannelMode::RELIABLE_ORDERED || m_parityGroupSizes[p_channel] > 0 || needsFragmentation ||
+        p_size <= MAX_AGGREGATED_SIZE)
+    {
+        // Queued messages are coalesced into shared datagrams on the next flush, the payload is shared between connections
+        const MessageData message = std::make_shared<const std::vector<uint8_t>>(p_buffer, p_buffer + p_size);
+        for (int i = 1; i < MAX_CLIENTS; i++)
+        {
+            if (m_connected[i] && !m_connections[i].connection.QueueMessage(p_channel, message))
+                NETWORK_LOG(WARNING, "Send queue full for client:{}", i);
+        }
+        m_latencies[static_cast<size_t>(LatencyMetric::FAN_OUT)].Record(clock::now() - start);
+        return;
+    }
+
+    // Payload is serialized once, only the message id, the sequence and the HMAC differ between clients.
+    // Compression hides the message id, compressed payloads are serialized for each client
+    Buffer sharedPacket;
+    if (m_compressor == nullptr)
+        ConnectionDataPacket::WriteShared(sharedPacket, p_channel, 0, p_buffer, static_cast<uint16_t>(p_size));
+
     for (int i = 1; i < MAX_CLIENTS; i++)
     {
         if(m_connected[i])
         {
             ConnectionInfo& connectionInfo = m_connections[i];
-            Buffer packet;
-            ConnectionDataPacket packetInfo{++connectionInfo.sequence, p_size,  new unsigned char[p_size]};
-            memcpy(packetInfo.gameData, p_buffer, p_size);
-            packetInfo.Write(packet, connectionInfo.sharedKey);
+            const uint16_t messageId = connectionInfo.connection.TakeMessageId(p_channel);
+            Buffer clientPacket;
+            if (m_compressor != nullptr)
+                ConnectionDataPacket::WriteShared(clientPacket, p_channel, messageId, p_buffer, static_cast<uint16_t>(p_size), m_compressor.get());
+            else
+                ConnectionDataPacket::WriteMessageId(sharedPacket, messageId);
+            Buffer& packet = m_compressor != nullptr ? clientPacket : sharedPacket;
+
+            // Clients behind a smaller path MTU get the message fragmented through their queue
+            if (packet.size + Hash::HMAC::SIZE > connectionInfo.connection.GetMaxPacketSize())
+            {
+                if (!connectionInfo.connection.QueueMessage(p_channel, std::make_shared<const std::vector<uint8_t>>(p_buffer, p_buffer + p_size)))
+                    NETWORK_LOG(WARNING, "Send queue full for client:{}", i);
+                continue;
+            }
+            // Queued messages leave first, a sequenced channel would otherwise drop them as older than this packet
+            SendPendingPackets(connectionInfo);
+            // Unreliable data over the budget of a slow client is dropped rather than queued behind the link
+            if (!connectionInfo.connection.HasSendBudget())
+                continue;
 
-            if(!m_socket.Send(connectionInfo.clientAddress, packet.data, packet.size))
+            const SequenceHeader header = connectionInfo.connection.GenerateSendHeader();
+            connectionInfo.connection.OnMessageSent(header.sequence, p_channel, messageId);
+            ConnectionDataPacket::WriteSequenceHeader(packet, header);
+            auto hmac = Hash::HMAC::HMAC_SHA256(connectionInfo.sharedKey.data(), connectionInfo.sharedKey.size(), packet.data, packet.size);
+
+            const WSABUF buffers[2] {
+                { static_cast<ULONG>(packet.size), reinterpret_cast<CHAR*>(packet.data) },
+                { static_cast<ULONG>(hmac.size()), reinterpret_cast<CHAR*>(hmac.data()) }
+            };
+            if(!m_socket.Send(connectionInfo.clientAddress, buffers, 2))
             {
-                g_debugCallback(std::string("Server failed to send GameData packet to client:" + std::to_string(i)).c_str());
+                NETWORK_LOG(WARNING, "Server failed to send GameData packet to client:{}", i);
             }
+            connectionInfo.connection.OnPacketSent(header.sequence, packet.size + static_cast<uint32_t>(hmac.size()));
         }
     }
+    m_latencies[static_cast<size_t>(LatencyMetric::FAN_OUT)].Record(clock::now() - start);
+}
+
+void Server::SetSnapshotChannel(const uint8_t p_channel)
+{
+    if (p_channel >= Connection::MAX_CHANNELS)
+    {
+        g_debugCallback("Channel index out of range");
+        return;
+    }
+    m_snapshotChannel = p_channel;
+    for (auto& connectionInfo : m_connections)
+        connectionInfo.snapshots.Reset();
+}
+
+void Server::PropagateSnapshot(const unsigned char* p_buffer, const unsigned int p_size)
+{
+    if (m_snapshotChannel >= Connection::MAX_CHANNELS || p_size > Packet::MAX_MESSAGE_SIZE - SnapshotHeader::SIZE)
+    {
+        g_debugCallback("Snapshot channel not set or Snapshot too large");
+        return;
+    }
+
+    const MessageData snapshot = std::make_shared<const std::vector<uint8_t>>(p_buffer, p_buffer + p_size);
+    const uint16_t snapshotId = m_snapshotSequence++;
+    const uint32_t serverTime = static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::milliseconds>(clock::now() - m_startTime).count());
+    for (int i = 1; i < MAX_CLIENTS; i++)
+    {
+        if (!m_connected[i])
+            continue;
+
+        ConnectionInfo& connectionInfo = m_connections[i];
+        uint16_t ackedMessage;
+        const bool hasAck = connectionInfo.connection.GetLastAckedMessage(m_snapshotChannel, ackedMessage);
+        uint16_t messageId;
+        if (connectionInfo.connection.QueueMessage(m_snapshotChannel, connectionInfo.snapshots.Encode(snapshotId, serverTime, snapshot, hasAck, ackedMessage), &messageId))
+            connectionInfo.snapshots.Store(snapshotId, snapshot, messageId);
+        else
+            NETWORK_LOG(WARNING, "Send queue full for client:{}", i);
+    }
+}
+
+void Server::SetInputChannel(const uint8_t p_channel)
+{
+    if (p_channel >= Connection::MAX_CHANNELS)
+    {
+        g_debugCallback("Channel index out of range");
+        return;
+    }
+    m_inputChannel = p_channel;
+    for (auto& connectionInfo : m_connections)
+        connectionInfo.inputs.Reset();
+}
+
+void Server::SetReplicationChannels(const uint8_t p_reliableChannel, const uint8_t p_unreliableChannel)
+{
+    if (p_reliableChannel >= Connection::MAX_CHANNELS || p_unreliableChannel >= Connection::MAX_CHANNELS)
+    {
+        g_debugCallback("Channel index out of range");
+        return;
+    }
+    m_replication.SetChannels(p_reliableChannel, p_unreliableChannel);
+}
+
+bool Server::RegisterEntityType(const uint16_t p_type, const FieldType* p_fields, const unsigned int p_fieldCount)
+{
+    if (!m_replication.RegisterType(p_type, p_fields, p_fieldCount))
+    {
+        g_debugCallback("Invalid entity type fields");
+        return false;
+    }
+    return true;
+}
+
+int64_t Server::CreateEntity(const uint16_t p_type)
+{
+    const int64_t entityId = m_replication.CreateEntity(p_type);
+    if (entityId < 0)
+        g_debugCallback("Unknown entity type");
+    return entityId;
+}
+
+void Server::DestroyEntity(const uint32_t p_entityId)
+{
+    m_replication.DestroyEntity(p_entityId);
+}
+
+bool Server::SetEntityField(const uint32_t p_entityId, const uint8_t p_field, const void* p_value)
+{
+    return m_replication.SetField(p_entityId, p_field, p_value);
 }
 
 void Server::HandlePacket(const ConnectionRequestPacket& p_packet, const Address& p_sender)
 {
+    NETWORK_TRACE_ZONE("Handshake::ConnectionRequest");
     int challIndex = FindExistingChallengeIndex(p_sender);
     if(challIndex < 0)
     {
-        if((challIndex = FindFreeChallengeIndex() >= 0))
+        if((challIndex = FindFreeChallengeIndex()) >= 0)
         {
             m_challenges[challIndex] = { p_sender, p_packet.clientPublicKey };
             KeyExchange::DiffieHellman::GenerateKeyPair(m_challenges[challIndex].serverPrivateKey, m_challenges[challIndex].serverPublicKey);
@@ -267,30 +717,35 @@ void Server::HandlePacket(const ConnectionRequestPacket& p_packet, const Address
         }
         else
         {
-            g_debugCallback("Server full, connection denied");
+            NETWORK_LOG(WARNING, "Server full, connection denied");
             return;
         }
+
+        // The keys are copied, the challenge slot can be reset while the shared key is computed
+        ChallengeInfo& newChallenge = m_challenges[challIndex];
+        newChallenge.sharedKeyFuture = std::async(std::launch::async, [clientPublicKey = newChallenge.clientPublicKey, serverPrivateKey = newChallenge.serverPrivateKey]() mutable
+        { 
+            NETWORK_TRACE_ZONE("Handshake::GenerateSharedKey");
+            auto sharedKey = KeyExchange::DiffieHellman::GenerateSharedKey(clientPublicKey, serverPrivateKey); 
+            return Hash::SHA256().Hash(reinterpret_cast<unsigned char*>(sharedKey.Get64BitArray()), PUBLIC_KEY_SIZE / 8);
+        });
     }
-    
-    m_challenges[challIndex].sharedKeyFuture = std::async(std::launch::async, [&]() 
-    { 
-        auto sharedKey = KeyExchange::DiffieHellman::GenerateSharedKey(m_challenges[challIndex].clientPublicKey, m_challenges[challIndex].serverPrivateKey); 
-        return Hash::SHA256().Hash(reinterpret_cast<unsigned char*>(sharedKey.Get64BitArray()), PUBLIC_KEY_SIZE / 8);
-    });
+    // A repeated request means the challenge was lost, the same challenge is sent again
 
     Buffer challenge;
     ChallengePacket packetInfo {m_challenges[challIndex].serverPublicKey};
 
     packetInfo.Write(challenge);
     if(!m_socket.Send(p_sender, challenge.data, challenge.size))
-        g_debugCallback("Server failed to send Challenge packet");
+        NETWORK_LOG(WARNING, "Server failed to send Challenge packet");
     else
-        g_debugCallback("Server sent Challenge packet");
+        NETWORK_LOG(VERBOSE, "Server sent Challenge packet");
 }
 
 void Server::HandlePacket(const ChallengeResponsePacket& p_packet, const Address& p_sender)
 {
-    g_debugCallback("Server Handling Challenge Response");
+    NETWORK_TRACE_ZONE("Handshake::ChallengeResponse");
+    NETWORK_LOG(VERBOSE, "Server Handling Challenge Response");
     const int challengeIndex = FindExistingChallengeIndex(p_sender);
     if(challengeIndex >= 0)
     {
@@ -298,16 +753,24 @@ void Server::HandlePacket(const ChallengeResponsePacket& p_packet, const Address
         const int newClientIndex = FindFreeConnectionIndex();
 
         auto& challenge = m_challenges[challengeIndex];
-        if (challenge.sharedKeyFuture.valid())
-        {
-            challenge.sharedKey = challenge.sharedKeyFuture.get();
-        }
+        ResolveSharedKey(challenge);
 
         if (newClientIndex > -1)
         {
             m_connected[newClientIndex] = true;
             m_connections[newClientIndex] = { challenge.clientAddress, challenge.sharedKey, clock::now() };
+            m_connections[newClientIndex].connection.SetId(newClientIndex);
+            m_connections[newClientIndex].connection.SetPacketAckedCallback(m_packetAckedCallback);
+            for (uint8_t channel = 0; channel < Connection::MAX_CHANNELS; ++channel)
+            {
+                m_connections[newClientIndex].connection.ConfigureChannel(channel, m_channelModes[channel]);
+                m_connections[newClientIndex].connection.SetParityGroupSize(channel, m_parityGroupSizes[channel]);
+            }
+            m_connections[newClientIndex].connection.SetCompressor(m_compressor);
+            m_connections[newClientIndex].connection.SetTimeOrigin(m_startTime);
+            m_replication.AddClient(newClientIndex);
             ++m_numConnections;
+            m_latencies[static_cast<size_t>(LatencyMetric::HANDSHAKE)].Record(clock::now() - challenge.requestTime);
 
             m_challenged[challengeIndex] = false;
             m_challenges[challengeIndex] = {};
@@ -319,9 +782,20 @@ void Server::HandlePacket(const ChallengeResponsePacket& p_packet, const Address
                 m_clientConnectCallback(newClientIndex);
             packetInfo.Write(accepted, m_connections[newClientIndex].sharedKey);
             if(!m_socket.Send(p_sender,accepted.data, accepted.size))
-                g_debugCallback("Server failed to send Connection Accepted packet");
-            g_debugCallback(("New client connected, ID: "+ std::to_string(newClientIndex), " Address: "+  m_connections[newClientIndex].clientAddress.ToString()).c_str());
+                NETWORK_LOG(WARNING, "Server failed to send Connection Accepted packet");
+            NETWORK_LOG(INFO, "New client connected, ID: {} Address: {}", newClientIndex, m_connections[newClientIndex].clientAddress.ToString());
         }
+        return;
+    }
+
+    // The client resends its response until the acceptance reaches it
+    const int clientIndex = FindExistingConnectionIndex(p_sender);
+    if (clientIndex > 0)
+    {
+        Buffer accepted;
+        ConnectionAcceptedPacket { static_cast<uint32_t>(clientIndex) }.Write(accepted, m_connections[clientIndex].sharedKey);
+        if(!m_socket.Send(p_sender, accepted.data, accepted.size))
+            NETWORK_LOG(WARNING, "Server failed to send Connection Accepted packet");
     }
 }
 
@@ -359,10 +833,7 @@ void Server::KickClient(const Address& p_address)
     else if (clientChallIdx > 0)
     {
         auto& challenge = m_challenges[clientChallIdx];
-        if (challenge.sharedKeyFuture.valid())
-        {
-            challenge.sharedKey = challenge.sharedKeyFuture.get();
-        }
+        ResolveSharedKey(challenge);
         sharedKey = challenge.sharedKey;
         clientAddress = challenge.clientAddress;
     }
@@ -376,22 +847,36 @@ void Server::KickClient(const Address& p_address)
     {
         if(!m_socket.Send(clientAddress, packet.data, packet.size))
         {
-            g_debugCallback("Server failed to send Disconnect packet");
+            NETWORK_LOG(WARNING, "Server failed to send Disconnect packet");
         }
     }
-    g_debugCallback("Server sent Disconnect packet");
+    NETWORK_LOG(VERBOSE, "Server sent Disconnect packet");
     RemoveClient(p_address);
 }
 
 void Server::RemoveClient(const Address& p_address)
 {
-    if(const int clientIdx = FindExistingConnectionIndex(p_address) > 0)
+    const int clientIdx = FindExistingConnectionIndex(p_address);
+    const int challIdx = clientIdx < 0 ? FindExistingChallengeIndex(p_address) : -1;
+    if(clientIdx >= 0)
     {
         m_connected[clientIdx] = false;
+        const ConnectionStats stats = m_connections[clientIdx].connection.GetStats();
+        m_departedStats.packetsSent += stats.packetsSent;
+        m_departedStats.packetsReceived += stats.packetsReceived;
+        m_departedStats.bytesSent += stats.bytesSent;
+        m_departedStats.bytesReceived += stats.bytesReceived;
+        m_departedStats.authenticationFailures += stats.authenticationFailures;
+        m_departedStats.checksumFailures += stats.checksumFailures;
+        m_departedStats.outOfOrderPackets += stats.outOfOrderPackets;
+        m_departedStats.duplicatePackets += stats.duplicatePackets;
+        m_departedStats.ackedPackets += stats.ackedPackets;
+        m_departedStats.lostPackets += stats.lostPackets;
         m_connections[clientIdx] = {};
+        m_replication.RemoveClient(clientIdx);
         --m_numConnections;
     }
-    else if(const int challIdx = FindExistingChallengeIndex(p_address) >= 0)
+    else if(challIdx >= 0)
     {
         m_challenged[challIdx] = false;
         m_challenges[challIdx] = {};
@@ -423,6 +908,17 @@ extern "C"
         return p_obj->Listen(o_gameData, p_size);
     }
 
+    int Internal_ServerListenWithChannel(Server* p_obj, unsigned char* o_gameData, unsigned int p_size, unsigned char* o_channel)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return -1;
+        }
+
+        return p_obj->Listen(o_gameData, p_size, o_channel);
+    }
+
     int Internal_ServerGetConnectedClientCount(Server* p_obj)
     {
         if (p_obj == NULL)
@@ -464,6 +960,161 @@ extern "C"
         }
         p_obj->RegisterDebugCallback(p_callback);
     }
+    void Internal_ServerRegisterPacketAckedCallback(Server* p_obj, PacketAckedCallback p_callback)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return;
+        }
+        p_obj->RegisterPacketAckedCallback(p_callback);
+    }
+
+    int Internal_ServerGetLastSentSequence(Server* p_obj, const unsigned int p_clientIndex)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return -1;
+        }
+        return p_obj->GetLastSentSequence(p_clientIndex);
+    }
+
+    double Internal_ServerGetTime(Server* p_obj)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return -1.0;
+        }
+        return p_obj->GetTime();
+    }
+
+    double Internal_ServerGetClientRoundTripTime(Server* p_obj, unsigned int p_clientIndex)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return -1.0;
+        }
+        return p_obj->GetClientRoundTripTime(p_clientIndex);
+    }
+
+    bool Internal_ServerGetConnectionStats(Server* p_obj, unsigned int p_clientIndex, ConnectionStats* o_stats)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return false;
+        }
+        if (o_stats == NULL)
+            return false;
+        return p_obj->GetConnectionStats(p_clientIndex, *o_stats);
+    }
+
+    void Internal_ServerGetStats(Server* p_obj, ServerStats* o_stats)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return;
+        }
+        if (o_stats != NULL)
+            p_obj->GetStats(*o_stats);
+    }
+
+    bool Internal_ServerGetLatencySummary(Server* p_obj, unsigned char p_metric, LatencySummary* o_summary)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return false;
+        }
+        if (o_summary == NULL)
+            return false;
+        return p_obj->GetLatencySummary(static_cast<LatencyMetric>(p_metric), *o_summary);
+    }
+
+    double Internal_ServerGetLatencyPercentile(Server* p_obj, unsigned char p_metric, double p_percentile)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return -1.0;
+        }
+        return p_obj->GetLatencyPercentile(static_cast<LatencyMetric>(p_metric), p_percentile);
+    }
+
+    void Internal_ServerResetLatencies(Server* p_obj)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return;
+        }
+        p_obj->ResetLatencies();
+    }
+
+    bool Internal_ServerStartCapture(Server* p_obj, const char* p_path)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return false;
+        }
+        return p_obj->StartCapture(p_path);
+    }
+
+    void Internal_ServerStopCapture(Server* p_obj)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return;
+        }
+        p_obj->StopCapture();
+    }
+
+    bool Internal_ServerStartReplay(Server* p_obj, const char* p_path, const bool p_realTime)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return false;
+        }
+        return p_obj->StartReplay(p_path, p_realTime);
+    }
+
+    void Internal_ServerStopReplay(Server* p_obj)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return;
+        }
+        p_obj->StopReplay();
+    }
+
+    bool Internal_ServerIsReplayFinished(Server* p_obj)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return true;
+        }
+        return p_obj->IsReplayFinished();
+    }
+
+    void Internal_ServerSetNetworkConditions(Server* p_obj, const NetworkConditions* p_conditions)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return;
+        }
+        p_obj->SetNetworkConditions(p_conditions != nullptr ? *p_conditions : NetworkConditions{});
+    }
+
     void Internal_ServerPropagateGameData(Server* p_obj, unsigned char* p_buffer, const unsigned int p_size)
     {
         if (p_obj == NULL)
@@ -473,5 +1124,135 @@ extern "C"
         }
         p_obj->PropagateGameData(p_buffer, p_size);
     }
+
+    void Internal_ServerPropagateGameDataOnChannel(Server* p_obj, unsigned char* p_buffer, const unsigned int p_size, unsigned char p_channel)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return;
+        }
+        p_obj->PropagateGameData(p_buffer, p_size, p_channel);
+    }
+
+    void Internal_ServerFlush(Server* p_obj)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return;
+        }
+        p_obj->Flush();
+    }
+
+    void Internal_ServerSetSnapshotChannel(Server* p_obj, unsigned char p_channel)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return;
+        }
+        p_obj->SetSnapshotChannel(p_channel);
+    }
+
+    void Internal_ServerPropagateSnapshot(Server* p_obj, const unsigned char* p_buffer, unsigned int p_size)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return;
+        }
+        p_obj->PropagateSnapshot(p_buffer, p_size);
+    }
+
+    void Internal_ServerSetInputChannel(Server* p_obj, unsigned char p_channel)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return;
+        }
+        p_obj->SetInputChannel(p_channel);
+    }
+
+    void Internal_ServerSetReplicationChannels(Server* p_obj, unsigned char p_reliableChannel, unsigned char p_unreliableChannel)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return;
+        }
+        p_obj->SetReplicationChannels(p_reliableChannel, p_unreliableChannel);
+    }
+
+    bool Internal_ServerRegisterEntityType(Server* p_obj, unsigned short p_type, const unsigned char* p_fields, unsigned int p_fieldCount)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return false;
+        }
+        return p_obj->RegisterEntityType(p_type, reinterpret_cast<const FieldType*>(p_fields), p_fieldCount);
+    }
+
+    long long Internal_ServerCreateEntity(Server* p_obj, unsigned short p_type)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return -1;
+        }
+        return p_obj->CreateEntity(p_type);
+    }
+
+    void Internal_ServerDestroyEntity(Server* p_obj, unsigned int p_entityId)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return;
+        }
+        p_obj->DestroyEntity(p_entityId);
+    }
+
+    bool Internal_ServerSetEntityField(Server* p_obj, unsigned int p_entityId, unsigned char p_field, const void* p_value)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return false;
+        }
+        return p_obj->SetEntityField(p_entityId, p_field, p_value);
+    }
+
+    void Internal_ServerSetCompression(Server* p_obj, bool p_enabled, const unsigned char* p_dictionary, unsigned int p_dictionarySize)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return;
+        }
+        p_obj->SetCompression(p_enabled, p_dictionary, p_dictionary != NULL ? p_dictionarySize : 0);
+    }
+
+    void Internal_ServerConfigureChannel(Server* p_obj, unsigned char p_channel, unsigned char p_mode)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return;
+        }
+        p_obj->ConfigureChannel(p_channel, static_cast<ChannelMode>(p_mode));
+    }
+
+    void Internal_ServerSetChannelParity(Server* p_obj, unsigned char p_channel, unsigned char p_groupSize)
+    {
+        if (p_obj == NULL)
+        {
+            g_debugCallback("Invalid instance pointer!");
+            return;
+        }
+        p_obj->SetChannelParity(p_channel, p_groupSize);
+    }
 }
 #pragma endregion 
@@ -0,0 +1,115 @@
+#include "stdafx.h"
+#include "Network/Simulation/NetworkSimulator.h"
+#include <algorithm>
+
+void NetworkSimulator::SetConditions(const NetworkConditions& p_conditions)
+{
+    m_published.Publish(p_conditions);
+    m_enabled.store(p_conditions.latency > 0.0f || p_conditions.jitter > 0.0f || p_conditions.lossRate > 0.0f ||
+                    p_conditions.burstEnterRate > 0.0f || p_conditions.duplicateRate > 0.0f ||
+                    p_conditions.reorderRate > 0.0f || p_conditions.bandwidth > 0);
+}
+
+bool NetworkSimulator::IsActive() const
+{
+    return m_enabled.load(std::memory_order_relaxed) || !m_outgoing.queue.empty() || !m_incoming.queue.empty();
+}
+
+bool NetworkSimulator::Chance(const float p_rate)
+{
+    return p_rate > 0.0f && std::uniform_real_distribution<float>{0.0f, 1.0f}(m_random) < p_rate;
+}
+
+NetworkSimulator::clock::duration NetworkSimulator::Milliseconds(const float p_milliseconds)
+{
+    return std::chrono::duration_cast<clock::duration>(std::chrono::duration<float, std::milli>{p_milliseconds});
+}
+
+void NetworkSimulator::Submit(Link& p_link, const Address& p_address, const unsigned char* p_data, const unsigned int p_size,
+                              const clock::time_point p_now)
+{
+    m_conditions = m_published.Read();
+
+    p_link.inBurst = p_link.inBurst ? !Chance(m_conditions.burstLeaveRate) : Chance(m_conditions.burstEnterRate);
+    if (p_link.inBurst || Chance(m_conditions.lossRate) || p_link.queue.size() >= MAX_QUEUED_DATAGRAMS)
+        return;
+
+    // The datagram leaves once the ones before it went through the bandwidth cap, then spends the latency on the way
+    clock::time_point departure = p_now;
+    if (m_conditions.bandwidth > 0)
+    {
+        departure = std::max(p_now, p_link.linkFree);
+        p_link.linkFree = departure + std::chrono::duration_cast<clock::duration>(
+            std::chrono::duration<double>{static_cast<double>(p_size) / m_conditions.bandwidth});
+    }
+
+    const int copies = Chance(m_conditions.duplicateRate) ? 2 : 1;
+    for (int i = 0; i < copies; ++i)
+    {
+        Datagram datagram{departure + Milliseconds(m_conditions.latency), m_order++, p_address, {p_data, p_data + p_size}};
+        if (m_conditions.jitter > 0.0f)
+            datagram.due += Milliseconds(std::uniform_real_distribution<float>{0.0f, m_conditions.jitter}(m_random));
+
+        if (Chance(m_conditions.reorderRate))
+            datagram.due += Milliseconds(m_conditions.reorderDelay);
+        else
+        {
+            datagram.due = std::max(datagram.due, p_link.lastDue);
+            p_link.lastDue = datagram.due;
+        }
+        Push(p_link, std::move(datagram));
+    }
+}
+
+bool NetworkSimulator::IsDueLater(const Datagram& p_left, const Datagram& p_right)
+{
+    return p_left.due != p_right.due ? p_left.due > p_right.due : p_left.order > p_right.order;
+}
+
+void NetworkSimulator::Push(Link& p_link, Datagram&& p_datagram)
+{
+    p_link.queue.push_back(std::move(p_datagram));
+    std::push_heap(p_link.queue.begin(), p_link.queue.end(), IsDueLater);
+}
+
+bool NetworkSimulator::Pop(Link& p_link, const clock::time_point p_now, Datagram& o_datagram)
+{
+    if (p_link.queue.empty() || p_link.queue.front().due > p_now)
+        return false;
+
+    std::pop_heap(p_link.queue.begin(), p_link.queue.end(), IsDueLater);
+    o_datagram = std::move(p_link.queue.back());
+    p_link.queue.pop_back();
+    return true;
+}
+
+void NetworkSimulator::QueueOutgoing(const Address& p_destination, const unsigned char* p_data, const unsigned int p_size)
+{
+    Submit(m_outgoing, p_destination, p_data, p_size, clock::now());
+}
+
+void NetworkSimulator::QueueIncoming(const Address& p_sender, const unsigned char* p_data, const unsigned int p_size)
+{
+    Submit(m_incoming, p_sender, p_data, p_size, clock::now());
+}
+
+bool NetworkSimulator::PopOutgoing(const clock::time_point p_now, Datagram& o_datagram)
+{
+    return Pop(m_outgoing, p_now, o_datagram);
+}
+
+bool NetworkSimulator::PopIncoming(const clock::time_point p_now, Datagram& o_datagram)
+{
+    return Pop(m_incoming, p_now, o_datagram);
+}
+
+std::chrono::microseconds NetworkSimulator::GetTimeUntilNextDue(const clock::time_point p_now, const std::chrono::microseconds p_max) const
+{
+    std::chrono::microseconds wait = p_max;
+    for (const Link* link : { &m_outgoing, &m_incoming })
+    {
+        if (!link->queue.empty())
+            wait = std::min(wait, std::chrono::duration_cast<std::chrono::microseconds>(link->queue.front().due - p_now));
+    }
+    return std::max(wait, std::chrono::microseconds{0});
+}
@@ -0,0 +1,106 @@
+#include "stdafx.h"
+#include "Network/Snapshots/JitterBuffer.h"
+
+void JitterBuffer::Reset()
+{
+    *this = JitterBuffer();
+}
+
+int64_t JitterBuffer::Unwrap(const uint32_t p_serverTime)
+{
+    if (!m_hasStatistics)
+        m_unwrappedTime = p_serverTime;
+    else
+        m_unwrappedTime += static_cast<int32_t>(p_serverTime - m_lastServerTime);
+    m_lastServerTime = p_serverTime;
+    return m_unwrappedTime;
+}
+
+void JitterBuffer::Add(const uint32_t p_serverTime, MessageData p_snapshot, const double p_localTime)
+{
+    const int64_t serverTime = Unwrap(p_serverTime);
+    const double transit = p_localTime - static_cast<double>(serverTime);
+
+    if (!m_hasStatistics)
+    {
+        m_hasStatistics = true;
+        m_meanTransit = transit;
+    }
+    else
+    {
+        m_jitter += (std::abs(transit - m_lastTransit) - m_jitter) * STATISTICS_GAIN;
+        m_meanTransit += (transit - m_meanTransit) * STATISTICS_GAIN;
+    }
+    m_lastTransit = transit;
+
+    if (!m_snapshots.empty() && serverTime > m_snapshots.back().serverTime)
+    {
+        const double interval = static_cast<double>(serverTime - m_snapshots.back().serverTime);
+        m_interval = m_interval == 0.0 ? interval : m_interval + (interval - m_interval) * STATISTICS_GAIN;
+    }
+
+    // Snapshots older than the one being rendered arrived too late to be played
+    if (m_hasPlayout && !m_snapshots.empty() && serverTime < m_snapshots.front().serverTime)
+        return;
+
+    auto it = m_snapshots.end();
+    while (it != m_snapshots.begin() && std::prev(it)->serverTime > serverTime)
+        --it;
+    if (it != m_snapshots.begin() && std::prev(it)->serverTime == serverTime)
+        return;
+    m_snapshots.insert(it, { serverTime, std::move(p_snapshot) });
+
+    if (m_snapshots.size() > MAX_SNAPSHOTS)
+        m_snapshots.pop_front();
+}
+
+bool JitterBuffer::GetSample(const double p_localTime, Sample& o_sample)
+{
+    if (m_snapshots.empty())
+        return false;
+
+    const double target = m_meanTransit + m_interval + JITTER_MULTIPLIER * m_jitter;
+    if (!m_hasPlayout)
+    {
+        m_hasPlayout = true;
+        m_playoutDelay = target;
+    }
+    else
+    {
+        // The delay moves towards its target by a bounded amount so playout never jumps
+        const double elapsed = std::max(p_localTime - m_lastSampleTime, 0.0);
+        if (target > m_playoutDelay)
+            m_playoutDelay = std::min(target, m_playoutDelay + elapsed * MAX_DELAY_INCREASE);
+        else
+            m_playoutDelay = std::max(target, m_playoutDelay - elapsed * MAX_DELAY_DECREASE);
+    }
+    m_lastSampleTime = p_localTime;
+
+    const double renderTime = p_localTime - m_playoutDelay;
+    while (m_snapshots.size() > 1 && static_cast<double>(m_snapshots[1].serverTime) <= renderTime)
+        m_snapshots.pop_front();
+
+    const Entry& from = m_snapshots.front();
+    o_sample.from = from.data;
+    o_sample.to = from.data;
+    o_sample.alpha = 0.0f;
+    o_sample.renderTime = renderTime;
+
+    if (m_snapshots.size() > 1 && static_cast<double>(from.serverTime) <= renderTime)
+    {
+        const Entry& to = m_snapshots[1];
+        o_sample.to = to.data;
+        o_sample.alpha = static_cast<float>((renderTime - from.serverTime) / static_cast<double>(to.serverTime - from.serverTime));
+    }
+    return true;
+}
+
+double JitterBuffer::GetBufferingDelay() const
+{
+    return m_hasPlayout ? std::max(m_playoutDelay - m_meanTransit, 0.0) : 0.0;
+}
+
+double JitterBuffer::GetJitter() const
+{
+    return m_jitter;
+}
@@ -0,0 +1,80 @@
+#include "stdafx.h"
+#include "Network/Snapshots/SnapshotDelta.h"
+
+void SnapshotDelta::WriteVarInt(std::vector<uint8_t>& o_data, uint32_t p_value)
+{
+    while (p_value >= 0x80)
+    {
+        o_data.push_back(static_cast<uint8_t>(p_value | 0x80));
+        p_value >>= 7;
+    }
+    o_data.push_back(static_cast<uint8_t>(p_value));
+}
+
+bool SnapshotDelta::ReadVarInt(const uint8_t*& p_data, const uint8_t* p_end, uint32_t& o_value)
+{
+    o_value = 0;
+    for (unsigned int shift = 0; shift < 35; shift += 7)
+    {
+        if (p_data == p_end)
+            return false;
+        const uint8_t byte = *p_data++;
+        o_value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0)
+            return true;
+    }
+    return false;
+}
+
+void SnapshotDelta::Encode(const std::vector<uint8_t>& p_baseline, const uint8_t* p_snapshot, const uint32_t p_size, std::vector<uint8_t>& o_delta)
+{
+    const uint32_t common = std::min(static_cast<uint32_t>(p_baseline.size()), p_size);
+    uint32_t i = 0;
+    while (i < p_size)
+    {
+        const uint32_t unchangedStart = i;
+        while (i < common && p_baseline[i] == p_snapshot[i])
+            ++i;
+        if (i == p_size)
+            break;
+
+        // Extend the changed run over unchanged gaps too short to be worth a new run
+        const uint32_t changedStart = i;
+        while (i < p_size)
+        {
+            uint32_t unchanged = 0;
+            while (i + unchanged < common && p_baseline[i + unchanged] == p_snapshot[i + unchanged])
+                ++unchanged;
+            if (unchanged >= MIN_UNCHANGED_RUN || (unchanged > 0 && i + unchanged == p_size))
+                break;
+            i += unchanged > 0 ? unchanged : 1;
+        }
+
+        WriteVarInt(o_delta, changedStart - unchangedStart);
+        WriteVarInt(o_delta, i - changedStart);
+        o_delta.insert(o_delta.end(), p_snapshot + changedStart, p_snapshot + i);
+    }
+}
+
+bool SnapshotDelta::Decode(const std::vector<uint8_t>& p_baseline, const uint8_t* p_delta, const uint32_t p_deltaSize, const uint32_t p_size, std::vector<uint8_t>& o_snapshot)
+{
+    o_snapshot.assign(p_size, 0);
+    std::copy_n(p_baseline.begin(), std::min(static_cast<uint32_t>(p_baseline.size()), p_size), o_snapshot.begin());
+
+    const uint8_t* end = p_delta + p_deltaSize;
+    uint32_t index = 0;
+    while (p_delta != end)
+    {
+        uint32_t unchanged, changed;
+        if (!ReadVarInt(p_delta, end, unchanged) || !ReadVarInt(p_delta, end, changed))
+            return false;
+        if (unchanged > p_size - index || changed > p_size - index - unchanged || changed > static_cast<uint32_t>(end - p_delta))
+            return false;
+
+        index += unchanged;
+        std::copy_n(p_delta, changed, o_snapshot.begin() + index);
+        index += changed;
+        p_delta += changed;
+    }
+    return true;
+}
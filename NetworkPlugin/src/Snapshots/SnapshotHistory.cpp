@@ -0,0 +1,128 @@
+#include "stdafx.h"
+#include "Network/Snapshots/SnapshotHistory.h"
+#include "Network/Snapshots/SnapshotDelta.h"
+#include "Network/Packets/Buffer.h"
+
+#pragma region SnapshotHeader
+void SnapshotHeader::Write(std::vector<uint8_t>& o_data) const
+{
+    Buffer buffer(SIZE);
+    buffer.WriteByte(static_cast<uint8_t>(type));
+    buffer.WriteShort(snapshotId);
+    buffer.WriteShort(baselineId);
+    buffer.WriteInteger(serverTime);
+    buffer.WriteInteger(size);
+    o_data.insert(o_data.end(), buffer.data, buffer.data + SIZE);
+}
+
+bool SnapshotHeader::Read(const std::vector<uint8_t>& p_data)
+{
+    if (p_data.size() < SIZE)
+        return false;
+
+    Buffer buffer(SIZE);
+    std::copy_n(p_data.begin(), SIZE, buffer.data);
+    type        = static_cast<SnapshotType>(buffer.ReadByte());
+    snapshotId  = buffer.ReadShort();
+    baselineId  = buffer.ReadShort();
+    serverTime  = buffer.ReadInteger();
+    size        = buffer.ReadInteger();
+    return type == SnapshotType::FULL || type == SnapshotType::DELTA;
+}
+#pragma endregion
+
+#pragma region SnapshotSender
+void SnapshotSender::Reset()
+{
+    m_sentSnapshots.Reset();
+}
+
+MessageData SnapshotSender::Encode(const uint16_t p_snapshotId, const uint32_t p_serverTime, const MessageData& p_snapshot, const bool p_hasAck,
+                                   const uint16_t p_ackedMessage) const
+{
+    SnapshotHeader header { SnapshotType::FULL, p_snapshotId, 0, p_serverTime, static_cast<uint32_t>(p_snapshot->size()) };
+
+    const SentSnapshot* baseline = nullptr;
+    for (uint16_t i = 1; p_hasAck && baseline == nullptr && i <= SNAPSHOT_BUFFER_SIZE; ++i)
+    {
+        const uint16_t baselineId = p_snapshotId - i;
+        const SentSnapshot* snapshot = m_sentSnapshots.Find(baselineId);
+        if (snapshot != nullptr && snapshot->messageId == p_ackedMessage)
+        {
+            baseline = snapshot;
+            header.baselineId = baselineId;
+        }
+    }
+
+    auto message = std::make_shared<std::vector<uint8_t>>();
+    if (baseline != nullptr)
+    {
+        std::vector<uint8_t> delta;
+        SnapshotDelta::Encode(*baseline->data, p_snapshot->data(), header.size, delta);
+        // A delta bigger than the snapshot itself is not worth it
+        if (delta.size() < p_snapshot->size())
+        {
+            header.type = SnapshotType::DELTA;
+            message->reserve(SnapshotHeader::SIZE + delta.size());
+            header.Write(*message);
+            message->insert(message->end(), delta.begin(), delta.end());
+            return message;
+        }
+    }
+
+    message->reserve(SnapshotHeader::SIZE + p_snapshot->size());
+    header.Write(*message);
+    message->insert(message->end(), p_snapshot->begin(), p_snapshot->end());
+    return message;
+}
+
+void SnapshotSender::Store(const uint16_t p_snapshotId, MessageData p_snapshot, const uint16_t p_messageId)
+{
+    SentSnapshot* snapshot = m_sentSnapshots.Insert(p_snapshotId);
+    if (snapshot == nullptr)
+        return;
+    snapshot->data = std::move(p_snapshot);
+    snapshot->messageId = p_messageId;
+}
+#pragma endregion
+
+#pragma region SnapshotReceiver
+void SnapshotReceiver::Reset()
+{
+    m_snapshots.Reset();
+}
+
+MessageData SnapshotReceiver::Decode(const MessageData& p_message, uint32_t* o_serverTime)
+{
+    SnapshotHeader header;
+    if (!header.Read(*p_message))
+        return nullptr;
+
+    const uint8_t* body = p_message->data() + SnapshotHeader::SIZE;
+    const uint32_t bodySize = static_cast<uint32_t>(p_message->size() - SnapshotHeader::SIZE);
+
+    std::shared_ptr<std::vector<uint8_t>> snapshot;
+    if (header.type == SnapshotType::FULL)
+    {
+        if (bodySize != header.size)
+            return nullptr;
+        snapshot = std::make_shared<std::vector<uint8_t>>(body, body + bodySize);
+    }
+    else
+    {
+        const MessageData* baseline = m_snapshots.Find(header.baselineId);
+        if (baseline == nullptr || *baseline == nullptr)
+            return nullptr;
+        snapshot = std::make_shared<std::vector<uint8_t>>();
+        if (!SnapshotDelta::Decode(**baseline, body, bodySize, header.size, *snapshot))
+            return nullptr;
+    }
+
+    MessageData* stored = m_snapshots.Insert(header.snapshotId);
+    if (stored != nullptr)
+        *stored = snapshot;
+    if (o_serverTime != nullptr)
+        *o_serverTime = header.serverTime;
+    return snapshot;
+}
+#pragma endregion
@@ -2,6 +2,8 @@
 #include "Network/Socket.h"
 #include "Network/Address.h"
 #include "Network/NetworkPlugin.h"
+#include "Network/Tracing/Tracer.h"
+#include "Network/Logging/Logger.h"
 
 Socket::Socket()
 {
@@ -97,11 +99,44 @@ bool Socket::AllowBroadcast() const
     return true;
 }
 
+bool Socket::SetDontFragment(const bool p_value) const
+{
+    if (m_handle == INVALID_SOCKET)
+    {
+        g_debugCallback("SetDontFragment failed : INVALID_SOCKET");
+        return false;
+    }
+
+    const DWORD value = p_value ? 1 : 0;
+    int res = setsockopt(m_handle, IPPROTO_IP, IP_DONTFRAGMENT, reinterpret_cast<const char *>(&value), sizeof(value));
+    if (res == SOCKET_ERROR)
+    {
+        g_debugCallback(("Set don't fragment failed! ERROR_CODE: " + std::to_string(WSAGetLastError())).c_str());
+        return false;
+    }
+
+    return true;
+}
+
 bool Socket::Send(const Address& p_destination, const unsigned char* p_data, const int p_size) const
+{
+    NETWORK_TRACE_ZONE("Socket::Send");
+    if (m_replay.IsActive())
+        return true;
+    if (m_simulator.IsActive())
+    {
+        m_simulator.QueueOutgoing(p_destination, p_data, static_cast<unsigned int>(p_size));
+        SendDueDatagrams();
+        return true;
+    }
+    return SendDatagram(p_destination, p_data, p_size);
+}
+
+bool Socket::SendDatagram(const Address& p_destination, const unsigned char* p_data, const int p_size) const
 {
     if (m_handle == INVALID_SOCKET)
     {
-        g_debugCallback("Send failed : INVALID_SOCKET");
+        NETWORK_LOG(FAILURE, "Send failed : INVALID_SOCKET");
         return false;
     }
 
@@ -114,14 +149,21 @@ bool Socket::Send(const Address& p_destination, const unsigned char* p_data, con
                                  reinterpret_cast<SOCKADDR*>(&address), sizeof(SOCKADDR_IN));
     if (sentBytes == SOCKET_ERROR)
     {
-        g_debugCallback(("Send failed! ERROR_CODE: " + std::to_string(WSAGetLastError())).c_str());
+        NETWORK_LOG(FAILURE, "Send failed! ERROR_CODE: {}", WSAGetLastError());
         return false;
     }
+    CountSent(sentBytes);
+    m_capture.Record(CaptureRecordType::SENT, p_destination, p_data, sentBytes);
     return sentBytes == p_size;
 }
 
 bool Socket::Send(const char* p_address, const short p_port, const unsigned char* p_data, int p_size) const
 {
+    NETWORK_TRACE_ZONE("Socket::Send");
+    if (m_replay.IsActive())
+        return true;
+    if (m_simulator.IsActive())
+        return Send(Address{p_address, static_cast<unsigned short>(p_port)}, p_data, p_size);
     SOCKADDR_IN address;
 
     inet_pton(AF_INET, p_address, &(address.sin_addr));
@@ -133,18 +175,97 @@ bool Socket::Send(const char* p_address, const short p_port, const unsigned char
 
     if (sentBytes == SOCKET_ERROR)
     {
-        g_debugCallback(("Send failed! ERROR_CODE: " + std::to_string(WSAGetLastError())).c_str());
+        NETWORK_LOG(FAILURE, "Send failed! ERROR_CODE: {}", WSAGetLastError());
         return false;
     }
 
+    CountSent(sentBytes);
+    if (m_capture.IsRecording())
+        m_capture.Record(CaptureRecordType::SENT, {p_address, static_cast<unsigned short>(p_port)}, p_data, sentBytes);
     return sentBytes == p_size;
 }
 
+bool Socket::Send(const Address& p_destination, const WSABUF* p_buffers, const unsigned int p_bufferCount) const
+{
+    NETWORK_TRACE_ZONE("Socket::Send");
+    if (m_replay.IsActive())
+        return true;
+    if (m_simulator.IsActive())
+    {
+        std::vector<uint8_t> datagram;
+        for (unsigned int i = 0; i < p_bufferCount; ++i)
+            datagram.insert(datagram.end(), p_buffers[i].buf, p_buffers[i].buf + p_buffers[i].len);
+        return Send(p_destination, datagram.data(), static_cast<int>(datagram.size()));
+    }
+    if (m_handle == INVALID_SOCKET)
+    {
+        NETWORK_LOG(FAILURE, "Send failed : INVALID_SOCKET");
+        return false;
+    }
+
+    SOCKADDR_IN address;
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = p_destination.GetAddress();
+    address.sin_port = p_destination.GetNPort();
+
+    DWORD expectedBytes = 0;
+    for (unsigned int i = 0; i < p_bufferCount; ++i)
+        expectedBytes += p_buffers[i].len;
+
+    // Gather the buffers into a single datagram without copying them first
+    DWORD sentBytes = 0;
+    if (WSASendTo(m_handle, const_cast<LPWSABUF>(p_buffers), p_bufferCount, &sentBytes, 0,
+                  reinterpret_cast<SOCKADDR*>(&address), sizeof(SOCKADDR_IN), nullptr, nullptr) == SOCKET_ERROR)
+    {
+        NETWORK_LOG(FAILURE, "Send failed! ERROR_CODE: {}", WSAGetLastError());
+        return false;
+    }
+    CountSent(static_cast<int>(sentBytes));
+    m_capture.Record(CaptureRecordType::SENT, p_destination, p_buffers, p_bufferCount);
+    return sentBytes == expectedBytes;
+}
+
 int Socket::Receive(Address& o_sender, unsigned char* o_data, int p_size) const
+{
+    NETWORK_TRACE_ZONE("Socket::Receive");
+    if (m_replay.IsActive())
+    {
+        const int bytes = m_replay.Receive(o_sender, o_data, p_size);
+        if (bytes < 0)
+            return -1;
+        m_packetsReceived.fetch_add(1, std::memory_order_relaxed);
+        m_bytesReceived.fetch_add(static_cast<uint64_t>(bytes), std::memory_order_relaxed);
+        return bytes;
+    }
+    if (m_simulator.IsActive())
+    {
+        // Everything the wire delivered goes through the simulated link before the caller sees it
+        Address sender;
+        int bytes;
+        while ((bytes = ReceiveDatagram(sender, o_data, p_size)) >= 0)
+            m_simulator.QueueIncoming(sender, o_data, static_cast<unsigned int>(bytes));
+        SendDueDatagrams();
+
+        NetworkSimulator::Datagram datagram;
+        if (!m_simulator.PopIncoming(NetworkSimulator::clock::now(), datagram))
+            return -1;
+        bytes = std::min(static_cast<int>(datagram.data.size()), p_size);
+        std::memcpy(o_data, datagram.data.data(), bytes);
+        o_sender = datagram.address;
+        OnDatagramReceived(o_sender, o_data, bytes);
+        return bytes;
+    }
+    const int bytes = ReceiveDatagram(o_sender, o_data, p_size);
+    if (bytes >= 0)
+        OnDatagramReceived(o_sender, o_data, bytes);
+    return bytes;
+}
+
+int Socket::ReceiveDatagram(Address& o_sender, unsigned char* o_data, const int p_size) const
 {
     if (m_handle == INVALID_SOCKET)
     {
-        g_debugCallback("Receive failed : INVALID_SOCKET");
+        NETWORK_LOG(FAILURE, "Receive failed : INVALID_SOCKET");
         return -1;
     }
 
@@ -157,13 +278,133 @@ int Socket::Receive(Address& o_sender, unsigned char* o_data, int p_size) const
     {
         const int error = WSAGetLastError();
         if (error != WSAEWOULDBLOCK)
-            g_debugCallback(("Receive failed! ERROR_CODE: " + std::to_string(error)).c_str());
+            NETWORK_LOG(FAILURE, "Receive failed! ERROR_CODE: {}", error);
         return -1;
     }
     o_sender = { ntohl(from.sin_addr.s_addr), ntohs(from.sin_port) };
     return bytes;
 }
 
+void Socket::OnDatagramReceived(const Address& p_sender, const unsigned char* p_data, const int p_size) const
+{
+    m_packetsReceived.fetch_add(1, std::memory_order_relaxed);
+    m_bytesReceived.fetch_add(static_cast<uint64_t>(p_size), std::memory_order_relaxed);
+    m_capture.Record(CaptureRecordType::RECEIVED, p_sender, p_data, p_size);
+}
+
+bool Socket::WaitForData(const std::chrono::microseconds p_timeout) const
+{
+    if (m_replay.IsActive())
+        return m_replay.WaitForData(p_timeout);
+    if (m_simulator.IsActive())
+    {
+        // Wake up when the next simulated datagram is due, even if the wire stays silent
+        const std::chrono::microseconds wait = m_simulator.GetTimeUntilNextDue(NetworkSimulator::clock::now(), p_timeout);
+        return WaitForSocket(wait) || wait < p_timeout;
+    }
+    return WaitForSocket(p_timeout);
+}
+
+bool Socket::WaitForSocket(const std::chrono::microseconds p_timeout) const
+{
+    if (m_handle == INVALID_SOCKET)
+        return false;
+
+    fd_set readSet;
+    FD_ZERO(&readSet);
+    FD_SET(m_handle, &readSet);
+    timeval timeout;
+    timeout.tv_sec = static_cast<long>(p_timeout.count() / 1000000);
+    timeout.tv_usec = static_cast<long>(p_timeout.count() % 1000000);
+
+    const int res = select(0, &readSet, nullptr, nullptr, &timeout);
+    if (res == SOCKET_ERROR)
+    {
+        NETWORK_LOG(FAILURE, "Select failed! ERROR_CODE: {}", WSAGetLastError());
+        return false;
+    }
+    return res > 0;
+}
+
+void Socket::SendDueDatagrams() const
+{
+    const NetworkSimulator::clock::time_point now = NetworkSimulator::clock::now();
+    NetworkSimulator::Datagram datagram;
+    while (m_simulator.PopOutgoing(now, datagram))
+        SendDatagram(datagram.address, datagram.data.data(), static_cast<int>(datagram.data.size()));
+}
+
+void Socket::CountSent(const int p_size) const
+{
+    m_packetsSent.fetch_add(1, std::memory_order_relaxed);
+    m_bytesSent.fetch_add(static_cast<uint64_t>(p_size), std::memory_order_relaxed);
+}
+
+uint64_t Socket::GetPacketsSent() const
+{
+    return m_packetsSent.load(std::memory_order_relaxed);
+}
+
+uint64_t Socket::GetBytesSent() const
+{
+    return m_bytesSent.load(std::memory_order_relaxed);
+}
+
+uint64_t Socket::GetPacketsReceived() const
+{
+    return m_packetsReceived.load(std::memory_order_relaxed);
+}
+
+uint64_t Socket::GetBytesReceived() const
+{
+    return m_bytesReceived.load(std::memory_order_relaxed);
+}
+
+bool Socket::StartCapture(const char* p_path, const uint64_t p_capacity)
+{
+    return m_capture.Start(p_path, p_capacity);
+}
+
+void Socket::StopCapture()
+{
+    m_capture.Stop();
+}
+
+bool Socket::StartReplay(const char* p_path, const bool p_realTime)
+{
+    return m_replay.Open(p_path, p_realTime);
+}
+
+void Socket::StopReplay()
+{
+    m_replay.Close();
+}
+
+bool Socket::IsReplaying() const
+{
+    return m_replay.IsActive();
+}
+
+bool Socket::IsReplayFinished() const
+{
+    return m_replay.IsFinished();
+}
+
+void Socket::SetNetworkConditions(const NetworkConditions& p_conditions)
+{
+    m_simulator.SetConditions(p_conditions);
+}
+
+void Socket::OnSessionKey(const Address& p_address, ShortSharedKey& o_key) const
+{
+    if (m_replay.IsActive())
+    {
+        if (!m_replay.FindSessionKey(p_address, o_key))
+            g_debugCallback(("No session key in the capture for " + p_address.ToString()).c_str());
+        return;
+    }
+    m_capture.Record(CaptureRecordType::SESSION_KEY, p_address, o_key.data(), static_cast<int>(o_key.size()));
+}
 
 #pragma region CExport
 extern "C"
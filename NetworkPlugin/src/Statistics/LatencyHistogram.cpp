@@ -0,0 +1,93 @@
+#include "stdafx.h"
+#include "Network/Statistics/LatencyHistogram.h"
+#include <cmath>
+
+void LatencyHistogram::Reset()
+{
+    for (auto& count : m_counts)
+        count.store(0, std::memory_order_relaxed);
+    m_total.store(0, std::memory_order_relaxed);
+    m_sum.store(0, std::memory_order_relaxed);
+    m_min.store(UINT64_MAX, std::memory_order_relaxed);
+    m_max.store(0, std::memory_order_relaxed);
+}
+
+unsigned int LatencyHistogram::GetBucket(const uint64_t p_value)
+{
+    if (p_value < SUB_BUCKET_COUNT)
+        return static_cast<unsigned int>(p_value);
+
+    unsigned int highestBit = 0;
+    for (uint64_t value = p_value; value > 1; value >>= 1)
+        ++highestBit;
+    const unsigned int shift = highestBit - SUB_BUCKET_BITS + 1;
+    return shift * SUB_BUCKET_HALF + static_cast<unsigned int>(p_value >> shift);
+}
+
+uint64_t LatencyHistogram::GetBucketMax(const unsigned int p_bucket)
+{
+    if (p_bucket < SUB_BUCKET_COUNT)
+        return p_bucket;
+
+    const unsigned int shift = p_bucket / SUB_BUCKET_HALF - 1;
+    const uint64_t subBucket = p_bucket % SUB_BUCKET_HALF + SUB_BUCKET_HALF;
+    return ((subBucket + 1) << shift) - 1;
+}
+
+void LatencyHistogram::Record(const uint64_t p_microseconds)
+{
+    m_counts[GetBucket(p_microseconds)].fetch_add(1, std::memory_order_relaxed);
+    m_total.fetch_add(1, std::memory_order_relaxed);
+    m_sum.fetch_add(p_microseconds, std::memory_order_relaxed);
+
+    uint64_t current = m_min.load(std::memory_order_relaxed);
+    while (p_microseconds < current && !m_min.compare_exchange_weak(current, p_microseconds, std::memory_order_relaxed)) {}
+    current = m_max.load(std::memory_order_relaxed);
+    while (p_microseconds > current && !m_max.compare_exchange_weak(current, p_microseconds, std::memory_order_relaxed)) {}
+}
+
+void LatencyHistogram::Record(const clock::duration p_duration)
+{
+    const int64_t microseconds = std::chrono::duration_cast<std::chrono::microseconds>(p_duration).count();
+    Record(static_cast<uint64_t>(std::max<int64_t>(microseconds, 0)));
+}
+
+double LatencyHistogram::GetPercentile(const double p_percentile) const
+{
+    // The total is summed from the buckets read, a value recorded meanwhile can't make the walk overshoot
+    std::array<uint64_t, BUCKET_COUNT> counts;
+    uint64_t total = 0;
+    for (unsigned int i = 0; i < BUCKET_COUNT; ++i)
+    {
+        counts[i] = m_counts[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+    if (total == 0)
+        return -1.0;
+
+    const double clamped = std::min(std::max(p_percentile, 0.0), 100.0);
+    const uint64_t rank = std::max<uint64_t>(static_cast<uint64_t>(std::ceil(clamped * static_cast<double>(total) / 100.0)), 1);
+    uint64_t seen = 0;
+    for (unsigned int i = 0; i < BUCKET_COUNT; ++i)
+    {
+        seen += counts[i];
+        if (seen >= rank)
+            return static_cast<double>(std::min(GetBucketMax(i), m_max.load(std::memory_order_relaxed)));
+    }
+    return static_cast<double>(m_max.load(std::memory_order_relaxed));
+}
+
+void LatencyHistogram::GetSummary(LatencySummary& o_summary) const
+{
+    o_summary = {};
+    o_summary.count = m_total.load(std::memory_order_relaxed);
+    if (o_summary.count == 0)
+        return;
+
+    o_summary.min = static_cast<double>(m_min.load(std::memory_order_relaxed));
+    o_summary.max = static_cast<double>(m_max.load(std::memory_order_relaxed));
+    o_summary.mean = static_cast<double>(m_sum.load(std::memory_order_relaxed)) / static_cast<double>(o_summary.count);
+    o_summary.p50 = GetPercentile(50.0);
+    o_summary.p99 = GetPercentile(99.0);
+    o_summary.p999 = GetPercentile(99.9);
+}
@@ -0,0 +1,110 @@
+#include "stdafx.h"
+#include "Network/Tracing/Tracer.h"
+#include "Network/NetworkPlugin.h"
+#include <fstream>
+
+std::atomic<bool>                   Tracer::s_enabled       {false};
+std::atomic<Tracer::ThreadBuffer*>  Tracer::s_buffers       {nullptr};
+std::atomic<uint32_t>               Tracer::s_nextThreadId  {1};
+const Tracer::clock::time_point     Tracer::s_origin        {clock::now()};
+
+Tracer::ThreadBuffer& Tracer::GetThreadBuffer()
+{
+    thread_local ThreadBuffer* buffer = nullptr;
+    if (buffer == nullptr)
+    {
+        // Never freed, events of finished threads stay readable and the list never has to unlink
+        buffer = new ThreadBuffer();
+        buffer->threadId = s_nextThreadId.fetch_add(1, std::memory_order_relaxed);
+        ThreadBuffer* head = s_buffers.load(std::memory_order_relaxed);
+        do
+        {
+            buffer->next = head;
+        } while (!s_buffers.compare_exchange_weak(head, buffer, std::memory_order_release, std::memory_order_relaxed));
+    }
+    return *buffer;
+}
+
+void Tracer::SetEnabled(const bool p_enabled)
+{
+    s_enabled.store(p_enabled, std::memory_order_relaxed);
+}
+
+bool Tracer::IsEnabled()
+{
+    return s_enabled.load(std::memory_order_relaxed);
+}
+
+int64_t Tracer::Now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - s_origin).count();
+}
+
+void Tracer::Record(const char* p_name, const int64_t p_start, const int64_t p_end)
+{
+    ThreadBuffer& buffer = GetThreadBuffer();
+    const uint64_t head = buffer.head.load(std::memory_order_relaxed);
+    Event& event = buffer.events[head % EVENTS_PER_THREAD];
+    event.name.store(p_name, std::memory_order_relaxed);
+    event.start.store(p_start, std::memory_order_relaxed);
+    event.duration.store(p_end - p_start, std::memory_order_relaxed);
+    buffer.head.store(head + 1, std::memory_order_release);
+}
+
+bool Tracer::WriteChromeTrace(const char* p_path)
+{
+    std::ofstream file(p_path, std::ios::out | std::ios::trunc);
+    if (!file)
+    {
+        g_debugCallback("Unable to open trace file");
+        return false;
+    }
+
+    file << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+    for (const ThreadBuffer* buffer = s_buffers.load(std::memory_order_acquire); buffer != nullptr; buffer = buffer->next)
+    {
+        const uint64_t head = buffer->head.load(std::memory_order_acquire);
+        const uint64_t begin = head > EVENTS_PER_THREAD ? head - EVENTS_PER_THREAD : 0;
+        for (uint64_t i = begin; i < head; ++i)
+        {
+            const Event& event = buffer->events[i % EVENTS_PER_THREAD];
+            const char* name = event.name.load(std::memory_order_relaxed);
+            if (name == nullptr)
+                continue;
+
+            // Timestamps are in microseconds, kept fractional so sub-microsecond zones stay visible
+            file << (first ? "" : ",") << "\n{\"name\":\"" << name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->threadId
+                 << ",\"ts\":" << std::fixed << std::setprecision(3) << event.start.load(std::memory_order_relaxed) / 1000.0
+                 << ",\"dur\":" << event.duration.load(std::memory_order_relaxed) / 1000.0 << "}";
+            first = false;
+        }
+    }
+    file << "\n]}\n";
+    return static_cast<bool>(file);
+}
+
+#pragma region CExport
+extern "C"
+{
+    void Internal_TracingSetEnabled(const bool p_enabled)
+    {
+#ifdef NETWORK_TRACING
+        Tracer::SetEnabled(p_enabled);
+#else
+        if (p_enabled)
+            g_debugCallback("Tracing is compiled out, define NETWORK_TRACING to enable it");
+#endif
+    }
+
+    bool Internal_TracingWriteChromeTrace(const char* p_path)
+    {
+        if (p_path == NULL)
+        {
+            g_debugCallback("Invalid trace path!");
+            return false;
+        }
+        return Tracer::WriteChromeTrace(p_path);
+    }
+}
+#pragma endregion
@@ -2,6 +2,8 @@
 #include "Network/Client.h"
 #include <thread>
 #include <atomic>
+#include <chrono>
+#include <cstring>
 
 std::atomic<bool> isRunning = true;
 
@@ -29,10 +31,45 @@ void ServListen(Server* p_server)
     }
 }
 
-int main()
+// Feed a capture to a server as fast as it takes it, or at the pace it was recorded
+int ReplayCapture(const char* p_path, bool p_realTime)
 {
+    Server* server = Internal_ServerCreate();
+    if (!Internal_ServerStartReplay(server, p_path, p_realTime))
+    {
+        Internal_ServerDestroy(server);
+        return 1;
+    }
+
+    unsigned char receivedData[255];
+    unsigned long long messages = 0;
+    const auto start = std::chrono::high_resolution_clock::now();
+    while (!Internal_ServerIsReplayFinished(server))
+    {
+        if (Internal_ServerListen(server, receivedData, 255) > 0)
+            ++messages;
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+    ServerStats stats;
+    Internal_ServerGetStats(server, &stats);
+    std::cout << "replayed " << stats.packetsReceived << " packets, " << messages << " messages in " << seconds << "s, "
+              << stats.packetsReceived / seconds << " packets/s\n";
+
+    Internal_ServerDestroy(server);
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    // --replay <file> [--realtime] replays a capture, --capture <file> records the server's traffic
+    if (argc >= 3 && std::strcmp(argv[1], "--replay") == 0)
+        return ReplayCapture(argv[2], argc >= 4 && std::strcmp(argv[3], "--realtime") == 0);
+
     Server* server = Internal_ServerCreate();
     Client* client = Internal_ClientCreate();
+    if (argc >= 3 && std::strcmp(argv[1], "--capture") == 0)
+        Internal_ServerStartCapture(server, argv[2]);
     std::thread servListen(ServListen, std::ref(server));
     std::thread clientListen(ClientListen, std::ref(client));
 
@@ -47,6 +84,7 @@ int main()
     isRunning = false;
     clientListen.join();
     servListen.join();
+    Internal_ServerStopCapture(server);
 
     Internal_ClientDestroy(client);
     Internal_ServerDestroy(server);